@@ -0,0 +1,930 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <raylib.h>
+
+#include "ChunkHash.h"
+#include "DensityProgram.h"
+#include "DensityPyramid.h"
+#include "DensitySampler.h"
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+#include "MeshBufferPool.h"
+#include "MeshOptimizer.h"
+#include "MeshWriter.h"
+#include "PrefixSumExtractor.h"
+#include "ScratchArena.h"
+#include "SampleGrid.h"
+#include "SlabExtractor.h"
+#include "SparseVolume.h"
+#include "StaticDensity.h"
+#include "TaskSystem.h"
+#include "VertexPacking.h"
+#include "VolumeRaycaster.h"
+#include "VoxelWorld.h"
+
+// Benchmarks for the engine hot paths. Runs without a window.
+// Usage: stillness-bench [iterations]
+
+namespace {
+    constexpr int SAMPLES_PER_CHUNK = CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES;
+
+    template <typename Function>
+    double TimeMilliseconds(Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // The terrain the chunk benchmarks run on: 4 x 2 x 4 chunks of rolling terrain around the origin, one voxel
+    // per unit, listed in z, y, x order. With generate false only the coordinates and origins are filled in,
+    // for benchmarks that sample the chunks themselves.
+    struct TerrainFixture {
+        TerrainDensityField terrain;
+        VoxelWorld world { 1.0f };
+        std::vector<ChunkCoord> coords;
+        std::vector<Vector3> origins;
+        std::vector<const Chunk *> chunks;
+
+        TerrainFixture(float baseHeight, float amplitude, bool generate = true) : terrain(1337, baseHeight, amplitude) {
+            for (int z = -2; z < 2; z++) {
+                for (int y = -1; y < 1; y++) {
+                    for (int x = -2; x < 2; x++) {
+                        coords.push_back({ x, y, z });
+                        origins.push_back(world.GetChunkOrigin({ x, y, z }));
+                        if (generate) {
+                            chunks.push_back(&world.GenerateChunk({ x, y, z }, terrain));
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // Fill the same chunk with both density paths and compare speed and output
+    void CompareDensityPaths(const char *name, const DensityField &interpreted, const DensityField &specialized, int iterations) {
+        std::vector<float> a(SAMPLES_PER_CHUNK);
+        std::vector<float> b(SAMPLES_PER_CHUNK);
+        Vector3 origin = { -16.0f, -16.0f, -16.0f };
+
+        double interpretedMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                interpreted.SampleBlock(origin, 1.0f, CHUNK_SAMPLES, a.data());
+            }
+        });
+
+        double specializedMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                specialized.SampleBlock(origin, 1.0f, CHUNK_SAMPLES, b.data());
+            }
+        });
+
+        float maxDifference = 0.0f;
+        for (int i = 0; i < SAMPLES_PER_CHUNK; i++) {
+            maxDifference = std::max(maxDifference, std::abs(a[i] - b[i]));
+        }
+
+        double samples = static_cast<double>(SAMPLES_PER_CHUNK) * iterations;
+        std::printf("%-16s interpreted %8.2f ns/sample   specialized %8.2f ns/sample   speedup %5.2fx   max difference %g\n",
+                    name,
+                    interpretedMs * 1e6 / samples,
+                    specializedMs * 1e6 / samples,
+                    interpretedMs / specializedMs,
+                    maxDifference);
+    }
+
+    void BenchmarkDensityPaths(int iterations) {
+        std::printf("== Density fill: bytecode interpreter vs template specialization ==\n");
+
+        // A sculpture built only from SDFs and CSG, where dispatch cost dominates
+        DensityProgram sdfProgram(
+            CsgSubtract(
+                CsgSmoothUnion(SdfSphere({ 0, 0, 0 }, 8), SdfTorus({ 0, -6, 0 }, 10, 2), 3),
+                CsgUnion(SdfBox({ 0, 8, 0 }, { 4, 4, 4 }), SdfCapsule({ -16, 0, 0 }, { 16, 0, 0 }, 2))));
+        auto sdfStatic = MakeStaticDensityField(
+            StaticDensity::Subtract(
+                StaticDensity::SmoothUnion(StaticDensity::Sphere({ 0, 0, 0 }, 8), StaticDensity::Torus({ 0, -6, 0 }, 10, 2), 3),
+                StaticDensity::Union(StaticDensity::Box({ 0, 8, 0 }, { 4, 4, 4 }), StaticDensity::Capsule({ -16, 0, 0 }, { 16, 0, 0 }, 2))));
+        CompareDensityPaths("sdf", sdfProgram, sdfStatic, iterations);
+
+        // Terrain with a tunnel and a crater, where the noise evaluation dominates
+        DensityProgram terrainProgram(
+            CsgSubtract(
+                CsgSubtract(NoiseTerrain(1337, 0, 8, 0.01f), SdfCapsule({ -16, -4, 0 }, { 16, -4, 0 }, 3)),
+                SdfSphere({ 8, 4, 8 }, 6)));
+        auto terrainStatic = MakeStaticDensityField(
+            StaticDensity::Subtract(
+                StaticDensity::Subtract(StaticDensity::Terrain(1337, 0, 8, 0.01f), StaticDensity::Capsule({ -16, -4, 0 }, { 16, -4, 0 }, 3)),
+                StaticDensity::Sphere({ 8, 4, 8 }, 6)));
+        CompareDensityPaths("terrain + sdf", terrainProgram, terrainStatic, iterations);
+
+        std::printf("\n");
+    }
+
+    void BenchmarkSampling(int iterations) {
+        std::printf("== Point density queries ==\n");
+
+        TerrainFixture fixture(-10.0f, 8.0f);
+        const TerrainDensityField &terrain = fixture.terrain;
+        const VoxelWorld &world = fixture.world;
+
+        // Scattered positions, where consecutive queries rarely share a chunk,
+        // and a random walk, where they nearly always do as with collision and gameplay queries
+        constexpr int QUERY_COUNT = 65536;
+        std::vector<Vector3> scattered(QUERY_COUNT);
+        std::vector<Vector3> walk(QUERY_COUNT);
+        std::uint32_t state = 12345;
+        auto next = [&state] {
+            state = state * 1664525u + 1013904223u;
+            return static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+        };
+
+        Vector3 walker = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < QUERY_COUNT; i++) {
+            scattered[i] = { -63.5f + next() * 127.0f, -31.5f + next() * 63.0f, -63.5f + next() * 127.0f };
+            walker.x = std::clamp(walker.x + next() - 0.5f, -63.5f, 63.5f);
+            walker.y = std::clamp(walker.y + next() - 0.5f, -31.5f, 31.5f);
+            walker.z = std::clamp(walker.z + next() - 0.5f, -63.5f, 63.5f);
+            walk[i] = walker;
+        }
+
+        std::vector<float> out(QUERY_COUNT);
+        DensitySampler sampler(world);
+        double queries = static_cast<double>(QUERY_COUNT) * iterations;
+
+        for (const auto &[name, positions] : { std::pair { "scattered", &scattered }, std::pair { "walk", &walk } }) {
+            double noiseMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (int q = 0; q < QUERY_COUNT; q++) {
+                        out[q] = terrain.Sample((*positions)[q]);
+                    }
+                }
+            });
+
+            double worldMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (int q = 0; q < QUERY_COUNT; q++) {
+                        out[q] = *world.SampleDensity((*positions)[q]);
+                    }
+                }
+            });
+
+            double samplerMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (int q = 0; q < QUERY_COUNT; q++) {
+                        out[q] = *sampler.Sample((*positions)[q]);
+                    }
+                }
+            });
+
+            double batchMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    sampler.SampleBatch(positions->data(), QUERY_COUNT, out.data());
+                }
+            });
+
+            std::printf("%-10s noise %7.2f ns/query   chunk map %7.2f ns/query   sampler %7.2f ns/query   sorted batch %7.2f ns/query\n",
+                        name,
+                        noiseMs * 1e6 / queries,
+                        worldMs * 1e6 / queries,
+                        samplerMs * 1e6 / queries,
+                        batchMs * 1e6 / queries);
+        }
+
+        std::printf("\n");
+    }
+
+    void BenchmarkExtraction(int iterations) {
+        std::printf("== Indexed extraction of terrain chunks ==\n");
+
+        TerrainFixture fixture(-10.0f, 8.0f);
+        const VoxelWorld &world = fixture.world;
+        const std::vector<ChunkCoord> &coords = fixture.coords;
+        MarchingCubes marchingCubes;
+
+        ExtractionStats stats;
+        double totalMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                ExtractionStats run;
+                for (ChunkCoord coord : coords) {
+                    marchingCubes.ExtractChunk(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), 0.0, &run);
+                }
+
+                // Report the counters of a single pass over the chunks
+                if (i == 0) {
+                    stats = run;
+                }
+            }
+        });
+
+        std::printf("%d chunks, %.3f ms per pass\n", static_cast<int>(coords.size()), totalMs / iterations);
+        std::printf("%s\n", stats.ToString().c_str());
+
+        MeshBufferPool::Stats poolStats = MeshBufferPool::Get().GetStats();
+        std::printf("Mesh buffers: %.2f MiB live, %.2f MiB peak, %.2f MiB pooled, %llu of %llu acquisitions reused\n",
+                    poolStats.liveBytes / 1048576.0, poolStats.peakLiveBytes / 1048576.0, poolStats.pooledBytes / 1048576.0,
+                    static_cast<unsigned long long>(poolStats.reuses), static_cast<unsigned long long>(poolStats.acquisitions));
+        std::printf("Scratch arena: %.2f MiB peak, %.2f MiB reserved\n",
+                    ScratchArena::ForThread().GetPeakBytes() / 1048576.0, ScratchArena::ForThread().GetReservedBytes() / 1048576.0);
+
+        // Building Raylib mesh arrays: flat shaded triangle soup copied over afterwards, as main.cpp used to,
+        // vs the indexed mesh written straight into the arrays by the extractor
+        std::size_t soupBytes = 0;
+        std::size_t directBytes = 0;
+        double soupMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (ChunkCoord coord : coords) {
+                    std::vector<Triangle> triangles = marchingCubes.PolygoniseChunk(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), 0.0);
+                    std::vector<float> vertices(triangles.size() * 9);
+                    std::vector<float> normals(triangles.size() * 9);
+                    for (std::size_t t = 0; t < triangles.size(); t++) {
+                        const Vector3 corners[3] = { triangles[t].X, triangles[t].Y, triangles[t].Z };
+                        float ux = corners[1].x - corners[0].x, uy = corners[1].y - corners[0].y, uz = corners[1].z - corners[0].z;
+                        float vx = corners[2].x - corners[0].x, vy = corners[2].y - corners[0].y, vz = corners[2].z - corners[0].z;
+                        float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+                        float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+                        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+                        for (int c = 0; c < 3; c++) {
+                            vertices[t * 9 + c * 3 + 0] = corners[c].x;
+                            vertices[t * 9 + c * 3 + 1] = corners[c].y;
+                            vertices[t * 9 + c * 3 + 2] = corners[c].z;
+                            normals[t * 9 + c * 3 + 0] = nx * scale;
+                            normals[t * 9 + c * 3 + 1] = ny * scale;
+                            normals[t * 9 + c * 3 + 2] = nz * scale;
+                        }
+                    }
+
+                    if (i == 0) {
+                        soupBytes += (vertices.size() + normals.size()) * sizeof(float);
+                    }
+                }
+            }
+        });
+
+        double directMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (ChunkCoord coord : coords) {
+                    Mesh mesh = marchingCubes.ExtractChunkMesh(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), 0.0);
+                    if (i == 0) {
+                        directBytes += MarchingCubes::MeshBufferBytes(mesh);
+                    }
+                    MarchingCubes::ReleaseMeshBuffers(mesh);
+                }
+            }
+        });
+
+        std::printf("Mesh arrays: triangle soup + copy %.3f ms per pass, %.2f MiB   direct indexed %.3f ms per pass, %.2f MiB\n",
+                    soupMs / iterations, soupBytes / 1048576.0, directMs / iterations, directBytes / 1048576.0);
+
+        // Packed vertex format: size, packing cost and round trip error
+        std::vector<IndexedMesh> meshes;
+        std::size_t floatBytes = 0;
+        for (ChunkCoord coord : coords) {
+            meshes.push_back(marchingCubes.ExtractChunk(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), 0.0));
+            floatBytes += (meshes.back().vertices.size() * 2) * sizeof(Vector3) + meshes.back().indices.size() * sizeof(std::uint32_t);
+        }
+
+        std::size_t packedBytes = 0;
+        float maxPositionError = 0.0f;
+        float minNormalDot = 1.0f;
+        double packMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (std::size_t m = 0; m < meshes.size(); m++) {
+                    PackedMesh packed;
+                    PackMesh(meshes[m], world.GetChunkOrigin(coords[m]), world.GetChunkWorldSize(), packed);
+
+                    if (i == 0) {
+                        packedBytes += packed.vertices.size() * sizeof(PackedVertex) + packed.indices.size() * sizeof(std::uint16_t);
+                        for (std::size_t v = 0; v < packed.vertices.size(); v++) {
+                            Vector3 position = UnpackPosition(packed.vertices[v], packed.origin, packed.extent);
+                            Vector3 normal = UnpackNormal(packed.vertices[v]);
+                            const Vector3 &p = meshes[m].vertices[v];
+                            const Vector3 &n = meshes[m].normals[v];
+                            maxPositionError = std::max({ maxPositionError, std::abs(position.x - p.x), std::abs(position.y - p.y), std::abs(position.z - p.z) });
+                            minNormalDot = std::min(minNormalDot, normal.x * n.x + normal.y * n.y + normal.z * n.z);
+                        }
+                    }
+                }
+            }
+        });
+
+        std::printf("Packed vertices: %.2f MiB vs %.2f MiB float, %.3f ms per pass to pack, max position error %g, max normal error %.4f degrees\n",
+                    packedBytes / 1048576.0, floatBytes / 1048576.0, packMs / iterations, maxPositionError,
+                    std::acos(std::min(minNormalDot, 1.0f)) * 180.0 / 3.14159265358979);
+
+        // Vertex cache optimization: cache misses per triangle in scan order and after reordering
+        for (int cacheSize : { 16, 32 }) {
+            std::uint64_t triangles = 0;
+            std::uint64_t missesBefore = 0;
+            std::uint64_t missesAfter = 0;
+            for (IndexedMesh &mesh : meshes) {
+                PooledVector<std::uint32_t> indices = mesh.indices;
+                missesBefore += CountCacheMisses(indices.data(), indices.size(), mesh.vertices.size(), cacheSize);
+                OptimizeVertexCache(indices.data(), indices.size(), mesh.vertices.size(), cacheSize);
+                missesAfter += CountCacheMisses(indices.data(), indices.size(), mesh.vertices.size(), cacheSize);
+                triangles += indices.size() / 3;
+            }
+            std::printf("Vertex cache of %d: ACMR %.3f in scan order, %.3f optimized\n", cacheSize,
+                        static_cast<double>(missesBefore) / triangles, static_cast<double>(missesAfter) / triangles);
+        }
+
+        ExtractionStats optimizeStats;
+        double optimizeMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (const IndexedMesh &mesh : meshes) {
+                    IndexedMesh copy = mesh;
+                    OptimizeMesh(copy, i == 0 ? &optimizeStats : nullptr);
+                }
+            }
+        });
+        std::printf("Optimize cache and fetch order: %.3f ms per pass including copies, %.3f ms measured by the stats\n",
+                    optimizeMs / iterations, optimizeStats.optimizeMilliseconds);
+    }
+
+    void BenchmarkLevels(int iterations) {
+        std::printf("\n== Several isoLevels: one extraction per level vs a single pass ==\n");
+
+        TerrainFixture fixture(-10.0f, 8.0f);
+        const VoxelWorld &world = fixture.world;
+        const std::vector<ChunkCoord> &coords = fixture.coords;
+        MarchingCubes marchingCubes;
+
+        for (const std::vector<double> &isoLevels : { std::vector<double> { -2.0, 0.0, 2.0 }, std::vector<double> { -6.0, -4.0, -2.0, 0.0, 2.0, 4.0, 6.0 } }) {
+            std::uint64_t separateHash = 0;
+            double separateMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (ChunkCoord coord : coords) {
+                        for (double isoLevel : isoLevels) {
+                            IndexedMesh mesh = marchingCubes.ExtractChunk(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), isoLevel);
+                            if (i == 0) {
+                                separateHash = CombineHashes(separateHash, HashMesh(mesh));
+                            }
+                        }
+                    }
+                }
+            });
+
+            std::uint64_t combinedHash = 0;
+            double combinedMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (ChunkCoord coord : coords) {
+                        std::vector<IndexedMesh> meshes = marchingCubes.ExtractChunkLevels(*world.FindChunk(coord), world.GetChunkOrigin(coord), world.GetVoxelSize(), isoLevels);
+                        if (i == 0) {
+                            for (const IndexedMesh &mesh : meshes) {
+                                combinedHash = CombineHashes(combinedHash, HashMesh(mesh));
+                            }
+                        }
+                    }
+                }
+            });
+
+            std::printf("%d levels: separate %.3f ms per pass, single pass %.3f ms per pass, meshes %s\n",
+                        static_cast<int>(isoLevels.size()), separateMs / iterations, combinedMs / iterations,
+                        separateHash == combinedHash ? "identical" : "DIFFER");
+        }
+    }
+
+    // A size^3 8 bit scan of a rippled ball, written as an NRRD file to the temp directory
+    std::filesystem::path WriteBenchmarkVolume(int size) {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "stillness-bench-volume.nrrd";
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << "NRRD0004\ntype: uchar\ndimension: 3\nsizes: " << size << " " << size << " " << size << "\nencoding: raw\n\n";
+
+            std::vector<unsigned char> slab(size * size);
+            for (int z = 0; z < size; z++) {
+                for (int y = 0; y < size; y++) {
+                    for (int x = 0; x < size; x++) {
+                        float dx = x - size * 0.5f, dy = y - size * 0.5f, dz = z - size * 0.5f;
+                        float radius = std::sqrt(dx * dx + dy * dy + dz * dz);
+                        float value = 255.0f - radius * 2.0f + 12.0f * std::sin(dx * 0.2f) * std::cos(dz * 0.15f);
+                        slab[y * size + x] = static_cast<unsigned char>(std::clamp(value, 0.0f, 255.0f));
+                    }
+                }
+                file.write(reinterpret_cast<const char *>(slab.data()), slab.size());
+            }
+        }
+        return path;
+    }
+
+    void BenchmarkVolumeStreaming() {
+        std::printf("\n== Streaming extraction of a volume file ==\n");
+
+        constexpr int size = 256;
+        std::filesystem::path path = WriteBenchmarkVolume(size);
+
+        VolumeReader reader;
+        if (!reader.Open(path.string())) {
+            std::printf("Cannot open %s: %s\n", path.string().c_str(), reader.GetError().c_str());
+            return;
+        }
+
+        // Bright is inside
+        reader.SetDensityMapping(-1.0f, 0.0f);
+
+        ExtractionStats stats;
+        std::uint64_t triangles = 0;
+        std::uint32_t vertices = 0;
+        double ms = TimeMilliseconds([&] {
+            ExtractVolume(reader, -128.0, [&](const IndexedMesh &layer, std::uint32_t firstVertex) {
+                triangles += layer.indices.size() / 3;
+                vertices = firstVertex + static_cast<std::uint32_t>(layer.vertices.size());
+            }, &stats);
+        });
+
+        // Two slabs of densities and inside flags, and the vertex slots of their edges
+        std::size_t residentBytes = size * size * (2 * sizeof(float) + 2 + 5 * sizeof(std::uint32_t));
+        std::printf("%d^3 samples in %.1f ms (%.1f MiB/s), %llu triangles, %u vertices, %.2f MiB resident instead of %.2f MiB\n",
+                    size, ms, size * size * size / 1048576.0 / (ms / 1000.0), static_cast<unsigned long long>(triangles), vertices,
+                    residentBytes / 1048576.0, size * size * size * sizeof(float) / 1048576.0);
+
+        reader.Close();
+        std::filesystem::remove(path);
+    }
+
+    void BenchmarkMeshExport() {
+        std::printf("\n== Streaming a volume's isosurface to mesh files ==\n");
+
+        constexpr int size = 256;
+        std::filesystem::path volumePath = WriteBenchmarkVolume(size);
+
+        for (MeshFormat format : { MeshFormat::Ply, MeshFormat::Obj, MeshFormat::Gltf }) {
+            const char *extension = format == MeshFormat::Ply ? "ply" : (format == MeshFormat::Obj ? "obj" : "glb");
+            std::filesystem::path meshPath = std::filesystem::temp_directory_path() / (std::string("stillness-bench-mesh.") + extension);
+
+            VolumeReader reader;
+            if (!reader.Open(volumePath.string())) {
+                std::printf("Cannot open %s: %s\n", volumePath.string().c_str(), reader.GetError().c_str());
+                break;
+            }
+            reader.SetDensityMapping(-1.0f, 0.0f);
+
+            // Time until the file is complete, so the I/O thread is included
+            std::unique_ptr<MeshWriter> writer = MeshWriter::Create(format);
+            bool written = false;
+            double ms = TimeMilliseconds([&] {
+                if (!writer->Open(meshPath.string())) {
+                    return;
+                }
+                ExtractVolume(reader, -128.0, [&](const IndexedMesh &layer, std::uint32_t firstVertex) {
+                    writer->AppendLayer(layer, firstVertex);
+                });
+                written = writer->Close();
+            });
+
+            if (!written) {
+                std::printf("%s: %s\n", extension, writer->GetError().c_str());
+            } else {
+                std::uintmax_t bytes = std::filesystem::file_size(meshPath);
+                std::printf("%s: %llu triangles in %.1f ms, %.1f MiB written at %.1f MiB/s\n", extension,
+                            static_cast<unsigned long long>(writer->GetTriangleCount()), ms, bytes / 1048576.0, bytes / 1048576.0 / (ms / 1000.0));
+            }
+            std::filesystem::remove(meshPath);
+        }
+
+        std::filesystem::remove(volumePath);
+    }
+
+    void BenchmarkSparseVolume() {
+        std::printf("\n== Sparse brick storage of a large terrain ==\n");
+
+        // 512 x 128 x 512 samples of terrain, truncated 8 units from the surface, with air as the background.
+        // One more chunk is stored along each axis, since the far faces of the last chunks belong to it.
+        constexpr float truncation = 8.0f;
+        constexpr int chunksX = 16, chunksY = 4, chunksZ = 16;
+        TerrainFixture fixture(-10.0f, 8.0f, false);
+        const VoxelWorld &world = fixture.world;
+        SparseVolume volume(truncation, truncation);
+        MarchingCubes marchingCubes;
+
+        // Meshes from the sampled chunks, to compare with the ones read back from the bricks
+        std::vector<ChunkCoord> coords;
+        Chunk chunk;
+        std::uint64_t denseHash = 0;
+        double storeMs = 0.0;
+        int storedChunks = 0;
+        for (int z = -chunksZ / 2; z <= chunksZ / 2; z++) {
+            for (int y = -chunksY / 2; y <= chunksY / 2; y++) {
+                for (int x = -chunksX / 2; x <= chunksX / 2; x++) {
+                    chunk.coord = { x, y, z };
+                    fixture.terrain.SampleBlock(world.GetChunkOrigin(chunk.coord), 1.0f, CHUNK_SAMPLES, chunk.densities.data());
+                    chunk.UpdateBounds();
+                    storeMs += TimeMilliseconds([&] { volume.StoreChunk(chunk); });
+                    storedChunks++;
+
+                    if (x < chunksX / 2 && y < chunksY / 2 && z < chunksZ / 2) {
+                        coords.push_back(chunk.coord);
+                        denseHash = CombineHashes(denseHash, HashMesh(marchingCubes.ExtractChunk(chunk, world.GetChunkOrigin(chunk.coord), 1.0f, 0.0)));
+                    }
+                }
+            }
+        }
+
+        std::uint64_t sparseHash = 0;
+        double readMs = 0.0;
+        for (ChunkCoord coord : coords) {
+            readMs += TimeMilliseconds([&] { volume.ReadChunk(coord, chunk); });
+            sparseHash = CombineHashes(sparseHash, HashMesh(marchingCubes.ExtractChunk(chunk, world.GetChunkOrigin(coord), 1.0f, 0.0)));
+        }
+
+        // Single sample lookups at scattered positions
+        constexpr int lookups = 1 << 20;
+        std::uint32_t state = 12345;
+        float sum = 0.0f;
+        double lookupMs = TimeMilliseconds([&] {
+            for (int i = 0; i < lookups; i++) {
+                state = state * 1664525u + 1013904223u;
+                int x = static_cast<int>(state >> 23) - 256;
+                int y = static_cast<int>(state >> 9 & 127) - 64;
+                int z = static_cast<int>(state & 511) - 256;
+                sum += volume.Sample(x, y, z);
+            }
+        });
+
+        std::size_t denseBytes = static_cast<std::size_t>(storedChunks) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(float);
+        std::printf("%zu bricks with samples, %zu uniform, the rest background: %.2f MiB instead of %.2f MiB dense (%.1fx smaller)\n",
+                    volume.GetBrickCount(), volume.GetUniformBrickCount(), volume.GetMemoryBytes() / 1048576.0,
+                    denseBytes / 1048576.0, static_cast<double>(denseBytes) / volume.GetMemoryBytes());
+        std::printf("Store %.3f ms, read back %.3f ms per chunk, %.1f ns per scattered sample (checksum %g), meshes %s\n",
+                    storeMs / storedChunks, readMs / coords.size(), lookupMs * 1e6 / lookups, sum,
+                    denseHash == sparseHash ? "identical" : "DIFFER");
+    }
+
+    // Extract, take gradients of and downsample the same grid stored in one layout
+    template <typename Layout>
+    std::uint64_t BenchmarkLayout(int size, const std::vector<float> &linear, int iterations) {
+        SampleGrid<Layout> grid(size, size, size);
+        grid.Assign(linear.data());
+        MarchingCubes marchingCubes;
+        Vector3 origin = { -size * 0.5f, -size * 0.5f, -size * 0.5f };
+
+        IndexedMesh mesh;
+        double extractMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                mesh = marchingCubes.ExtractGrid(grid, origin, 1.0f, 0.0);
+            }
+        });
+
+        // Gradients at scattered samples, where the layout decides how many cache lines the six neighbours take
+        constexpr int gradients = 1 << 20;
+        std::uint32_t state = 12345;
+        float sum = 0.0f;
+        double gradientMs = TimeMilliseconds([&] {
+            for (int i = 0; i < gradients; i++) {
+                state = state * 1664525u + 1013904223u;
+                int x = static_cast<int>((state >> 8 & 0x3ff) % size);
+                int y = static_cast<int>((state >> 18 & 0x3ff) % size);
+                int z = static_cast<int>((state ^ state >> 20) % size);
+                Vector3 gradient = GridGradient(grid, x, y, z);
+                sum += gradient.x + gradient.y + gradient.z;
+            }
+        });
+
+        double downsampleMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                SampleGrid<Layout> coarse = DownsampleGrid(grid, GridReduce::Average);
+                sum += coarse.At(0, 0, 0);
+            }
+        });
+
+        std::printf("  %-10s extract %8.3f ms   gradient %6.2f ns   downsample %7.3f ms   %7.2f MiB   (%zu triangles, checksum %g)\n",
+                    Layout::NAME, extractMs / iterations, gradientMs * 1e6 / gradients, downsampleMs / iterations,
+                    grid.GetMemoryBytes() / 1048576.0, mesh.indices.size() / 3, sum);
+        return HashMesh(mesh);
+    }
+
+    void BenchmarkLayouts(int iterations) {
+        std::printf("\n== Sample layouts ==\n");
+
+        // Power of two sizes, which Morton codes fill without padding
+        for (int size : { 32, 128, 256 }) {
+            std::vector<float> linear(static_cast<std::size_t>(size) * size * size);
+            std::size_t index = 0;
+            for (int z = 0; z < size; z++) {
+                for (int y = 0; y < size; y++) {
+                    for (int x = 0; x < size; x++) {
+                        float dx = x - size * 0.5f, dy = y - size * 0.5f, dz = z - size * 0.5f;
+                        float radius = std::sqrt(dx * dx + dy * dy + dz * dz);
+                        linear[index++] = radius - size * 0.35f - 0.05f * size * std::sin(dx * 0.2f) * std::cos(dz * 0.15f);
+                    }
+                }
+            }
+
+            int runs = std::max(1, iterations * 32 / size);
+            std::printf("%d^3 samples, %d runs\n", size, runs);
+            std::uint64_t linearHash = BenchmarkLayout<LinearLayout>(size, linear, runs);
+            std::uint64_t tiledHash = BenchmarkLayout<TiledLayout>(size, linear, runs);
+            std::uint64_t mortonHash = BenchmarkLayout<MortonLayout>(size, linear, runs);
+            std::printf("  meshes %s\n", linearHash == tiledHash && linearHash == mortonHash ? "identical" : "DIFFER");
+        }
+    }
+
+    void BenchmarkPyramid(int iterations) {
+        std::printf("\n== Density pyramid ==\n");
+
+        TerrainFixture fixture(0.0f, 12.0f);
+        const std::vector<const Chunk *> &chunks = fixture.chunks;
+        MarchingCubes marchingCubes;
+        std::vector<DensityPyramid> pyramids(chunks.size());
+
+        double buildMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (std::size_t c = 0; c < chunks.size(); c++) {
+                    pyramids[c].InvalidateAll();
+                    pyramids[c].Update(*chunks[c]);
+                }
+            }
+        });
+
+        // A small edit, like a dig, touches a few samples and only the cells above them
+        double editMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                for (std::size_t c = 0; c < chunks.size(); c++) {
+                    int x = (i * 7 + static_cast<int>(c) * 3) % (CHUNK_SIZE - 3);
+                    pyramids[c].Invalidate(x, 10, x, x + 3, 13, x + 3);
+                    pyramids[c].Update(*chunks[c]);
+                }
+            }
+        });
+        double chunkRuns = static_cast<double>(chunks.size()) * iterations;
+        std::printf("Build %.1f us per chunk, update after a 4^3 sample edit %.1f us, %.1f KiB per chunk\n",
+                    buildMs * 1e3 / chunkRuns, editMs * 1e3 / chunkRuns, pyramids[0].GetMemoryBytes() / 1024.0);
+
+        // LOD meshes from the pyramid, against reducing the full resolution samples every time a mesh is needed
+        for (int level = 1; level <= 3; level++) {
+            float spacing = static_cast<float>(1 << level);
+            std::uint64_t pyramidHash = 0;
+            std::uint64_t reducedHash = 0;
+            std::size_t triangles = 0;
+
+            double pyramidMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (std::size_t c = 0; c < chunks.size(); c++) {
+                        IndexedMesh mesh = marchingCubes.ExtractGrid(pyramids[c].GetAverages(level), { 0.0f, 0.0f, 0.0f }, spacing, 0.0);
+                        pyramidHash = i == 0 ? CombineHashes(pyramidHash, HashMesh(mesh)) : pyramidHash;
+                        triangles += i == 0 ? mesh.indices.size() / 3 : 0;
+                    }
+                }
+            });
+
+            double reducedMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (std::size_t c = 0; c < chunks.size(); c++) {
+                        DensityPyramid pyramid;
+                        pyramid.Update(*chunks[c]);
+                        IndexedMesh mesh = marchingCubes.ExtractGrid(pyramid.GetAverages(level), { 0.0f, 0.0f, 0.0f }, spacing, 0.0);
+                        reducedHash = i == 0 ? CombineHashes(reducedHash, HashMesh(mesh)) : reducedHash;
+                    }
+                }
+            });
+
+            std::printf("LOD %d: %5zu triangles, %.1f us per chunk from the pyramid, %.1f us reducing the samples first, meshes %s\n",
+                        level, triangles, pyramidMs * 1e3 / chunkRuns, reducedMs * 1e3 / chunkRuns,
+                        pyramidHash == reducedHash ? "identical" : "DIFFER");
+        }
+
+        // Coarse cells that can hold the surface, out of all cells of each level
+        for (int level = 1; level < PYRAMID_LEVELS; level++) {
+            int cells = DensityPyramid::CellsPerAxis(level);
+            std::size_t straddling = 0;
+            for (const DensityPyramid &pyramid : pyramids) {
+                for (int z = 0; z < cells; z++) {
+                    for (int y = 0; y < cells; y++) {
+                        for (int x = 0; x < cells; x++) {
+                            straddling += pyramid.CellStraddles(level, x, y, z, 0.0f);
+                        }
+                    }
+                }
+            }
+            std::printf("Level %d: %zu of %zu cells %d cells wide may hold the surface\n",
+                        level, straddling, pyramids.size() * cells * cells * cells, 1 << level);
+        }
+    }
+
+    void BenchmarkPrefixSum(int iterations) {
+        std::printf("\n== Two pass prefix sum extraction ==\n");
+
+        TerrainFixture fixture(0.0f, 12.0f);
+        const std::vector<const Chunk *> &chunks = fixture.chunks;
+        const std::vector<Vector3> &origins = fixture.origins;
+
+        // One mesh per chunk, then merged into one by appending with offset indices
+        MarchingCubes marchingCubes;
+        IndexedMesh merged;
+        double mergedMs = TimeMilliseconds([&] {
+            for (int i = 0; i < iterations; i++) {
+                merged = IndexedMesh();
+                for (std::size_t c = 0; c < chunks.size(); c++) {
+                    IndexedMesh mesh = marchingCubes.ExtractChunk(*chunks[c], origins[c], 1.0f, 0.0);
+                    std::uint32_t first = static_cast<std::uint32_t>(merged.vertices.size());
+                    merged.vertices.insert(merged.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                    merged.normals.insert(merged.normals.end(), mesh.normals.begin(), mesh.normals.end());
+                    for (std::uint32_t index : mesh.indices) {
+                        merged.indices.push_back(first + index);
+                    }
+                }
+            }
+        });
+        std::printf("ExtractChunk and merge  %8.3f ms for %zu chunks, %zu triangles\n",
+                    mergedMs / iterations, chunks.size(), merged.indices.size() / 3);
+
+        // Cell and triangle counters both extractors must agree on, whatever the timings
+        auto countersMatch = [](const ExtractionStats &a, const ExtractionStats &b) {
+            return a.cellsVisited == b.cellsVisited && a.cellsSkipped == b.cellsSkipped && a.caseHistogram == b.caseHistogram &&
+                   a.trianglesEmitted == b.trianglesEmitted && a.degenerateTrianglesRemoved == b.degenerateTrianglesRemoved &&
+                   a.verticesEmitted == b.verticesEmitted;
+        };
+        ExtractionStats chunkStats;
+        for (std::size_t c = 0; c < chunks.size(); c++) {
+            marchingCubes.ExtractChunk(*chunks[c], origins[c], 1.0f, 0.0, &chunkStats);
+        }
+
+        for (int threads : { 1, 2, 4 }) {
+            TaskSystem tasks(threads - 1);
+            PrefixSumExtractor extractor(1.0f, 0.0);
+            IndexedMesh mesh;
+            double prefixMs = TimeMilliseconds([&] {
+                for (int i = 0; i < iterations; i++) {
+                    for (std::size_t c = 0; c < chunks.size(); c++) {
+                        extractor.AddChunk(*chunks[c], origins[c]);
+                    }
+                    mesh = extractor.Extract(&tasks);
+                }
+            });
+
+            ExtractionStats prefixStats;
+            for (std::size_t c = 0; c < chunks.size(); c++) {
+                extractor.AddChunk(*chunks[c], origins[c]);
+            }
+            extractor.Extract(&tasks, &prefixStats);
+
+            std::printf("Prefix sum, %d thread%s   %8.3f ms, meshes %s, stats %s\n", threads, threads == 1 ? " " : "s",
+                        prefixMs / iterations, HashMesh(mesh) == HashMesh(merged) ? "identical" : "DIFFER",
+                        countersMatch(prefixStats, chunkStats) ? "identical" : "DIFFER");
+        }
+    }
+
+    // Hash of every chunk's densities and mesh in a world sampled and extracted on threads - 1 workers and the
+    // calling thread, in coordinate order for a single thread and in reverse otherwise
+    std::uint64_t HashWorldBuiltOn(int threads) {
+        TerrainFixture fixture(-10.0f, 8.0f, false);
+        const VoxelWorld &world = fixture.world;
+        const std::vector<ChunkCoord> &coords = fixture.coords;
+        MarchingCubes marchingCubes;
+
+        std::vector<std::unique_ptr<Chunk>> chunks(coords.size());
+        std::vector<IndexedMesh> meshes(coords.size());
+        TaskSystem tasks(threads - 1);
+        for (std::size_t n = 0; n < coords.size(); n++) {
+            std::size_t c = threads == 1 ? n : coords.size() - 1 - n;
+            tasks.Submit([&, c] {
+                chunks[c] = world.SampleChunk(coords[c], fixture.terrain);
+                meshes[c] = marchingCubes.ExtractChunk(*chunks[c], fixture.origins[c], world.GetVoxelSize(), 0.0);
+            });
+        }
+        tasks.WaitAll();
+
+        std::uint64_t hash = 0;
+        for (std::size_t c = 0; c < coords.size(); c++) {
+            hash = CombineHashes(hash, HashDensities(*chunks[c]));
+            hash = CombineHashes(hash, HashMesh(meshes[c]));
+        }
+        return hash;
+    }
+
+    void BenchmarkDeterminism() {
+        std::printf("\n== Determinism across thread counts ==\n");
+
+        std::uint64_t serialHash = HashWorldBuiltOn(1);
+        for (int threads : { 2, 4 }) {
+            std::uint64_t parallelHash = HashWorldBuiltOn(threads);
+            std::printf("World built on 1 thread %016llx, on %d threads %016llx, %s\n",
+                        static_cast<unsigned long long>(serialHash), threads, static_cast<unsigned long long>(parallelHash),
+                        serialHash == parallelHash ? "identical" : "DIFFER");
+        }
+    }
+
+    void BenchmarkTasks(int iterations) {
+        std::printf("\n== Task system ==\n");
+
+        // Small independent tasks, as a cost per task against running the same work inline
+        const int taskCount = 10000;
+        std::vector<float> results(taskCount);
+        auto work = [&](int i) {
+            float value = static_cast<float>(i);
+            for (int k = 0; k < 64; k++) {
+                value = value * 0.999f + 1.0f;
+            }
+            results[i] = value;
+        };
+
+        double inlineMs = TimeMilliseconds([&] {
+            for (int iteration = 0; iteration < iterations; iteration++) {
+                for (int i = 0; i < taskCount; i++) {
+                    work(i);
+                }
+            }
+        });
+        std::printf("Inline                 %8.3f us per item\n", inlineMs * 1000.0 / iterations / taskCount);
+
+        for (int workers : { 0, 1, 3 }) {
+            TaskSystem tasks(workers);
+            double taskMs = TimeMilliseconds([&] {
+                for (int iteration = 0; iteration < iterations; iteration++) {
+                    for (int i = 0; i < taskCount; i++) {
+                        tasks.Submit([&work, i] { work(i); });
+                    }
+                    tasks.WaitAll();
+                }
+            });
+            std::printf("Tasks, %d worker%s       %8.3f us per item\n", workers, workers == 1 ? " " : "s",
+                        taskMs * 1000.0 / iterations / taskCount);
+        }
+
+        // A chain of dependent stages, the shape of a chunk going from sampling to upload
+        TaskSystem tasks(1);
+        double chainMs = TimeMilliseconds([&] {
+            for (int iteration = 0; iteration < iterations; iteration++) {
+                TaskHandle previous;
+                for (int i = 0; i < taskCount; i++) {
+                    previous = tasks.Submit([&work, i] { work(i); }, { previous });
+                }
+                tasks.Wait(previous);
+            }
+        });
+        std::printf("Chain of dependencies  %8.3f us per item\n", chainMs * 1000.0 / iterations / taskCount);
+    }
+    void BenchmarkRaycasting() {
+        std::printf("\n== Raycasting ==\n");
+
+        TerrainFixture fixture(-10.0f, 8.0f);
+        VolumeRaycaster raycaster(fixture.world);
+        const int rayCount = 1 << 18;
+
+        // Rays straight down onto the terrain, as picking from above does, and rays skimming just over it, as camera
+        // collision does, which cross many bricks and cells before they hit or leave the world
+        std::uint32_t state = 42;
+        auto next = [&state] {
+            state = state * 1664525u + 1013904223u;
+            return static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+        };
+        std::vector<Ray> downRays(rayCount);
+        std::vector<Ray> grazingRays(rayCount);
+        for (int i = 0; i < rayCount; i++) {
+            downRays[i] = { { -60.0f + next() * 120.0f, 30.0f, -60.0f + next() * 120.0f }, { next() - 0.5f, -1.0f, next() - 0.5f } };
+            grazingRays[i] = { { -60.0f + next() * 120.0f, -4.0f + next() * 4.0f, -60.0f + next() * 120.0f },
+                               { next() - 0.5f, -0.05f - 0.1f * next(), next() - 0.5f } };
+        }
+
+        for (auto [name, rays] : { std::pair { "Down", &downRays }, std::pair { "Grazing", &grazingRays } }) {
+            std::vector<RayCollision> serial(rayCount);
+            raycaster.CastRays(rays->data(), rayCount, 200.0f, serial.data());
+            int hits = static_cast<int>(std::count_if(serial.begin(), serial.end(), [](const RayCollision &hit) { return hit.hit; }));
+
+            for (int threads : { 1, 2, 4 }) {
+                TaskSystem tasks(threads - 1);
+                std::vector<RayCollision> results(rayCount);
+                double castMs = TimeMilliseconds([&] {
+                    raycaster.CastRays(rays->data(), rayCount, 200.0f, results.data(), &tasks);
+                });
+
+                bool identical = std::equal(results.begin(), results.end(), serial.begin(), [](const RayCollision &a, const RayCollision &b) {
+                    return a.hit == b.hit && a.distance == b.distance;
+                });
+                std::printf("%-7s %d thread%s %8.2f Mrays/s, %d of %d hit, results %s\n", name, threads, threads == 1 ? " " : "s",
+                            rayCount / castMs / 1e3, hits, rayCount, identical ? "identical" : "DIFFER");
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    BenchmarkDensityPaths(iterations);
+    BenchmarkSampling(iterations);
+    BenchmarkExtraction(iterations);
+    BenchmarkLevels(iterations);
+    BenchmarkVolumeStreaming();
+    BenchmarkMeshExport();
+    BenchmarkSparseVolume();
+    BenchmarkLayouts(iterations);
+    BenchmarkPyramid(iterations);
+    BenchmarkPrefixSum(iterations);
+    BenchmarkDeterminism();
+    BenchmarkTasks(iterations);
+    BenchmarkRaycasting();
+
+    return 0;
+}
@@ -2,6 +2,17 @@
 #include <raylib.h>
 #include <raymath.h>
 
+#include "DensitySampler.h"
+#include "VoxelWorld.h"
+
+namespace {
+    // Number of spheres sampled along the collision capsule axis
+    constexpr int COLLISION_SPHERES = 3;
+
+    // Number of push-out passes per movement update
+    constexpr int COLLISION_ITERATIONS = 4;
+}
+
 GameCamera::GameCamera(float posX, float posY, float posZ) {
     // Initialize camera
     camera.position = { posX, posY, posZ };
@@ -16,6 +27,13 @@ GameCamera::GameCamera(float posX, float posY, float posZ) {
     sprintMultiplier = 2.5f;  // Sprint is 2.5x faster than normal speed
     cursorEnabled = false;
 
+    // Collision is off until a world is provided
+    collisionWorld = nullptr;
+    collisionEnabled = false;
+    collisionIsoLevel = 0.0f;
+    collisionRadius = 0.5f;
+    collisionHeight = 1.5f;
+
     // Calculate screen center
     screenCenter = { (float)GetScreenWidth()/2.0f, (float)GetScreenHeight()/2.0f };
 
@@ -28,26 +46,25 @@ GameCamera::GameCamera(float posX, float posY, float posZ) {
 
     // Force an initial reset to ensure correct positioning
     Reset();
+    previousCamera = camera;
 }
 
-void GameCamera::Update() {
-    // Get frame time for smooth movement
-    float frameTime = GetFrameTime();
+CameraInput GameCamera::ReadInput() {
+    CameraInput input;
+    input.moveForward = IsKeyDown(KEY_W);
+    input.moveBack = IsKeyDown(KEY_S);
+    input.moveLeft = IsKeyDown(KEY_A);
+    input.moveRight = IsKeyDown(KEY_D);
+    input.sprint = IsKeyDown(KEY_LEFT_SHIFT);
 
-    // Update movement based on keyboard input
-    UpdateMovement(frameTime);
-
-    // Only update rotation if cursor is disabled
+    // Only look around if cursor is disabled
     if (!cursorEnabled) {
         Vector2 mousePosition = GetMousePosition();
-        Vector2 mouseDelta = {
+        input.look = {
             mousePosition.x - previousMousePos.x,
             mousePosition.y - previousMousePos.y
         };
 
-        // Update camera rotation based on mouse movement
-        UpdateRotation(mouseDelta);
-
         // Reset mouse position to center if it's at screen edge
         if (mousePosition.x < 50 || mousePosition.x > GetScreenWidth() - 50 ||
             mousePosition.y < 50 || mousePosition.y > GetScreenHeight() - 50) {
@@ -62,13 +79,36 @@ void GameCamera::Update() {
         EnableMouseLook(!cursorEnabled);
     }
 
-    // Reset camera with SPACE key
-    if (IsKeyPressed(KEY_SPACE)) {
+    // Reset camera with SPACE key, toggle terrain collision with C key
+    input.reset = IsKeyPressed(KEY_SPACE);
+    input.toggleCollision = IsKeyPressed(KEY_C);
+    return input;
+}
+
+void GameCamera::Step(const CameraInput &input, float deltaTime) {
+    previousCamera = camera;
+
+    UpdateMovement(input, deltaTime);
+    UpdateRotation(input.look);
+
+    // A reset jumps, it does not glide there
+    if (input.reset) {
         Reset();
+        previousCamera = camera;
+    }
+    if (input.toggleCollision && collisionWorld != nullptr) {
+        collisionEnabled = !collisionEnabled;
     }
 }
 
-void GameCamera::UpdateMovement(float deltaTime) {
+Camera3D GameCamera::GetInterpolatedCamera(float alpha) const {
+    Camera3D view = camera;
+    view.position = Vector3Lerp(previousCamera.position, camera.position, alpha);
+    view.target = Vector3Lerp(previousCamera.target, camera.target, alpha);
+    return view;
+}
+
+void GameCamera::UpdateMovement(const CameraInput &input, float deltaTime) {
     // Calculate forward and right vectors
     Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
     Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, camera.up));
@@ -77,45 +117,106 @@ void GameCamera::UpdateMovement(float deltaTime) {
     float speed = moveSpeed * deltaTime * 60.0f;
 
     // Forward/backward movement
-    if (IsKeyDown(KEY_W)) {
+    if (input.moveForward) {
         camera.position = Vector3Add(camera.position, Vector3Scale(forward, speed));
         camera.target = Vector3Add(camera.target, Vector3Scale(forward, speed));
     }
-    if (IsKeyDown(KEY_S)) {
+    if (input.moveBack) {
         camera.position = Vector3Subtract(camera.position, Vector3Scale(forward, speed));
         camera.target = Vector3Subtract(camera.target, Vector3Scale(forward, speed));
     }
 
     // Left/right movement
-    if (IsKeyDown(KEY_A)) {
+    if (input.moveLeft) {
         camera.position = Vector3Subtract(camera.position, Vector3Scale(right, speed));
         camera.target = Vector3Subtract(camera.target, Vector3Scale(right, speed));
     }
-    if (IsKeyDown(KEY_D)) {
+    if (input.moveRight) {
         camera.position = Vector3Add(camera.position, Vector3Scale(right, speed));
         camera.target = Vector3Add(camera.target, Vector3Scale(right, speed));
     }
 
     // Sprinting
-    if (IsKeyDown(KEY_LEFT_SHIFT)) {
+    if (input.sprint) {
         float sprintSpeed = moveSpeed * sprintMultiplier * deltaTime * 60.0f;
-        if (IsKeyDown(KEY_W)) {
+        if (input.moveForward) {
             camera.position = Vector3Add(camera.position, Vector3Scale(forward, sprintSpeed));
             camera.target = Vector3Add(camera.target, Vector3Scale(forward, sprintSpeed));
         }
-        if (IsKeyDown(KEY_S)) {
+        if (input.moveBack) {
             camera.position = Vector3Subtract(camera.position, Vector3Scale(forward, sprintSpeed));
             camera.target = Vector3Subtract(camera.target, Vector3Scale(forward, sprintSpeed));
         }
-        if (IsKeyDown(KEY_A)) {
+        if (input.moveLeft) {
             camera.position = Vector3Subtract(camera.position, Vector3Scale(right, sprintSpeed));
             camera.target = Vector3Subtract(camera.target, Vector3Scale(right, sprintSpeed));
         }
-        if (IsKeyDown(KEY_D)) {
+        if (input.moveRight) {
             camera.position = Vector3Add(camera.position, Vector3Scale(right, sprintSpeed));
             camera.target = Vector3Add(camera.target, Vector3Scale(right, sprintSpeed));
         }
     }
+
+    if (collisionEnabled) {
+        ResolveCollision();
+    }
+}
+
+void GameCamera::EnableCollision(const VoxelWorld *world, float isoLevel) {
+    collisionWorld = world;
+    collisionIsoLevel = isoLevel;
+    collisionEnabled = world != nullptr;
+}
+
+void GameCamera::ResolveCollision() {
+    if (collisionWorld == nullptr) {
+        return;
+    }
+
+    // All spheres and gradient taps fall into a handful of chunks, which the sampler keeps cached
+    DensitySampler sampler(*collisionWorld);
+
+    for (int iteration = 0; iteration < COLLISION_ITERATIONS; iteration++) {
+        // Find the deepest penetrating sphere along the capsule axis
+        Vector3 correction = { 0.0f, 0.0f, 0.0f };
+        float deepest = 0.0f;
+
+        for (int i = 0; i < COLLISION_SPHERES; i++) {
+            float offset = collisionHeight * i / (COLLISION_SPHERES - 1);
+            Vector3 center = Vector3Subtract(camera.position, Vector3Scale(camera.up, offset));
+
+            std::optional<float> density = sampler.Sample(center);
+            if (!density) {
+                continue;
+            }
+
+            std::optional<Vector3> gradient = sampler.SampleGradient(center);
+            if (!gradient) {
+                continue;
+            }
+
+            float gradientLength = Vector3Length(*gradient);
+            if (gradientLength < 0.0001f) {
+                continue;
+            }
+
+            // Dividing by the gradient length turns the density into an estimate of the distance to the surface
+            float distance = (*density - collisionIsoLevel) / gradientLength;
+            float penetration = collisionRadius - distance;
+
+            if (penetration > deepest) {
+                deepest = penetration;
+                correction = Vector3Scale(*gradient, penetration / gradientLength);
+            }
+        }
+
+        if (deepest <= 0.0f) {
+            break;
+        }
+
+        camera.position = Vector3Add(camera.position, correction);
+        camera.target = Vector3Add(camera.target, correction);
+    }
 }
 
 void GameCamera::UpdateRotation(Vector2 mouseDelta) {
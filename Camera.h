@@ -4,23 +4,70 @@
 #include <raylib.h>
 #include <raymath.h>
 
+class VoxelWorld;
+
+// The player's controls, read once a frame and applied by the next simulation step.
+// Held keys apply to every step, mouse movement and presses only to the first one after them.
+struct CameraInput {
+    bool moveForward = false;
+    bool moveBack = false;
+    bool moveLeft = false;
+    bool moveRight = false;
+    bool sprint = false;
+    Vector2 look = { 0.0f, 0.0f };     // Mouse movement in pixels
+    bool reset = false;
+    bool toggleCollision = false;
+
+    // Take a newer frame's input, keeping movement and presses a step has not used yet
+    void Accumulate(const CameraInput &newer) {
+        Vector2 pendingLook = { look.x + newer.look.x, look.y + newer.look.y };
+        bool pendingReset = reset || newer.reset;
+        bool pendingToggle = toggleCollision || newer.toggleCollision;
+        *this = newer;
+        look = pendingLook;
+        reset = pendingReset;
+        toggleCollision = pendingToggle;
+    }
+
+    // Forget what a step has used once
+    void ClearEvents() {
+        look = { 0.0f, 0.0f };
+        reset = false;
+        toggleCollision = false;
+    }
+};
+
+// Camera moved by a fixed timestep simulation: ReadInput samples the controls every frame, Step advances
+// the camera by whole steps, and GetInterpolatedCamera places the rendered view between the last two steps.
+// Step reads nothing but its input and the collision world, so it does the same at any frame rate.
+// That determinism is limited by the collision world: ResolveCollision reads whichever chunks have arrived,
+// and when they arrive depends on worker timing, so a replay of the same input can collide differently.
+// Making it exact would take a snapshot of the collision world per step.
 class GameCamera {
 public:
     // Constructor
     GameCamera(float posX = 0.0f, float posY = 2.5f, float posZ = 5.0f);
 
+    // Read the keyboard and mouse. Call once per frame, from the main thread.
+    CameraInput ReadInput();
+
+    // Advance the simulation by one step of deltaTime seconds
+    void Step(const CameraInput &input, float deltaTime);
+
+    // The camera between the previous step, at alpha 0, and the last one, at alpha 1
+    Camera3D GetInterpolatedCamera(float alpha) const;
+
     // Camera control methods
-    void Update();  // Call this every frame to update camera position
     void SetPosition(Vector3 position);
     void SetTarget(Vector3 target);
     void Reset();   // Reset to initial position
 
     // Mouse and keyboard controls
-    void UpdateMovement(float deltaTime);
+    void UpdateMovement(const CameraInput &input, float deltaTime);
     void UpdateRotation(Vector2 mouseDelta);
     void EnableMouseLook(bool enable);
 
-    // Getter for the Raylib Camera3D
+    // Getter for the Raylib Camera3D, as of the last step
     const Camera3D& GetCamera() const { return camera; }
 
     // Configuration settings
@@ -28,14 +75,32 @@ public:
     void SetMouseSensitivity(float sensitivity) { mouseSensitivity = sensitivity; }
     void SetSprintMultiplier(float multiplier) { sprintMultiplier = multiplier; }
 
+    // Optional collision against the terrain.
+    // The camera is treated as a vertical capsule hanging below the eye, which is pushed
+    // out of the surface along the density gradient after every movement.
+    void EnableCollision(const VoxelWorld *world, float isoLevel = 0.0f);
+    void DisableCollision() { collisionEnabled = false; }
+    bool IsCollisionEnabled() const { return collisionEnabled; }
+    void SetCollisionCapsule(float radius, float height) { collisionRadius = radius; collisionHeight = height; }
+
 private:
     Camera3D camera;            // Internal Raylib camera
+    Camera3D previousCamera;    // Camera before the last step, for interpolation
     bool cursorEnabled;         // Is cursor enabled
     float moveSpeed;            // Movement speed
     float mouseSensitivity;     // Mouse look sensitivity
     float sprintMultiplier;     // Sprint speed multiplier
     Vector2 previousMousePos;   // Previous mouse position for delta calculation
     Vector2 screenCenter;       // Center of the screen
+
+    const VoxelWorld *collisionWorld;   // World to collide with, if any
+    bool collisionEnabled;              // Is terrain collision enabled
+    float collisionIsoLevel;            // Density below which space is solid
+    float collisionRadius;              // Radius of the collision capsule
+    float collisionHeight;              // Distance from the eye down to the bottom of the capsule axis
+
+    // Push the camera out of the terrain
+    void ResolveCollision();
 };
 
 #endif // CAMERA_H
@@ -0,0 +1,80 @@
+#include "Chunk.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+    // std::lerp guarantees exactness and monotonicity at a cost of twice the time, which this hot path does not need
+    float Lerp(float a, float b, float t) {
+        return a + (b - a) * t;
+    }
+
+    // Finalizer from MurmurHash3, a cheap integer hash with good avalanche behaviour
+    std::uint32_t Mix(std::uint32_t h) {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+}
+
+std::uint32_t ChunkSeed(std::uint32_t worldSeed, ChunkCoord coord, int lod) {
+    // Fold each component in through the mixer, so neighbouring chunks get unrelated seeds
+    std::uint32_t h = Mix(worldSeed ^ 0x9e3779b9u);
+    h = Mix(h ^ static_cast<std::uint32_t>(coord.x));
+    h = Mix(h ^ static_cast<std::uint32_t>(coord.y));
+    h = Mix(h ^ static_cast<std::uint32_t>(coord.z));
+    h = Mix(h ^ static_cast<std::uint32_t>(lod));
+    return h;
+}
+
+float Chunk::SampleTrilinear(float x, float y, float z) const {
+    int cx = std::clamp(static_cast<int>(x), 0, CHUNK_SIZE - 1);
+    int cy = std::clamp(static_cast<int>(y), 0, CHUNK_SIZE - 1);
+    int cz = std::clamp(static_cast<int>(z), 0, CHUNK_SIZE - 1);
+
+    float u = std::clamp(x - cx, 0.0f, 1.0f);
+    float v = std::clamp(y - cy, 0.0f, 1.0f);
+    float w = std::clamp(z - cz, 0.0f, 1.0f);
+
+    float x00 = Lerp(At(cx, cy, cz), At(cx + 1, cy, cz), u);
+    float x10 = Lerp(At(cx, cy + 1, cz), At(cx + 1, cy + 1, cz), u);
+    float x01 = Lerp(At(cx, cy, cz + 1), At(cx + 1, cy, cz + 1), u);
+    float x11 = Lerp(At(cx, cy + 1, cz + 1), At(cx + 1, cy + 1, cz + 1), u);
+
+    return Lerp(Lerp(x00, x10, v), Lerp(x01, x11, v), w);
+}
+
+void Chunk::UpdateBounds() {
+    minDensity = std::numeric_limits<float>::max();
+    maxDensity = std::numeric_limits<float>::lowest();
+
+    for (int bz = 0; bz < BRICKS_PER_CHUNK; bz++) {
+        for (int by = 0; by < BRICKS_PER_CHUNK; by++) {
+            for (int bx = 0; bx < BRICKS_PER_CHUNK; bx++) {
+                float low = std::numeric_limits<float>::max();
+                float high = std::numeric_limits<float>::lowest();
+
+                // A brick covers BRICK_SIZE cells, so it includes the samples on both of its faces
+                for (int z = bz * BRICK_SIZE; z <= (bz + 1) * BRICK_SIZE; z++) {
+                    for (int y = by * BRICK_SIZE; y <= (by + 1) * BRICK_SIZE; y++) {
+                        for (int x = bx * BRICK_SIZE; x <= (bx + 1) * BRICK_SIZE; x++) {
+                            float density = At(x, y, z);
+                            low = std::min(low, density);
+                            high = std::max(high, density);
+                        }
+                    }
+                }
+
+                int brickIndex = BrickIndex(bx, by, bz);
+                brickMin[brickIndex] = low;
+                brickMax[brickIndex] = high;
+
+                minDensity = std::min(minDensity, low);
+                maxDensity = std::max(maxDensity, high);
+            }
+        }
+    }
+}
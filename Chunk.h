@@ -0,0 +1,111 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class DensityPyramid;
+
+// Number of cells along each axis of a chunk.
+constexpr int CHUNK_SIZE = 32;
+
+// Number of density samples along each axis of a chunk.
+// Samples on the far faces are duplicated by the neighbouring chunk,
+// so every chunk can be polygonised without looking at its neighbours.
+constexpr int CHUNK_SAMPLES = CHUNK_SIZE + 1;
+
+// Number of cells along each axis of a brick.
+// Bricks are the finer level of the min/max hierarchy used to skip empty space.
+constexpr int BRICK_SIZE = 4;
+constexpr int BRICKS_PER_CHUNK = CHUNK_SIZE / BRICK_SIZE;
+
+struct ChunkCoord {
+    int x;
+    int y;
+    int z;
+
+    bool operator==(const ChunkCoord &other) const = default;
+};
+
+struct ChunkCoordHash {
+    std::size_t operator()(const ChunkCoord &coord) const {
+        // Large primes spread neighbouring coordinates over the buckets
+        return (static_cast<std::size_t>(coord.x) * 73856093u) ^
+               (static_cast<std::size_t>(coord.y) * 19349663u) ^
+               (static_cast<std::size_t>(coord.z) * 83492791u);
+    }
+};
+
+// Identifies the generated content of a chunk.
+// Generation is deterministic, so two chunks with the same key always hold identical samples
+// and can be cached, shared or compared across runs and builds.
+struct ChunkKey {
+    std::uint32_t worldSeed;
+    ChunkCoord coord;
+    int lod;
+
+    bool operator==(const ChunkKey &other) const = default;
+};
+
+struct ChunkKeyHash {
+    std::size_t operator()(const ChunkKey &key) const {
+        return ChunkCoordHash()(key.coord) ^ (static_cast<std::size_t>(key.worldSeed) * 2654435761u) ^ (static_cast<std::size_t>(key.lod) << 24);
+    }
+};
+
+// Seed for randomness local to a single chunk, derived only from the world seed, chunk coordinate and LOD.
+// It never depends on which thread generates the chunk or in which order chunks are generated.
+std::uint32_t ChunkSeed(std::uint32_t worldSeed, ChunkCoord coord, int lod = 0);
+
+struct Chunk {
+    ChunkCoord coord {};
+
+    // Seed for chunk local randomness, see ChunkSeed
+    std::uint32_t seed = 0;
+
+    // Density samples, x-major: index = x + y * CHUNK_SAMPLES + z * CHUNK_SAMPLES * CHUNK_SAMPLES
+    std::vector<float> densities = std::vector<float>(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES);
+
+    // Min/max hierarchy.
+    // If the isoLevel lies outside a range, no surface can pass through that region.
+    float minDensity = 0.0f;
+    float maxDensity = 0.0f;
+    std::array<float, BRICKS_PER_CHUNK * BRICKS_PER_CHUNK * BRICKS_PER_CHUNK> brickMin {};
+    std::array<float, BRICKS_PER_CHUNK * BRICKS_PER_CHUNK * BRICKS_PER_CHUNK> brickMax {};
+
+    // Coarser levels of the hierarchy, for long rays to cross empty space in fewer steps.
+    // Built by VoxelWorld::SampleChunk and null for chunks filled any other way.
+    // Anything that modifies the densities must rebuild or reset it.
+    std::shared_ptr<const DensityPyramid> pyramid;
+
+    static int Index(int x, int y, int z) {
+        return x + y * CHUNK_SAMPLES + z * CHUNK_SAMPLES * CHUNK_SAMPLES;
+    }
+
+    static int BrickIndex(int bx, int by, int bz) {
+        return bx + by * BRICKS_PER_CHUNK + bz * BRICKS_PER_CHUNK * BRICKS_PER_CHUNK;
+    }
+
+    float At(int x, int y, int z) const { return densities[Index(x, y, z)]; }
+
+    // Trilinearly interpolate the density at a position given in samples from the chunk origin.
+    // Positions outside of the chunk are clamped to its faces.
+    float SampleTrilinear(float x, float y, float z) const;
+
+    // Returns true if the isosurface may pass through the chunk
+    bool Straddles(float isoLevel) const { return minDensity < isoLevel && maxDensity >= isoLevel; }
+
+    // Returns true if the isosurface may pass through the brick
+    bool BrickStraddles(int brickIndex, float isoLevel) const {
+        return brickMin[brickIndex] < isoLevel && brickMax[brickIndex] >= isoLevel;
+    }
+
+    // Recompute the min/max hierarchy from the density samples.
+    // Must be called whenever the densities are modified.
+    void UpdateBounds();
+};
+
+#endif // CHUNK_H
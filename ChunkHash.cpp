@@ -0,0 +1,31 @@
+#include "ChunkHash.h"
+
+namespace {
+    constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+    constexpr std::uint64_t FNV_PRIME = 0x100000001b3ull;
+
+    std::uint64_t HashBytes(std::uint64_t hash, const void *data, std::size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+}
+
+std::uint64_t HashDensities(const Chunk &chunk) {
+    return HashBytes(FNV_OFFSET_BASIS, chunk.densities.data(), chunk.densities.size() * sizeof(float));
+}
+
+std::uint64_t HashMesh(const IndexedMesh &mesh) {
+    std::uint64_t hash = FNV_OFFSET_BASIS;
+    hash = HashBytes(hash, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vector3));
+    hash = HashBytes(hash, mesh.normals.data(), mesh.normals.size() * sizeof(Vector3));
+    hash = HashBytes(hash, mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t));
+    return hash;
+}
+
+std::uint64_t CombineHashes(std::uint64_t seed, std::uint64_t hash) {
+    return HashBytes(seed, &hash, sizeof(hash));
+}
@@ -0,0 +1,20 @@
+#ifndef CHUNKHASH_H
+#define CHUNKHASH_H
+
+#include <cstdint>
+
+#include "Chunk.h"
+#include "MarchingCubes.h"
+
+// 64 bit FNV-1a hashes of generated data, for regression checks.
+// Values are hashed by their exact bit patterns, so any change in generation or extraction
+// output, however small, changes the hash.
+
+std::uint64_t HashDensities(const Chunk &chunk);
+std::uint64_t HashMesh(const IndexedMesh &mesh);
+
+// Fold a hash into a running combined hash, e.g. to hash a whole world chunk by chunk.
+// The result depends on the order hashes are combined in, so combine in a fixed order.
+std::uint64_t CombineHashes(std::uint64_t seed, std::uint64_t hash);
+
+#endif // CHUNKHASH_H
@@ -0,0 +1,181 @@
+#include "ChunkScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <raymath.h>
+
+#include "MeshOptimizer.h"
+
+namespace {
+    // Share of its importance a chunk outside the view keeps, from directly behind the camera to just outside the view
+    constexpr float BEHIND_WEIGHT = 0.05f;
+    constexpr float BESIDE_WEIGHT = 0.25f;
+
+    // Results of cancelled chunks kept for a later request, each a chunk of samples and its mesh
+    constexpr std::size_t KEPT_CHUNK_LIMIT = 64;
+}
+
+bool IsSphereInView(const Camera3D &camera, float aspect, Vector3 center, float radius) {
+    Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    Vector3 toCenter = Vector3Subtract(center, camera.position);
+
+    // Half angle of the cone through the corners of the frustum
+    float tanHalfFovY = tanf(camera.fovy * 0.5f * DEG2RAD);
+    float halfAngle = atanf(tanHalfFovY * sqrtf(1.0f + aspect * aspect));
+
+    float along = Vector3DotProduct(toCenter, forward);
+    float across = Vector3Length(Vector3Subtract(toCenter, Vector3Scale(forward, along)));
+
+    // Signed distance from the sphere center to the cone surface
+    return across * cosf(halfAngle) - along * sinf(halfAngle) <= radius;
+}
+
+float ScreenImportance(const Camera3D &camera, float aspect, Vector3 center, float radius) {
+    Vector3 toCenter = Vector3Subtract(center, camera.position);
+    float distance = Vector3Length(toCenter);
+    if (distance <= radius) {
+        return 1.0f;
+    }
+
+    // The sphere's silhouette spans an angle of asin(radius / distance) either side of its center
+    float tanHalfFovY = tanf(camera.fovy * 0.5f * DEG2RAD);
+    float size = std::min(radius / (sqrtf(distance * distance - radius * radius) * tanHalfFovY), 1.0f);
+    if (IsSphereInView(camera, aspect, center, radius)) {
+        return size;
+    }
+
+    Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    float facing = 0.5f + 0.5f * Vector3DotProduct(forward, toCenter) / distance;
+    return size * (BEHIND_WEIGHT + (BESIDE_WEIGHT - BEHIND_WEIGHT) * facing);
+}
+
+ChunkScheduler::ChunkScheduler(TaskSystem &tasks, const VoxelWorld &world, const DensityField &field, double isoLevel, bool optimizeMeshes)
+    : tasks(tasks), world(world), field(field), isoLevel(isoLevel), optimizeMeshes(optimizeMeshes) {
+}
+
+ChunkScheduler::~ChunkScheduler() {
+    for (auto &[coord, chunk] : pending) {
+        chunk.cancel.Cancel();
+    }
+    for (auto &[coord, chunk] : pending) {
+        tasks.Wait(chunk.task);
+    }
+    for (const TaskHandle &task : cancelled) {
+        tasks.Wait(task);
+    }
+}
+
+void ChunkScheduler::Request(ChunkCoord coord) {
+    if (pending.count(coord) > 0) {
+        return;
+    }
+
+    PendingChunk &chunk = pending[coord];
+    chunk.cancel = CancelToken::Create();
+    chunk.request = nextRequest++;
+
+    std::uint64_t request = chunk.request;
+    auto keptChunk = kept.find(KeyOf(coord));
+    if (keptChunk != kept.end()) {
+        FinishedChunk result { request, std::move(keptChunk->second) };
+        kept.erase(keptChunk);
+        std::erase(keptOrder, KeyOf(coord));
+
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        finished.push_back(std::move(result));
+        return;
+    }
+
+    chunk.task = tasks.Submit([this, coord, request] {
+        FinishedChunk result;
+        result.request = request;
+
+        GeneratedChunk &generated = result.generated;
+        generated.chunk = world.SampleChunk(coord, field);
+        generated.mesh = marchingCubes.ExtractChunk(*generated.chunk, world.GetChunkOrigin(coord), world.GetVoxelSize(), isoLevel,
+                                                    &generated.stats);
+        if (optimizeMeshes && !generated.mesh.indices.empty()) {
+            OptimizeMesh(generated.mesh, &generated.stats);
+        }
+
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        finished.push_back(std::move(result));
+    }, {}, Importance(coord), chunk.cancel);
+}
+
+void ChunkScheduler::Cancel(ChunkCoord coord) {
+    auto it = pending.find(coord);
+    if (it == pending.end()) {
+        return;
+    }
+    it->second.cancel.Cancel();
+    cancelled.push_back(it->second.task);
+    pending.erase(it);
+}
+
+void ChunkScheduler::UpdatePriorities(const Camera3D &view, float viewAspect) {
+    camera = view;
+    aspect = viewAspect;
+    hasView = true;
+
+    std::erase_if(cancelled, [this](const TaskHandle &task) { return tasks.IsFinished(task); });
+
+    for (auto &[coord, chunk] : pending) {
+        tasks.SetPriority(chunk.task, Importance(coord));
+    }
+}
+
+std::vector<GeneratedChunk> ChunkScheduler::TakeFinished() {
+    std::vector<FinishedChunk> results;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        results.swap(finished);
+    }
+
+    std::vector<GeneratedChunk> generated;
+    generated.reserve(results.size());
+    for (FinishedChunk &result : results) {
+        // Cancelled after it started, and maybe requested again since
+        auto it = pending.find(result.generated.chunk->coord);
+        if (it == pending.end() || it->second.request != result.request) {
+            Keep(std::move(result.generated));
+            continue;
+        }
+        pending.erase(it);
+        generated.push_back(std::move(result.generated));
+    }
+    return generated;
+}
+
+std::vector<ChunkCoord> ChunkScheduler::GetPendingChunks() const {
+    std::vector<ChunkCoord> coords;
+    coords.reserve(pending.size());
+    for (const auto &[coord, chunk] : pending) {
+        coords.push_back(coord);
+    }
+    return coords;
+}
+
+void ChunkScheduler::Keep(GeneratedChunk generated) {
+    ChunkKey key = KeyOf(generated.chunk->coord);
+    if (kept.count(key) == 0) {
+        keptOrder.push_back(key);
+    }
+    kept[key] = std::move(generated);
+
+    while (keptOrder.size() > KEPT_CHUNK_LIMIT) {
+        kept.erase(keptOrder.front());
+        keptOrder.pop_front();
+    }
+}
+
+float ChunkScheduler::Importance(ChunkCoord coord) const {
+    if (!hasView) {
+        return 0.0f;
+    }
+
+    float halfSize = world.GetChunkWorldSize() * 0.5f;
+    Vector3 center = Vector3Add(world.GetChunkOrigin(coord), { halfSize, halfSize, halfSize });
+    return ScreenImportance(camera, aspect, center, halfSize * sqrtf(3.0f));
+}
@@ -0,0 +1,120 @@
+#ifndef CHUNKSCHEDULER_H
+#define CHUNKSCHEDULER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+#include "DensityField.h"
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+#include "TaskSystem.h"
+#include "VoxelWorld.h"
+
+// Returns true if a bounding sphere is at least partially inside the camera's view cone.
+// The cone encloses the view frustum, which is a cheap and conservative test.
+bool IsSphereInView(const Camera3D &camera, float aspect, Vector3 center, float radius);
+
+// How much a bounding sphere matters to the view: its projected height as a fraction of the screen height,
+// capped at 1 once the camera is inside it. Spheres outside the view cone count for a fraction of that,
+// more the closer they are to turning into view.
+float ScreenImportance(const Camera3D &camera, float aspect, Vector3 center, float radius);
+
+// A chunk sampled and extracted off the main thread, ready to be inserted into the world and uploaded
+struct GeneratedChunk {
+    std::unique_ptr<Chunk> chunk;
+    IndexedMesh mesh;
+    ExtractionStats stats;
+};
+
+// Generates chunks as tasks, the ones that matter most to the view first.
+//
+// Every requested chunk is sampled and extracted by one task, whose priority is the chunk's ScreenImportance.
+// UpdatePriorities ranks all chunks still queued again for the current view, so a chunk the camera turns
+// towards overtakes those it turned away from, however long they have been waiting.
+//
+// The world is only read for its layout, so the main thread is free to change it. Finished chunks are
+// collected with TakeFinished, and inserting and uploading them is up to the caller.
+//
+// A chunk cancelled after it was generated, as when the camera turns back, is kept by its ChunkKey. Generation
+// is deterministic, so a later request for the same key takes the kept result instead of generating it again.
+class ChunkScheduler {
+public:
+    ChunkScheduler(TaskSystem &tasks, const VoxelWorld &world, const DensityField &field, double isoLevel, bool optimizeMeshes);
+
+    // Cancels every pending chunk, and waits for the ones running
+    ~ChunkScheduler();
+
+    ChunkScheduler(const ChunkScheduler &) = delete;
+    ChunkScheduler &operator=(const ChunkScheduler &) = delete;
+
+    // Queue a chunk for generation, unless it is already pending.
+    // A kept result for the chunk is handed out by the next TakeFinished without running a task.
+    void Request(ChunkCoord coord);
+
+    // Drop a pending chunk. Its result is discarded even if it has already been generated.
+    void Cancel(ChunkCoord coord);
+
+    bool IsPending(ChunkCoord coord) const { return pending.count(coord) > 0; }
+    int GetPendingCount() const { return static_cast<int>(pending.size()); }
+
+    // Rank queued chunks for the view, and new requests until the next call. Call once a frame.
+    void UpdatePriorities(const Camera3D &camera, float aspect);
+
+    // Chunks generated since the last call, in the order they finished
+    std::vector<GeneratedChunk> TakeFinished();
+
+    // All pending chunks, in no particular order
+    std::vector<ChunkCoord> GetPendingChunks() const;
+
+private:
+    struct PendingChunk {
+        TaskHandle task;
+        CancelToken cancel;
+        std::uint64_t request;
+    };
+
+    struct FinishedChunk {
+        std::uint64_t request;
+        GeneratedChunk generated;
+    };
+
+    float Importance(ChunkCoord coord) const;
+    ChunkKey KeyOf(ChunkCoord coord) const { return { field.GetSeed(), coord, 0 }; }
+
+    // Keep a discarded result for a later request, dropping the oldest beyond the limit
+    void Keep(GeneratedChunk generated);
+
+    TaskSystem &tasks;
+    const VoxelWorld &world;
+    const DensityField &field;
+    double isoLevel;
+    bool optimizeMeshes;
+    MarchingCubes marchingCubes;
+
+    // Main thread only. A request number tells a result apart from one of a cancelled earlier request.
+    std::unordered_map<ChunkCoord, PendingChunk, ChunkCoordHash> pending;
+    std::uint64_t nextRequest = 0;
+
+    // Cancelled chunks that may still be running, which must finish before the scheduler goes away
+    std::vector<TaskHandle> cancelled;
+
+    // Main thread only. Results of cancelled chunks, and their keys from oldest to newest.
+    std::unordered_map<ChunkKey, GeneratedChunk, ChunkKeyHash> kept;
+    std::deque<ChunkKey> keptOrder;
+
+    Camera3D camera = {};
+    float aspect = 1.0f;
+    bool hasView = false;
+
+    std::mutex finishedMutex;
+    std::vector<FinishedChunk> finished;
+};
+
+#endif // CHUNKSCHEDULER_H
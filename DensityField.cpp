@@ -0,0 +1,36 @@
+#include "DensityField.h"
+
+void DensityField::SampleBlock(Vector3 origin, float spacing, int size, float *out) const {
+    for (int z = 0; z < size; z++) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                Vector3 position = {
+                    origin.x + x * spacing,
+                    origin.y + y * spacing,
+                    origin.z + z * spacing
+                };
+                *out++ = Sample(position);
+            }
+        }
+    }
+}
+
+FastNoiseLite CreateTerrainNoise(int seed, float frequency) {
+    FastNoiseLite noise;
+    noise.SetSeed(seed);
+    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+    noise.SetFractalOctaves(4);
+    noise.SetFrequency(frequency);
+    return noise;
+}
+
+TerrainDensityField::TerrainDensityField(int seed, float baseHeight, float amplitude, float frequency)
+    : noise(CreateTerrainNoise(seed, frequency)), seed(seed), baseHeight(baseHeight), amplitude(amplitude) {
+}
+
+float TerrainDensityField::Sample(Vector3 position) const {
+    // Negative below the terrain height (inside), positive above it (outside)
+    float height = baseHeight + noise.GetNoise(position.x, position.z) * amplitude;
+    return position.y - height;
+}
@@ -0,0 +1,48 @@
+#ifndef DENSITYFIELD_H
+#define DENSITYFIELD_H
+
+#include <cstdint>
+
+#include <raylib.h>
+
+#include "libs/fastnoiselite/FastNoiseLite.h"
+
+// A scalar field that can be sampled anywhere in world space.
+// Points with a density below the isoLevel are considered inside the surface.
+class DensityField {
+public:
+    virtual ~DensityField() = default;
+
+    // Sample the density at a single world space position
+    virtual float Sample(Vector3 position) const = 0;
+
+    // Fill a block of size * size * size samples, x-major, starting at origin with the given spacing.
+    // Override this when a field can evaluate a whole block faster than one sample at a time.
+    virtual void SampleBlock(Vector3 origin, float spacing, int size, float *out) const;
+
+    // Seed the field was built from. Chunks derive their own seeds from it, see ChunkSeed.
+    virtual std::uint32_t GetSeed() const { return 0; }
+};
+
+// Noise used for terrain heightmaps, shared by every density path that builds terrain
+FastNoiseLite CreateTerrainNoise(int seed, float frequency);
+
+// Rolling terrain: a noise heightmap where everything below the height is solid.
+// Heights vary by amplitude around baseHeight.
+// The noise is a pure function of the seed and position, so chunks come out bit-identical
+// no matter which thread generates them or in which order.
+class TerrainDensityField : public DensityField {
+public:
+    explicit TerrainDensityField(int seed = 1337, float baseHeight = 0.0f, float amplitude = 12.0f, float frequency = 0.01f);
+
+    float Sample(Vector3 position) const override;
+    std::uint32_t GetSeed() const override { return static_cast<std::uint32_t>(seed); }
+
+private:
+    FastNoiseLite noise;
+    int seed;
+    float baseHeight;
+    float amplitude;
+};
+
+#endif // DENSITYFIELD_H
@@ -0,0 +1,349 @@
+#include "DensityProgram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    DensityExpr MakeLeaf(DensityOp op, std::vector<float> params) {
+        return std::make_shared<DensityNode>(DensityNode { op, std::move(params), nullptr, nullptr });
+    }
+
+    DensityExpr MakeBinary(DensityOp op, DensityExpr a, DensityExpr b, std::vector<float> params = {}) {
+        return std::make_shared<DensityNode>(DensityNode { op, std::move(params), std::move(a), std::move(b) });
+    }
+
+    bool IsPrimitive(DensityOp op) {
+        return op == DensityOp::Sphere || op == DensityOp::Box || op == DensityOp::Capsule || op == DensityOp::Torus ||
+               op == DensityOp::Terrain;
+    }
+}
+
+DensityExpr SdfSphere(Vector3 center, float radius) {
+    return MakeLeaf(DensityOp::Sphere, { center.x, center.y, center.z, radius });
+}
+
+DensityExpr SdfBox(Vector3 center, Vector3 halfExtents) {
+    return MakeLeaf(DensityOp::Box, { center.x, center.y, center.z, halfExtents.x, halfExtents.y, halfExtents.z });
+}
+
+DensityExpr SdfCapsule(Vector3 start, Vector3 end, float radius) {
+    return MakeLeaf(DensityOp::Capsule, { start.x, start.y, start.z, end.x, end.y, end.z, radius });
+}
+
+DensityExpr SdfTorus(Vector3 center, float majorRadius, float minorRadius) {
+    return MakeLeaf(DensityOp::Torus, { center.x, center.y, center.z, majorRadius, minorRadius });
+}
+
+DensityExpr NoiseTerrain(int seed, float baseHeight, float amplitude, float frequency) {
+    return MakeLeaf(DensityOp::Terrain, { static_cast<float>(seed), baseHeight, amplitude, frequency });
+}
+
+DensityExpr CsgUnion(DensityExpr a, DensityExpr b) {
+    return MakeBinary(DensityOp::Union, std::move(a), std::move(b));
+}
+
+DensityExpr CsgSubtract(DensityExpr a, DensityExpr b) {
+    return MakeBinary(DensityOp::Subtract, std::move(a), std::move(b));
+}
+
+DensityExpr CsgIntersect(DensityExpr a, DensityExpr b) {
+    return MakeBinary(DensityOp::Intersect, std::move(a), std::move(b));
+}
+
+DensityExpr CsgSmoothUnion(DensityExpr a, DensityExpr b, float blendRadius) {
+    return MakeBinary(DensityOp::SmoothUnion, std::move(a), std::move(b), { std::max(blendRadius, 1e-6f) });
+}
+
+DensityProgram::DensityProgram(const DensityExpr &root) : stackDepth(0) {
+    if (root == nullptr) {
+        throw std::invalid_argument("DensityProgram: expression is empty");
+    }
+
+    Emit(*root, 0);
+}
+
+void DensityProgram::Emit(const DensityNode &node, int depth) {
+    if (!IsPrimitive(node.op)) {
+        if (node.left == nullptr || node.right == nullptr) {
+            throw std::invalid_argument("DensityProgram: operation is missing an operand");
+        }
+
+        // Post-order, so both operands are on the stack when the operation runs
+        Emit(*node.left, depth);
+        Emit(*node.right, depth + 1);
+    } else {
+        stackDepth = std::max(stackDepth, depth + 1);
+    }
+
+    code.push_back({ node.op, static_cast<std::uint32_t>(constants.size()) });
+
+    if (node.op == DensityOp::Terrain) {
+        // Build the noise generator once, the instruction refers to it by index
+        noises.push_back(CreateTerrainNoise(static_cast<int>(node.params[0]), node.params[3]));
+        constants.push_back(static_cast<float>(noises.size() - 1));
+        constants.push_back(node.params[1]);
+        constants.push_back(node.params[2]);
+    } else {
+        constants.insert(constants.end(), node.params.begin(), node.params.end());
+    }
+}
+
+float DensityProgram::Sample(Vector3 position) const {
+    thread_local std::vector<float> stack;
+    stack.resize(static_cast<std::size_t>(stackDepth) * BATCH_SIZE);
+
+    float out;
+    Execute(&position.x, &position.y, &position.z, 1, stack.data(), &out);
+    return out;
+}
+
+void DensityProgram::SampleBlock(Vector3 origin, float spacing, int size, float *out) const {
+    std::vector<float> stack(static_cast<std::size_t>(stackDepth) * BATCH_SIZE);
+    float xs[BATCH_SIZE];
+    float ys[BATCH_SIZE];
+    float zs[BATCH_SIZE];
+
+    // Walk the block in x-major order, a batch of points at a time
+    const int total = size * size * size;
+    int x = 0, y = 0, z = 0;
+    for (int start = 0; start < total; start += BATCH_SIZE) {
+        int count = std::min(BATCH_SIZE, total - start);
+        for (int i = 0; i < count; i++) {
+            xs[i] = origin.x + x * spacing;
+            ys[i] = origin.y + y * spacing;
+            zs[i] = origin.z + z * spacing;
+
+            if (++x == size) {
+                x = 0;
+                if (++y == size) {
+                    y = 0;
+                    z++;
+                }
+            }
+        }
+
+        Execute(xs, ys, zs, count, stack.data(), out + start);
+    }
+}
+
+void DensityProgram::Execute(const float *xs, const float *ys, const float *zs, int count, float *stack, float *out) const {
+    int top = 0;
+
+    for (const Instruction &instruction : code) {
+        const float *p = constants.data() + instruction.param;
+
+        if (IsPrimitive(instruction.op)) {
+            float *dst = stack + top * BATCH_SIZE;
+            top++;
+
+            switch (instruction.op) {
+                case DensityOp::Sphere:
+                    for (int i = 0; i < count; i++) {
+                        float dx = xs[i] - p[0], dy = ys[i] - p[1], dz = zs[i] - p[2];
+                        dst[i] = std::sqrt(dx * dx + dy * dy + dz * dz) - p[3];
+                    }
+                    break;
+
+                case DensityOp::Box:
+                    for (int i = 0; i < count; i++) {
+                        float qx = std::abs(xs[i] - p[0]) - p[3];
+                        float qy = std::abs(ys[i] - p[1]) - p[4];
+                        float qz = std::abs(zs[i] - p[2]) - p[5];
+                        float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f), oz = std::max(qz, 0.0f);
+                        float outside = std::sqrt(ox * ox + oy * oy + oz * oz);
+                        float inside = std::min(std::max(qx, std::max(qy, qz)), 0.0f);
+                        dst[i] = outside + inside;
+                    }
+                    break;
+
+                case DensityOp::Capsule: {
+                    float bax = p[3] - p[0], bay = p[4] - p[1], baz = p[5] - p[2];
+                    float inverseLengthSqr = 1.0f / std::max(bax * bax + bay * bay + baz * baz, 1e-12f);
+                    for (int i = 0; i < count; i++) {
+                        float pax = xs[i] - p[0], pay = ys[i] - p[1], paz = zs[i] - p[2];
+                        float h = std::clamp((pax * bax + pay * bay + paz * baz) * inverseLengthSqr, 0.0f, 1.0f);
+                        float dx = pax - bax * h, dy = pay - bay * h, dz = paz - baz * h;
+                        dst[i] = std::sqrt(dx * dx + dy * dy + dz * dz) - p[6];
+                    }
+                    break;
+                }
+
+                case DensityOp::Torus:
+                    for (int i = 0; i < count; i++) {
+                        float dx = xs[i] - p[0], dy = ys[i] - p[1], dz = zs[i] - p[2];
+                        float ring = std::sqrt(dx * dx + dz * dz) - p[3];
+                        dst[i] = std::sqrt(ring * ring + dy * dy) - p[4];
+                    }
+                    break;
+
+                case DensityOp::Terrain: {
+                    const FastNoiseLite &noise = noises[static_cast<std::size_t>(p[0])];
+                    for (int i = 0; i < count; i++) {
+                        dst[i] = ys[i] - (p[1] + noise.GetNoise(xs[i], zs[i]) * p[2]);
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        } else {
+            top--;
+            float *a = stack + (top - 1) * BATCH_SIZE;
+            const float *b = stack + top * BATCH_SIZE;
+
+            switch (instruction.op) {
+                case DensityOp::Union:
+                    for (int i = 0; i < count; i++) {
+                        a[i] = std::min(a[i], b[i]);
+                    }
+                    break;
+
+                case DensityOp::Subtract:
+                    for (int i = 0; i < count; i++) {
+                        a[i] = std::max(a[i], -b[i]);
+                    }
+                    break;
+
+                case DensityOp::Intersect:
+                    for (int i = 0; i < count; i++) {
+                        a[i] = std::max(a[i], b[i]);
+                    }
+                    break;
+
+                case DensityOp::SmoothUnion: {
+                    // Polynomial smooth minimum
+                    float k = p[0];
+                    for (int i = 0; i < count; i++) {
+                        float h = std::clamp(0.5f + 0.5f * (b[i] - a[i]) / k, 0.0f, 1.0f);
+                        a[i] = b[i] + (a[i] - b[i]) * h - k * h * (1.0f - h);
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    std::copy(stack, stack + count, out);
+}
+
+bool ParseDensityScene(const std::string &text, DensityExpr &root, std::string &error) {
+    struct Statement {
+        const char *name;
+        int paramCount;
+        bool binary;
+    };
+    static constexpr Statement statements[] = {
+        { "sphere", 4, false },
+        { "box", 6, false },
+        { "capsule", 7, false },
+        { "torus", 5, false },
+        { "terrain", 4, false },
+        { "union", 0, true },
+        { "subtract", 0, true },
+        { "intersect", 0, true },
+        { "smooth-union", 1, true }
+    };
+
+    std::vector<DensityExpr> stack;
+    std::istringstream lines(text);
+    std::string line;
+    for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string name;
+        if (!(words >> name)) {
+            continue;
+        }
+
+        const std::string where = "line " + std::to_string(lineNumber) + ": ";
+        const Statement *statement = nullptr;
+        for (const Statement &candidate : statements) {
+            if (name == candidate.name) {
+                statement = &candidate;
+            }
+        }
+        if (statement == nullptr) {
+            error = where + "unknown shape or operation '" + name + "'";
+            return false;
+        }
+
+        std::vector<float> p;
+        float value;
+        while (words >> value) {
+            p.push_back(value);
+        }
+        if (!words.eof()) {
+            error = where + "parameters must be numbers";
+            return false;
+        }
+        if (static_cast<int>(p.size()) != statement->paramCount) {
+            error = where + name + " takes " + std::to_string(statement->paramCount) + " parameters";
+            return false;
+        }
+
+        if (!statement->binary) {
+            if (name == "sphere") {
+                stack.push_back(SdfSphere({ p[0], p[1], p[2] }, p[3]));
+            } else if (name == "box") {
+                stack.push_back(SdfBox({ p[0], p[1], p[2] }, { p[3], p[4], p[5] }));
+            } else if (name == "capsule") {
+                stack.push_back(SdfCapsule({ p[0], p[1], p[2] }, { p[3], p[4], p[5] }, p[6]));
+            } else if (name == "torus") {
+                stack.push_back(SdfTorus({ p[0], p[1], p[2] }, p[3], p[4]));
+            } else {
+                stack.push_back(NoiseTerrain(static_cast<int>(p[0]), p[1], p[2], p[3]));
+            }
+            continue;
+        }
+
+        if (stack.size() < 2) {
+            error = where + name + " needs two shapes before it";
+            return false;
+        }
+        DensityExpr b = std::move(stack.back());
+        stack.pop_back();
+        DensityExpr a = std::move(stack.back());
+        stack.pop_back();
+
+        if (name == "union") {
+            stack.push_back(CsgUnion(std::move(a), std::move(b)));
+        } else if (name == "subtract") {
+            stack.push_back(CsgSubtract(std::move(a), std::move(b)));
+        } else if (name == "intersect") {
+            stack.push_back(CsgIntersect(std::move(a), std::move(b)));
+        } else {
+            stack.push_back(CsgSmoothUnion(std::move(a), std::move(b), p[0]));
+        }
+    }
+
+    if (stack.size() != 1) {
+        error = stack.empty() ? "the scene is empty" : std::to_string(stack.size()) + " shapes are left uncombined at the end of the scene";
+        return false;
+    }
+
+    root = std::move(stack.front());
+    return true;
+}
+
+bool LoadDensityScene(const std::string &path, DensityExpr &root, std::string &error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open '" + path + "'";
+        return false;
+    }
+
+    std::ostringstream text;
+    text << file.rdbuf();
+    if (!ParseDensityScene(text.str(), root, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,220 @@
+#include "DensityPyramid.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+// The reductions work a row of output at a time. The source rows under it are first folded together
+// element by element, which runs over contiguous floats and vectorizes, and only the single folded
+// row is then reduced along x.
+
+namespace {
+    // Averages of one level from the samples of the level above, which has 2 * (samples - 1) + 1 per axis.
+    // Only samples from (x0, y0, z0) to (x1, y1, z1) are recomputed.
+    void FilterAverages(const float *source, int samples, float *out,
+                        std::array<int, 3> lo, std::array<int, 3> hi) {
+        const int sourceSamples = 2 * (samples - 1) + 1;
+        float row[CHUNK_SAMPLES];
+
+        // The tent along one axis: a face sample is only filtered along the face, so it keeps its own value
+        auto taps = [samples](int i, int &first, int &count, const float *&weights) {
+            static constexpr float TENT[3] = { 0.25f, 0.5f, 0.25f };
+            static constexpr float CENTRE[1] = { 1.0f };
+            bool face = i == 0 || i == samples - 1;
+            first = face ? 2 * i : 2 * i - 1;
+            count = face ? 1 : 3;
+            weights = face ? CENTRE : TENT;
+        };
+
+        const int rowBegin = std::max(2 * lo[0] - 1, 0);
+        const int rowEnd = std::min(2 * hi[0] + 1, sourceSamples - 1);
+
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            int firstZ, countZ;
+            const float *weightsZ;
+            taps(z, firstZ, countZ, weightsZ);
+
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                int firstY, countY;
+                const float *weightsY;
+                taps(y, firstY, countY, weightsY);
+
+                for (int k = 0; k < countZ; k++) {
+                    for (int j = 0; j < countY; j++) {
+                        const float *sourceRow = source + ((firstY + j) + (firstZ + k) * sourceSamples) * sourceSamples;
+                        const float weight = weightsY[j] * weightsZ[k];
+                        if (j == 0 && k == 0) {
+                            for (int i = rowBegin; i <= rowEnd; i++) {
+                                row[i] = weight * sourceRow[i];
+                            }
+                        } else {
+                            for (int i = rowBegin; i <= rowEnd; i++) {
+                                row[i] += weight * sourceRow[i];
+                            }
+                        }
+                    }
+                }
+
+                float *outRow = out + (y + z * samples) * samples;
+                for (int x = lo[0]; x <= hi[0]; x++) {
+                    outRow[x] = x == 0 || x == samples - 1 ? row[2 * x] : 0.25f * row[2 * x - 1] + 0.5f * row[2 * x] + 0.25f * row[2 * x + 1];
+                }
+            }
+        }
+    }
+
+    // Min and max of cells from (x0, y0, z0) to (x1, y1, z1), where cell i along an axis covers sources
+    // 2i to 2i + span - 1: the three samples under a cell of the first level, or the two cells under
+    // a cell of the others.
+    void ReduceCells(const float *sourceMin, const float *sourceMax, int sourceSize, int span, float *outMin, float *outMax,
+                     int cells, std::array<int, 3> lo, std::array<int, 3> hi) {
+        float rowMin[CHUNK_SAMPLES];
+        float rowMax[CHUNK_SAMPLES];
+
+        const int rowBegin = 2 * lo[0];
+        const int rowEnd = 2 * hi[0] + span - 1;
+
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                for (int k = 0; k < span; k++) {
+                    for (int j = 0; j < span; j++) {
+                        std::size_t offset = static_cast<std::size_t>((2 * y + j) + (2 * z + k) * sourceSize) * sourceSize;
+                        const float *sourceMinRow = sourceMin + offset;
+                        const float *sourceMaxRow = sourceMax + offset;
+                        if (j == 0 && k == 0) {
+                            std::copy(sourceMinRow + rowBegin, sourceMinRow + rowEnd + 1, rowMin + rowBegin);
+                            std::copy(sourceMaxRow + rowBegin, sourceMaxRow + rowEnd + 1, rowMax + rowBegin);
+                        } else {
+                            for (int i = rowBegin; i <= rowEnd; i++) {
+                                rowMin[i] = std::min(rowMin[i], sourceMinRow[i]);
+                                rowMax[i] = std::max(rowMax[i], sourceMaxRow[i]);
+                            }
+                        }
+                    }
+                }
+
+                int outRow = (y + z * cells) * cells;
+                for (int x = lo[0]; x <= hi[0]; x++) {
+                    float low = rowMin[2 * x];
+                    float high = rowMax[2 * x];
+                    for (int i = 1; i < span; i++) {
+                        low = std::min(low, rowMin[2 * x + i]);
+                        high = std::max(high, rowMax[2 * x + i]);
+                    }
+                    outMin[outRow + x] = low;
+                    outMax[outRow + x] = high;
+                }
+            }
+        }
+    }
+}
+
+DensityPyramid::DensityPyramid() {
+    averages.reserve(PYRAMID_LEVELS - 1);
+    for (int level = 1; level < PYRAMID_LEVELS; level++) {
+        int samples = SamplesPerAxis(level);
+        int cells = CellsPerAxis(level);
+        averages.emplace_back(samples, samples, samples);
+        cellMin[level - 1].resize(cells * cells * cells);
+        cellMax[level - 1].resize(cells * cells * cells);
+    }
+    InvalidateAll();
+}
+
+void DensityPyramid::Invalidate(int x0, int y0, int z0, int x1, int y1, int z1) {
+    SampleBox box = {
+        { std::clamp(x0, 0, CHUNK_SIZE), std::clamp(y0, 0, CHUNK_SIZE), std::clamp(z0, 0, CHUNK_SIZE) },
+        { std::clamp(x1, 0, CHUNK_SIZE), std::clamp(y1, 0, CHUNK_SIZE), std::clamp(z1, 0, CHUNK_SIZE) }
+    };
+
+    if (!dirty) {
+        dirtyBox = box;
+        dirty = true;
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        dirtyBox.min[axis] = std::min(dirtyBox.min[axis], box.min[axis]);
+        dirtyBox.max[axis] = std::max(dirtyBox.max[axis], box.max[axis]);
+    }
+}
+
+void DensityPyramid::InvalidateAll() {
+    dirtyBox = { { 0, 0, 0 }, { CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE } };
+    dirty = true;
+}
+
+void DensityPyramid::Update(const Chunk &chunk) {
+    if (!dirty) {
+        return;
+    }
+    PROFILE_SCOPE(ProfileZone::DensityFill);
+
+    // Changed samples of the level above, which the averages of each level are filtered from
+    std::array<int, 3> averagesLo = dirtyBox.min;
+    std::array<int, 3> averagesHi = dirtyBox.max;
+
+    for (int level = 1; level < PYRAMID_LEVELS; level++) {
+        int samples = SamplesPerAxis(level);
+        int cells = CellsPerAxis(level);
+
+        // A coarse sample is filtered from the samples next to the one it replaces
+        for (int axis = 0; axis < 3; axis++) {
+            averagesLo[axis] = averagesLo[axis] / 2;
+            averagesHi[axis] = std::min((averagesHi[axis] + 1) / 2, samples - 1);
+        }
+        const float *source = level == 1 ? chunk.densities.data() : averages[level - 2].GetData();
+        FilterAverages(source, samples, averages[level - 1].GetData(), averagesLo, averagesHi);
+
+        // A cell covers chunk samples cell << level to (cell + 1) << level
+        std::array<int, 3> cellsLo;
+        std::array<int, 3> cellsHi;
+        for (int axis = 0; axis < 3; axis++) {
+            cellsLo[axis] = std::max(((dirtyBox.min[axis] + (1 << level) - 1) >> level) - 1, 0);
+            cellsHi[axis] = std::min(dirtyBox.max[axis] >> level, cells - 1);
+        }
+        if (level == 1) {
+            ReduceCells(chunk.densities.data(), chunk.densities.data(), CHUNK_SAMPLES, 3,
+                        cellMin[0].data(), cellMax[0].data(), cells, cellsLo, cellsHi);
+        } else {
+            ReduceCells(cellMin[level - 2].data(), cellMax[level - 2].data(), 2 * cells, 2,
+                        cellMin[level - 1].data(), cellMax[level - 1].data(), cells, cellsLo, cellsHi);
+        }
+    }
+
+    dirty = false;
+}
+
+float DensityPyramid::SampleTrilinear(int level, float x, float y, float z) const {
+    const SampleGrid<LinearLayout> &grid = averages[level - 1];
+    const float scale = 1.0f / static_cast<float>(1 << level);
+    const int cells = CellsPerAxis(level);
+    x *= scale;
+    y *= scale;
+    z *= scale;
+
+    int cx = std::clamp(static_cast<int>(x), 0, cells - 1);
+    int cy = std::clamp(static_cast<int>(y), 0, cells - 1);
+    int cz = std::clamp(static_cast<int>(z), 0, cells - 1);
+
+    float u = std::clamp(x - cx, 0.0f, 1.0f);
+    float v = std::clamp(y - cy, 0.0f, 1.0f);
+    float w = std::clamp(z - cz, 0.0f, 1.0f);
+
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    float x00 = lerp(grid.At(cx, cy, cz), grid.At(cx + 1, cy, cz), u);
+    float x10 = lerp(grid.At(cx, cy + 1, cz), grid.At(cx + 1, cy + 1, cz), u);
+    float x01 = lerp(grid.At(cx, cy, cz + 1), grid.At(cx + 1, cy, cz + 1), u);
+    float x11 = lerp(grid.At(cx, cy + 1, cz + 1), grid.At(cx + 1, cy + 1, cz + 1), u);
+
+    return lerp(lerp(x00, x10, v), lerp(x01, x11, v), w);
+}
+
+std::size_t DensityPyramid::GetMemoryBytes() const {
+    std::size_t bytes = 0;
+    for (int level = 1; level < PYRAMID_LEVELS; level++) {
+        bytes += averages[level - 1].GetMemoryBytes();
+        bytes += (cellMin[level - 1].capacity() + cellMax[level - 1].capacity()) * sizeof(float);
+    }
+    return bytes;
+}
@@ -0,0 +1,83 @@
+#ifndef DENSITYPYRAMID_H
+#define DENSITYPYRAMID_H
+
+#include <array>
+#include <vector>
+
+#include "Chunk.h"
+#include "SampleGrid.h"
+
+// Coarse levels of a chunk's density samples, so LOD meshes and long-range queries read a few
+// pre-reduced values instead of striding through every fine sample.
+//
+// Level 0 is the chunk itself. Level L has CHUNK_SIZE >> L cells along each axis, each covering 2^L
+// cells of the chunk, down to a single cell at level PYRAMID_LEVELS - 1. Every level has:
+// - averages, one sample per cell corner, placed exactly on the chunk sample they replace, so a level
+//   can be polygonised like a chunk with 2^L times the voxel size. Each is a 1/4, 1/2, 1/4 tent over
+//   the level above. On a chunk face only samples of that face are filtered, so neighbouring chunks
+//   agree on the coarse samples they share.
+// - min and max per cell over every chunk sample it covers, faces included. Like the bricks of a chunk,
+//   if the isoLevel lies outside a cell's range no surface passes through any of the cells below it.
+//
+// The pyramid is built on demand by Update, which after the first build only recomputes what lies
+// under the samples passed to Invalidate since.
+constexpr int PYRAMID_LEVELS = 6;
+static_assert(CHUNK_SIZE >> (PYRAMID_LEVELS - 1) == 1, "the last pyramid level is a single cell");
+
+class DensityPyramid {
+public:
+    DensityPyramid();
+
+    static int CellsPerAxis(int level) { return CHUNK_SIZE >> level; }
+    static int SamplesPerAxis(int level) { return CellsPerAxis(level) + 1; }
+
+    // Mark the chunk samples from (x0, y0, z0) to (x1, y1, z1), inclusive, as changed.
+    // Call it along with Chunk::UpdateBounds whenever samples of the chunk are edited.
+    void Invalidate(int x0, int y0, int z0, int x1, int y1, int z1);
+    void InvalidateAll();
+
+    // True if the pyramid has not been built, or samples were invalidated since it was last updated
+    bool IsDirty() const { return dirty; }
+
+    // Bring every level up to date with the chunk's samples
+    void Update(const Chunk &chunk);
+
+    // Averages of a level from 1 to PYRAMID_LEVELS - 1, SamplesPerAxis(level) along each axis
+    const SampleGrid<LinearLayout> &GetAverages(int level) const { return averages[level - 1]; }
+
+    float CellMin(int level, int x, int y, int z) const { return cellMin[level - 1][CellIndex(level, x, y, z)]; }
+    float CellMax(int level, int x, int y, int z) const { return cellMax[level - 1][CellIndex(level, x, y, z)]; }
+
+    // Returns true if the isosurface may pass through the cell
+    bool CellStraddles(int level, int x, int y, int z, float isoLevel) const {
+        int index = CellIndex(level, x, y, z);
+        return cellMin[level - 1][index] < isoLevel && cellMax[level - 1][index] >= isoLevel;
+    }
+
+    // Trilinearly interpolate the averages of a level at a position given in chunk samples, like
+    // Chunk::SampleTrilinear. Positions outside of the chunk are clamped to its faces.
+    float SampleTrilinear(int level, float x, float y, float z) const;
+
+    std::size_t GetMemoryBytes() const;
+
+private:
+    static int CellIndex(int level, int x, int y, int z) {
+        int cells = CellsPerAxis(level);
+        return x + (y + z * cells) * cells;
+    }
+
+    // Samples invalidated since the last update, inclusive
+    struct SampleBox {
+        std::array<int, 3> min;
+        std::array<int, 3> max;
+    };
+
+    bool dirty = true;
+    SampleBox dirtyBox;
+
+    std::vector<SampleGrid<LinearLayout>> averages;
+    std::array<std::vector<float>, PYRAMID_LEVELS - 1> cellMin;
+    std::array<std::vector<float>, PYRAMID_LEVELS - 1> cellMax;
+};
+
+#endif // DENSITYPYRAMID_H
@@ -0,0 +1,201 @@
+#include "DensitySampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+    struct CacheEntry {
+        ChunkCoord coord;
+        const Chunk *chunk;     // nullptr caches a chunk that has not been generated
+        std::uint64_t lastUse;
+    };
+
+    struct ChunkCache {
+        // World versions are unique across worlds, so they alone tell whether the entries still hold.
+        // Version 0 is never handed out.
+        std::uint64_t version = 0;
+        std::uint64_t tick = 0;
+        int size = 0;
+        int last = 0;       // Entry returned by the previous lookup
+        std::array<CacheEntry, DensitySampler::CACHE_SIZE> entries {};
+    };
+
+    thread_local ChunkCache cache;
+
+    // Queries of a batch that fall into the same chunk
+    struct Group {
+        ChunkCoord coord;
+        int start;      // First entry in the sorted order
+        int count;
+    };
+}
+
+DensitySampler::DensitySampler(const VoxelWorld &world) : world(world) {
+}
+
+const Chunk *DensitySampler::FindChunk(ChunkCoord coord) const {
+    if (cache.version != world.GetVersion()) {
+        cache.version = world.GetVersion();
+        cache.size = 0;
+        cache.last = 0;
+    }
+
+    // Most queries land in the same chunk as the one before
+    CacheEntry &last = cache.entries[cache.last];
+    if (cache.size > 0 && last.coord == coord) {
+        return last.chunk;
+    }
+
+    cache.tick++;
+
+    int oldest = 0;
+    for (int i = 0; i < cache.size; i++) {
+        CacheEntry &entry = cache.entries[i];
+        if (entry.coord == coord) {
+            entry.lastUse = cache.tick;
+            cache.last = i;
+            return entry.chunk;
+        }
+
+        if (entry.lastUse < cache.entries[oldest].lastUse) {
+            oldest = i;
+        }
+    }
+
+    int slot = cache.size < CACHE_SIZE ? cache.size++ : oldest;
+    cache.entries[slot] = { coord, world.FindChunk(coord), cache.tick };
+    cache.last = slot;
+    return cache.entries[slot].chunk;
+}
+
+float DensitySampler::SampleChunk(const Chunk &chunk, ChunkCoord coord, Vector3 position) const {
+    Vector3 origin = world.GetChunkOrigin(coord);
+    float inverseVoxelSize = 1.0f / world.GetVoxelSize();
+    return chunk.SampleTrilinear((position.x - origin.x) * inverseVoxelSize,
+                                 (position.y - origin.y) * inverseVoxelSize,
+                                 (position.z - origin.z) * inverseVoxelSize);
+}
+
+std::optional<float> DensitySampler::Sample(Vector3 position) const {
+    ChunkCoord coord = world.WorldToChunk(position);
+    const Chunk *chunk = FindChunk(coord);
+    if (chunk == nullptr) {
+        return std::nullopt;
+    }
+
+    return SampleChunk(*chunk, coord, position);
+}
+
+std::optional<Vector3> DensitySampler::SampleGradient(Vector3 position) const {
+    float voxelSize = world.GetVoxelSize();
+    float scale = 1.0f / (2.0f * voxelSize);
+
+    // When all six taps lie in the chunk containing the position, sample it directly
+    // instead of going through the chunk lookup six times
+    ChunkCoord coord = world.WorldToChunk(position);
+    Vector3 origin = world.GetChunkOrigin(coord);
+    float lx = (position.x - origin.x) / voxelSize;
+    float ly = (position.y - origin.y) / voxelSize;
+    float lz = (position.z - origin.z) / voxelSize;
+
+    if (lx >= 1.0f && lx <= CHUNK_SIZE - 1 && ly >= 1.0f && ly <= CHUNK_SIZE - 1 && lz >= 1.0f && lz <= CHUNK_SIZE - 1) {
+        const Chunk *chunk = FindChunk(coord);
+        if (chunk == nullptr) {
+            return std::nullopt;
+        }
+
+        return Vector3 {
+            (chunk->SampleTrilinear(lx + 1.0f, ly, lz) - chunk->SampleTrilinear(lx - 1.0f, ly, lz)) * scale,
+            (chunk->SampleTrilinear(lx, ly + 1.0f, lz) - chunk->SampleTrilinear(lx, ly - 1.0f, lz)) * scale,
+            (chunk->SampleTrilinear(lx, ly, lz + 1.0f) - chunk->SampleTrilinear(lx, ly, lz - 1.0f)) * scale
+        };
+    }
+
+    std::optional<float> px = Sample({ position.x + voxelSize, position.y, position.z });
+    std::optional<float> nx = Sample({ position.x - voxelSize, position.y, position.z });
+    std::optional<float> py = Sample({ position.x, position.y + voxelSize, position.z });
+    std::optional<float> ny = Sample({ position.x, position.y - voxelSize, position.z });
+    std::optional<float> pz = Sample({ position.x, position.y, position.z + voxelSize });
+    std::optional<float> nz = Sample({ position.x, position.y, position.z - voxelSize });
+
+    if (!px || !nx || !py || !ny || !pz || !nz) {
+        return std::nullopt;
+    }
+
+    return Vector3 { (*px - *nx) * scale, (*py - *ny) * scale, (*pz - *nz) * scale };
+}
+
+int DensitySampler::SampleBatch(const Vector3 *positions, int count, float *out) const {
+    // Scratch buffers are reused between batches, so a thread sampling every frame does not allocate
+    thread_local std::vector<ChunkCoord> coords;
+    thread_local std::vector<int> groupOf;
+    thread_local std::vector<Group> groups;
+    thread_local std::vector<int> order;
+    thread_local std::vector<int> table;
+
+    coords.resize(count);
+    groupOf.resize(count);
+    order.resize(count);
+    groups.clear();
+
+    // Open addressing table from chunk coordinate to group, sized for one group per query at worst.
+    // A batch usually touches only a few chunks, so the table stays small and hot.
+    std::size_t tableSize = 16;
+    while (tableSize < static_cast<std::size_t>(count) * 2) {
+        tableSize *= 2;
+    }
+    table.assign(tableSize, -1);
+
+    for (int i = 0; i < count; i++) {
+        ChunkCoord coord = world.WorldToChunk(positions[i]);
+        coords[i] = coord;
+
+        std::size_t slot = ChunkCoordHash()(coord) & (tableSize - 1);
+        while (table[slot] >= 0 && !(groups[table[slot]].coord == coord)) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] < 0) {
+            table[slot] = static_cast<int>(groups.size());
+            groups.push_back({ coord, 0, 0 });
+        }
+
+        groupOf[i] = table[slot];
+        groups[table[slot]].count++;
+    }
+
+    // Counting sort of the queries by group, keeping the input order within each chunk
+    int offset = 0;
+    for (Group &group : groups) {
+        group.start = offset;
+        offset += group.count;
+        group.count = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Group &group = groups[groupOf[i]];
+        order[group.start + group.count++] = i;
+    }
+
+    int sampled = 0;
+    for (const Group &group : groups) {
+        const Chunk *chunk = FindChunk(group.coord);
+        if (chunk == nullptr) {
+            for (int i = group.start; i < group.start + group.count; i++) {
+                out[order[i]] = std::numeric_limits<float>::quiet_NaN();
+            }
+            continue;
+        }
+
+        for (int i = group.start; i < group.start + group.count; i++) {
+            int index = order[i];
+            out[index] = SampleChunk(*chunk, group.coord, positions[index]);
+        }
+        sampled += group.count;
+    }
+
+    return sampled;
+}
@@ -0,0 +1,45 @@
+#ifndef DENSITYSAMPLER_H
+#define DENSITYSAMPLER_H
+
+#include <optional>
+
+#include <raylib.h>
+
+#include "VoxelWorld.h"
+
+// Point queries against the stored density samples of a VoxelWorld, for normals, collision,
+// raycasts and gameplay code that needs density(x, y, z) at arbitrary positions.
+//
+// Each thread keeps a small LRU of the chunks it touched last, so runs of nearby queries
+// skip the chunk map lookup. The LRU is dropped whenever it sees another world version, which also
+// tells worlds apart, so it never holds on to a chunk that has been replaced, unloaded or destroyed.
+// A sampler is only a view of the world and is cheap to create. It may be shared between threads
+// as long as no chunks are generated or unloaded while it is in use.
+class DensitySampler {
+public:
+    // Number of chunks remembered per thread
+    static constexpr int CACHE_SIZE = 8;
+
+    explicit DensitySampler(const VoxelWorld &world);
+
+    // Trilinearly interpolated density at a world space position.
+    // Returns std::nullopt if the containing chunk has not been generated.
+    std::optional<float> Sample(Vector3 position) const;
+
+    // Density gradient using central differences one voxel apart, like VoxelWorld::SampleGradient
+    std::optional<Vector3> SampleGradient(Vector3 position) const;
+
+    // Sample count positions into out. The positions are processed grouped by chunk,
+    // so every chunk is looked up once per batch whatever the order of the input.
+    // Positions in chunks that have not been generated get NaN.
+    // Returns the number of positions that were sampled.
+    int SampleBatch(const Vector3 *positions, int count, float *out) const;
+
+private:
+    const Chunk *FindChunk(ChunkCoord coord) const;
+    float SampleChunk(const Chunk &chunk, ChunkCoord coord, Vector3 position) const;
+
+    const VoxelWorld &world;
+};
+
+#endif // DENSITYSAMPLER_H
@@ -0,0 +1,85 @@
+#include "ExtractionStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+void ExtractionStats::Merge(const ExtractionStats &other) {
+    cellsVisited += other.cellsVisited;
+    cellsSkipped += other.cellsSkipped;
+    for (int i = 0; i < 256; i++) {
+        caseHistogram[i] += other.caseHistogram[i];
+    }
+    trianglesEmitted += other.trianglesEmitted;
+    degenerateTrianglesRemoved += other.degenerateTrianglesRemoved;
+    verticesEmitted += other.verticesEmitted;
+    verticesDeduplicated += other.verticesDeduplicated;
+    bytesAllocated += other.bytesAllocated;
+    classifyMilliseconds += other.classifyMilliseconds;
+    polygoniseMilliseconds += other.polygoniseMilliseconds;
+    trianglesOptimized += other.trianglesOptimized;
+    cacheMissesBefore += other.cacheMissesBefore;
+    cacheMissesAfter += other.cacheMissesAfter;
+    optimizeMilliseconds += other.optimizeMilliseconds;
+}
+
+void ExtractionStats::AddPolygonised(double milliseconds, std::uint64_t triangles, std::uint64_t vertices,
+                                     std::uint64_t deduplicated, std::uint64_t degenerate) {
+    polygoniseMilliseconds += milliseconds;
+    trianglesEmitted += triangles;
+    verticesEmitted += vertices;
+    verticesDeduplicated += deduplicated;
+    degenerateTrianglesRemoved += degenerate;
+}
+
+std::uint64_t ExtractionStats::ActiveCells() const {
+    // Case 0 and 255 are the cells entirely outside or inside of the surface
+    return cellsVisited - caseHistogram[0] - caseHistogram[255];
+}
+
+std::string ExtractionStats::ToString() const {
+    std::uint64_t totalCells = cellsVisited + cellsSkipped;
+    double skippedPercent = totalCells > 0 ? 100.0 * cellsSkipped / totalCells : 0.0;
+    double activePercent = cellsVisited > 0 ? 100.0 * ActiveCells() / cellsVisited : 0.0;
+
+    char buffer[1024];
+    std::snprintf(buffer, sizeof(buffer),
+        "Cells: %llu visited, %llu skipped by hierarchy (%.1f%%), %llu active (%.1f%% of visited)\n"
+        "Triangles: %llu emitted, %llu degenerate removed\n"
+        "Vertices: %llu emitted, %llu deduplicated\n"
+        "Memory: %.2f MiB allocated\n"
+        "Time: %.3f ms classify, %.3f ms polygonise\n",
+        (unsigned long long)cellsVisited, (unsigned long long)cellsSkipped, skippedPercent,
+        (unsigned long long)ActiveCells(), activePercent,
+        (unsigned long long)trianglesEmitted, (unsigned long long)degenerateTrianglesRemoved,
+        (unsigned long long)verticesEmitted, (unsigned long long)verticesDeduplicated,
+        bytesAllocated / (1024.0 * 1024.0),
+        classifyMilliseconds, polygoniseMilliseconds);
+
+    std::string report = buffer;
+
+    if (trianglesOptimized > 0) {
+        std::snprintf(buffer, sizeof(buffer), "Vertex cache: ACMR %.3f before, %.3f after optimizing %llu triangles in %.3f ms\n",
+                      static_cast<double>(cacheMissesBefore) / trianglesOptimized, static_cast<double>(cacheMissesAfter) / trianglesOptimized,
+                      (unsigned long long)trianglesOptimized, optimizeMilliseconds);
+        report += buffer;
+    }
+
+    // List the most common surface cases
+    std::vector<int> cases;
+    for (int i = 1; i < 255; i++) {
+        if (caseHistogram[i] > 0) {
+            cases.push_back(i);
+        }
+    }
+    std::sort(cases.begin(), cases.end(), [&](int a, int b) { return caseHistogram[a] > caseHistogram[b]; });
+
+    report += "Top cases:";
+    for (int i = 0; i < static_cast<int>(cases.size()) && i < 8; i++) {
+        std::snprintf(buffer, sizeof(buffer), " %d (%llu)", cases[i], (unsigned long long)caseHistogram[cases[i]]);
+        report += buffer;
+    }
+    report += "\n";
+
+    return report;
+}
@@ -0,0 +1,57 @@
+#ifndef EXTRACTIONSTATS_H
+#define EXTRACTIONSTATS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Counters collected while extracting an isosurface from a chunk.
+// Pass a pointer to one of these to the extraction functions to have it filled in,
+// and Merge the results of several chunks to get totals for a whole run.
+struct ExtractionStats {
+    // Cells whose corners were classified against the isoLevel
+    std::uint64_t cellsVisited = 0;
+
+    // Cells never looked at because their chunk or brick cannot contain the surface
+    std::uint64_t cellsSkipped = 0;
+
+    // Number of visited cells per marching cubes case
+    std::array<std::uint64_t, 256> caseHistogram {};
+
+    std::uint64_t trianglesEmitted = 0;
+
+    // Triangles dropped because two of their corners coincide
+    std::uint64_t degenerateTrianglesRemoved = 0;
+
+    std::uint64_t verticesEmitted = 0;
+
+    // Vertex references served by a vertex already emitted for a shared edge.
+    // Only indexed extraction shares vertices, triangle soup always reports 0.
+    std::uint64_t verticesDeduplicated = 0;
+
+    // Capacity of the output and scratch buffers used by the extraction
+    std::uint64_t bytesAllocated = 0;
+
+    double classifyMilliseconds = 0.0;
+    double polygoniseMilliseconds = 0.0;
+
+    // Filled in by OptimizeMesh: post-transform cache misses of the optimized triangles before and after reordering
+    std::uint64_t trianglesOptimized = 0;
+    std::uint64_t cacheMissesBefore = 0;
+    std::uint64_t cacheMissesAfter = 0;
+    double optimizeMilliseconds = 0.0;
+
+    void Merge(const ExtractionStats &other);
+
+    // Add the outcome of polygonising a mesh, or one layer of one
+    void AddPolygonised(double milliseconds, std::uint64_t triangles, std::uint64_t vertices,
+                        std::uint64_t deduplicated, std::uint64_t degenerate);
+
+    // Cells that produced at least one triangle
+    std::uint64_t ActiveCells() const;
+
+    // Multi-line human readable report
+    std::string ToString() const;
+};
+
+#endif // EXTRACTIONSTATS_H
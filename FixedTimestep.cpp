@@ -0,0 +1,28 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(double stepsPerSecond, int maxStepsPerFrame)
+    : stepSeconds(1.0 / stepsPerSecond), maxStepsPerFrame(std::max(maxStepsPerFrame, 1)) {
+}
+
+int FixedTimestep::Advance(double elapsedSeconds) {
+    accumulator += std::max(elapsedSeconds, 0.0);
+
+    int steps = static_cast<int>(accumulator / stepSeconds);
+    if (steps > maxStepsPerFrame) {
+        // Keep the fraction of a step so rendering stays where it was between steps
+        double dropped = (steps - maxStepsPerFrame) * stepSeconds;
+        droppedSeconds += dropped;
+        accumulator -= dropped;
+        steps = maxStepsPerFrame;
+    }
+
+    accumulator -= steps * stepSeconds;
+    stepCount += steps;
+    return steps;
+}
+
+float FixedTimestep::GetAlpha() const {
+    return std::clamp(static_cast<float>(accumulator / stepSeconds), 0.0f, 1.0f);
+}
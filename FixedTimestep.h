@@ -0,0 +1,38 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+#include <cstdint>
+
+// Clock for a simulation that advances in fixed steps, independent of the frame rate.
+//
+// Real time goes into an accumulator, and every whole step in it is run. What is left over is how far
+// the present is between the last two steps, which rendering interpolates by. A simulation that only
+// ever sees the fixed step does the same thing at any frame rate, and repeats exactly given the same inputs.
+//
+// After a long stall, at most maxStepsPerFrame steps are run and the rest of the backlog is dropped, so
+// a heavy frame slows the simulation down for a moment instead of making every frame after it heavier.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double stepsPerSecond, int maxStepsPerFrame = 8);
+
+    // Add the real time since the last call, and return how many steps to run now
+    int Advance(double elapsedSeconds);
+
+    // How far the present is from the last step towards the next one, from 0 to 1
+    float GetAlpha() const;
+
+    double GetStepSeconds() const { return stepSeconds; }
+
+    // Steps run in total, and the time dropped after stalls
+    std::uint64_t GetStepCount() const { return stepCount; }
+    double GetDroppedSeconds() const { return droppedSeconds; }
+
+private:
+    double stepSeconds;
+    int maxStepsPerFrame;
+    double accumulator = 0.0;
+    std::uint64_t stepCount = 0;
+    double droppedSeconds = 0.0;
+};
+
+#endif // FIXEDTIMESTEP_H
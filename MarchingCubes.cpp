@@ -4,6 +4,17 @@
 
 #include "MarchingCubes.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "MarchingCubesCell.h"
+#include "Profiler.h"
+
+using MarchingCubesTables::cornerOffsets;
+using MarchingCubesTables::edgeTable;
+using MarchingCubesTables::triTable;
+
 std::vector<Triangle> MarchingCubes::Polygonise(const GridCell &gridCell, double isoLevel) const {
     // Determine the index into the edge table which
     // tells us which vertices are inside of the surface
@@ -46,6 +57,12 @@ std::vector<Triangle> MarchingCubes::Polygonise(const GridCell &gridCell, double
         return {};
     }
 
+    std::vector<Triangle> triangles {};
+    AppendTriangles(gridCell, cubeIndex, isoLevel, triangles);
+    return triangles;
+}
+
+void MarchingCubes::AppendTriangles(const GridCell &gridCell, int cubeIndex, double isoLevel, std::vector<Triangle> &triangles) const {
     // Looking up the cube index in the edge table will give you a 12 bit index.
     // Each bit that is a 1 represents an edge that the isosurface intersects.
     // 0 if the edge isn't cut by the isosurface.
@@ -103,7 +120,6 @@ std::vector<Triangle> MarchingCubes::Polygonise(const GridCell &gridCell, double
     }
 
     // Create the triangle
-    std::vector<Triangle> triangles {};
     for (int i = 0; triTable[cubeIndex][i] != -1; i += 3) {
         Triangle triangle {};
         triangle.X = edgeVertices[triTable[cubeIndex][i    ]];
@@ -111,10 +127,464 @@ std::vector<Triangle> MarchingCubes::Polygonise(const GridCell &gridCell, double
         triangle.Z = edgeVertices[triTable[cubeIndex][i + 2]];
         triangles.push_back(triangle);
     }
+}
+
+void MarchingCubes::ClassifyChunk(const Chunk &chunk, const double *isoLevels, int levelCount, ScratchArena &arena,
+                                  ArenaVector<ActiveCell> *activeCells, ExtractionStats *stats) const {
+    PROFILE_SCOPE(ProfileZone::Classify);
+
+    // Levels whose surface may pass through the chunk at all
+    int *levels = arena.AllocateArray<int>(levelCount);
+    int count = 0;
+    for (int level = 0; level < levelCount; level++) {
+        if (chunk.Straddles(static_cast<float>(isoLevels[level]))) {
+            levels[count++] = level;
+        } else if (stats != nullptr) {
+            stats->cellsSkipped += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+        }
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    // Inside bits of the sample rows: bit x of row (y, z) is set when sample (x, y, z) lies below the isoLevel.
+    // Every sample is read once, the first time a cell next to it is visited, and compared against all levels.
+    // Each cell's cube index is then assembled from the bits of the four rows around it.
+    // The bits of all levels of a row are stored together, at row * count + level.
+    static_assert(CHUNK_SAMPLES <= 64, "A row of inside bits must fit in 64 bits");
+    std::uint64_t *rowBits = arena.AllocateArray<std::uint64_t>(CHUNK_SAMPLES * CHUNK_SAMPLES * count);
+    std::array<std::uint64_t, (CHUNK_SAMPLES * CHUNK_SAMPLES + 63) / 64> rowReady {};
+
+    auto insideRows = [&](int y, int z) {
+        int row = y + z * CHUNK_SAMPLES;
+        std::uint64_t *bits = rowBits + row * count;
+        if ((rowReady[row / 64] >> (row % 64) & 1) == 0) {
+            const float *samples = chunk.densities.data() + row * CHUNK_SAMPLES;
+            for (int k = 0; k < count; k++) {
+                double isoLevel = isoLevels[levels[k]];
+                std::uint64_t levelBits = 0;
+                for (int x = 0; x < CHUNK_SAMPLES; x++) {
+                    levelBits |= static_cast<std::uint64_t>(samples[x] < isoLevel) << x;
+                }
+                bits[k] = levelBits;
+            }
+            rowReady[row / 64] |= std::uint64_t(1) << (row % 64);
+        }
+        return bits;
+    };
+
+    // Bits of the BRICK_SIZE + 1 samples a run of cells touches
+    constexpr std::uint64_t runMask = (std::uint64_t(1) << (BRICK_SIZE + 1)) - 1;
+
+    // Cells are walked in plain scan order, a brick wide run at a time, so the active cells come out
+    // already in canonical order. Runs in bricks that cannot contain a level's surface are skipped for that level.
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            for (int bx = 0; bx < BRICKS_PER_CHUNK; bx++) {
+                int brick = Chunk::BrickIndex(bx, y / BRICK_SIZE, z / BRICK_SIZE);
+                int shift = bx * BRICK_SIZE;
+
+                // Rows below and above the run, on the near (z) and far (z + 1) side. Fetched for the first level that needs them.
+                const std::uint64_t *nearLowRows = nullptr;
+                const std::uint64_t *farLowRows = nullptr;
+                const std::uint64_t *nearHighRows = nullptr;
+                const std::uint64_t *farHighRows = nullptr;
+
+                for (int k = 0; k < count; k++) {
+                    int level = levels[k];
+                    if (!chunk.BrickStraddles(brick, static_cast<float>(isoLevels[level]))) {
+                        if (stats != nullptr) {
+                            stats->cellsSkipped += BRICK_SIZE;
+                        }
+                        continue;
+                    }
+
+                    if (nearLowRows == nullptr) {
+                        nearLowRows = insideRows(y, z);
+                        farLowRows = insideRows(y, z + 1);
+                        nearHighRows = insideRows(y + 1, z);
+                        farHighRows = insideRows(y + 1, z + 1);
+                    }
+
+                    std::uint64_t nearLow = nearLowRows[k] >> shift & runMask;
+                    std::uint64_t farLow = farLowRows[k] >> shift & runMask;
+                    std::uint64_t nearHigh = nearHighRows[k] >> shift & runMask;
+                    std::uint64_t farHigh = farHighRows[k] >> shift & runMask;
+
+                    if (stats != nullptr) {
+                        stats->cellsVisited += BRICK_SIZE;
+                    }
+
+                    // The whole run lies on one side of the surface
+                    if ((nearLow | farLow | nearHigh | farHigh) == 0 || (nearLow & farLow & nearHigh & farHigh) == runMask) {
+                        if (stats != nullptr) {
+                            stats->caseHistogram[nearLow == 0 ? 0 : 255] += BRICK_SIZE;
+                        }
+                        continue;
+                    }
+
+                    for (int i = 0; i < BRICK_SIZE; i++) {
+                        // Corner bits in cornerOffsets order
+                        int cubeIndex = static_cast<int>(
+                            (nearLow >> i & 1) | (nearLow >> (i + 1) & 1) << 1 |
+                            (farLow >> (i + 1) & 1) << 2 | (farLow >> i & 1) << 3 |
+                            (nearHigh >> i & 1) << 4 | (nearHigh >> (i + 1) & 1) << 5 |
+                            (farHigh >> (i + 1) & 1) << 6 | (farHigh >> i & 1) << 7);
+
+                        if (stats != nullptr) {
+                            stats->caseHistogram[cubeIndex]++;
+                        }
+
+                        // Cells entirely inside or outside of the surface produce no triangles
+                        if (edgeTable[cubeIndex] != 0) {
+                            activeCells[level].push_back({ shift + i, y, z, cubeIndex });
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::vector<Triangle> MarchingCubes::PolygoniseChunk(const Chunk &chunk, Vector3 origin, float voxelSize, double isoLevel,
+                                                     ExtractionStats *stats) const {
+    auto classifyStart = std::chrono::steady_clock::now();
+
+    // Scratch buffers live in the thread's arena and are released together when the scope ends
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scratch(arena);
+
+    ArenaVector<ActiveCell> activeCells { ArenaAllocator<ActiveCell>(arena) };
+    ClassifyChunk(chunk, &isoLevel, 1, arena, &activeCells, stats);
+
+    auto polygoniseStart = std::chrono::steady_clock::now();
+
+    // Generate the triangles of the active cells
+    std::vector<Triangle> triangles {};
+    {
+        PROFILE_SCOPE(ProfileZone::Polygonise);
+
+        for (const ActiveCell &cell : activeCells) {
+            GridCell gridCell;
+            for (int i = 0; i < 8; i++) {
+                int sx = cell.x + cornerOffsets[i][0];
+                int sy = cell.y + cornerOffsets[i][1];
+                int sz = cell.z + cornerOffsets[i][2];
+                gridCell.vertices[i] = { origin.x + sx * voxelSize, origin.y + sy * voxelSize, origin.z + sz * voxelSize };
+                gridCell.densities[i] = chunk.At(sx, sy, sz);
+            }
+
+            AppendTriangles(gridCell, cell.cubeIndex, isoLevel, triangles);
+        }
+    }
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->classifyMilliseconds += std::chrono::duration<double, std::milli>(polygoniseStart - classifyStart).count();
+        stats->polygoniseMilliseconds += std::chrono::duration<double, std::milli>(end - polygoniseStart).count();
+        stats->trianglesEmitted += triangles.size();
+        stats->verticesEmitted += triangles.size() * 3;
+        stats->bytesAllocated += activeCells.capacity() * sizeof(ActiveCell) + triangles.capacity() * sizeof(Triangle);
+    }
 
     return triangles;
 }
 
+void MarchingCubes::ExtractToScratch(const Chunk &chunk, Vector3 origin, float voxelSize, double isoLevel,
+                                     ScratchArena &arena, ScratchMesh &scratch, ExtractionStats *stats) const {
+    auto classifyStart = std::chrono::steady_clock::now();
+
+    ArenaVector<ActiveCell> activeCells { ArenaAllocator<ActiveCell>(arena) };
+    ClassifyChunk(chunk, &isoLevel, 1, arena, &activeCells, stats);
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->classifyMilliseconds += std::chrono::duration<double, std::milli>(end - classifyStart).count();
+    }
+
+    PolygoniseToScratch(chunk, origin, voxelSize, isoLevel, activeCells, arena, scratch, stats);
+}
+
+void MarchingCubes::PolygoniseToScratch(const Chunk &chunk, Vector3 origin, float voxelSize, double isoLevel,
+                                        const ArenaVector<ActiveCell> &activeCells, ScratchArena &arena,
+                                        ScratchMesh &scratch, ExtractionStats *stats) const {
+    auto polygoniseStart = std::chrono::steady_clock::now();
+
+    std::uint64_t deduplicated = 0;
+    std::uint64_t degenerate = 0;
+
+    ArenaVector<Vector3> &vertices = scratch.vertices;
+    ArenaVector<Vector3> &normals = scratch.normals;
+    ArenaVector<std::uint32_t> &indices = scratch.indices;
+
+    // Index of the vertex created on each sample edge, or -1.
+    // Edge key = sample index * 3 + axis, where the edge runs from the sample in the positive axis direction.
+    // Cells arrive in scan order, so only the edges of the two sample planes around the current layer of
+    // cells are kept: the x and y edges of plane z and z + 1, alternating between two slots as z advances,
+    // and the z edges running between them.
+    // Vertices are numbered in the order they are created, so rather than clearing a slot when its plane
+    // changes, entries below the first vertex created since then are treated as empty.
+    constexpr int PLANE_EDGES = CHUNK_SAMPLES * CHUNK_SAMPLES;
+    ArenaVector<std::int32_t> edgeVertices { ArenaAllocator<std::int32_t>(arena) };
+    std::int32_t planeFirstVertex[2] = { 0, 0 };
+    std::int32_t layerFirstVertex = 0;
+    int currentZ = -2;
+
+    // Edge key of every emitted vertex, used to sort the vertices into canonical order
+    ArenaVector<std::int32_t> vertexKeys { ArenaAllocator<std::int32_t>(arena) };
+
+    if (!activeCells.empty()) {
+        PROFILE_SCOPE(ProfileZone::Polygonise);
+
+        // Slots: x and y edges of the even and odd planes, then the z edges
+        edgeVertices.assign(PLANE_EDGES * 5, -1);
+
+        // Terrain averages about one new vertex and six indices per active cell.
+        // Reserving room for more avoids growing the buffers, which in an arena leaves the old ones behind.
+        vertices.reserve(activeCells.size() * 2);
+        normals.reserve(activeCells.size() * 2);
+        vertexKeys.reserve(activeCells.size() * 2);
+        indices.reserve(activeCells.size() * 9);
+
+        // Find or create the vertex where the surface crosses an edge of the cell
+        auto edgeVertex = [&](const ActiveCell &cell, int edge) {
+            const CellEdge &cellEdge = cellEdges[edge];
+            const int *start = cornerOffsets[cellEdge.start];
+            const int *end = cornerOffsets[cellEdge.end];
+            int sx = cell.x + start[0], sy = cell.y + start[1], sz = cell.z + start[2];
+            int ex = cell.x + end[0], ey = cell.y + end[1], ez = cell.z + end[2];
+            int axis = cellEdge.axis;
+            int key = Chunk::Index(sx, sy, sz) * 3 + axis;
+
+            int planeIndex = sx + sy * CHUNK_SAMPLES;
+            int slot = axis == 2 ? PLANE_EDGES * 4 + planeIndex : PLANE_EDGES * 2 * (sz & 1) + planeIndex * 2 + axis;
+            if (edgeVertices[slot] >= (axis == 2 ? layerFirstVertex : planeFirstVertex[sz & 1])) {
+                deduplicated++;
+                return static_cast<std::uint32_t>(edgeVertices[slot]);
+            }
+
+            Vector3 p1 = { origin.x + sx * voxelSize, origin.y + sy * voxelSize, origin.z + sz * voxelSize };
+            Vector3 p2 = { origin.x + ex * voxelSize, origin.y + ey * voxelSize, origin.z + ez * voxelSize };
+            SurfaceVertex vertex = InterpolateEdgeVertex(isoLevel, p1, p2, chunk.At(sx, sy, sz), chunk.At(ex, ey, ez),
+                                                         ChunkSampleGradient(chunk, sx, sy, sz),
+                                                         ChunkSampleGradient(chunk, ex, ey, ez), axis, voxelSize);
+
+            std::uint32_t index = static_cast<std::uint32_t>(vertices.size());
+            vertices.push_back(vertex.position);
+            normals.push_back(vertex.normal);
+            vertexKeys.push_back(key);
+            edgeVertices[slot] = static_cast<std::int32_t>(index);
+            return index;
+        };
+
+        auto position = [&](std::uint32_t vertex) { return vertices[vertex]; };
+        auto emit = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        };
+
+        for (const ActiveCell &cell : activeCells) {
+            if (cell.z != currentZ) {
+                // Moving up one layer keeps the edges of the shared plane, anything else starts over
+                std::int32_t vertexCount = static_cast<std::int32_t>(vertices.size());
+                if (cell.z != currentZ + 1) {
+                    planeFirstVertex[cell.z & 1] = vertexCount;
+                }
+                planeFirstVertex[(cell.z + 1) & 1] = vertexCount;
+                layerFirstVertex = vertexCount;
+                currentZ = cell.z;
+            }
+
+            auto vertexOf = [&](int edge) { return edgeVertex(cell, edge); };
+            degenerate += PolygoniseCell(cell.cubeIndex, vertexOf, position, emit);
+        }
+
+        // Sort the vertices by edge key. The output is gathered through order and remap
+        // by whichever writer comes next, so the sorted vertices are never copied in between.
+        ArenaVector<std::uint32_t> &order = scratch.order;
+        order.resize(vertices.size());
+        for (std::uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) { return vertexKeys[a] < vertexKeys[b]; });
+
+        scratch.remap.resize(order.size());
+        for (std::uint32_t i = 0; i < order.size(); i++) {
+            scratch.remap[order[i]] = i;
+        }
+    }
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->AddPolygonised(std::chrono::duration<double, std::milli>(end - polygoniseStart).count(), indices.size() / 3,
+                              vertices.size(), deduplicated, degenerate);
+        stats->bytesAllocated += activeCells.capacity() * sizeof(ActiveCell) +
+                                 edgeVertices.capacity() * sizeof(std::int32_t) +
+                                 vertexKeys.capacity() * sizeof(std::int32_t) +
+                                 (vertices.capacity() + normals.capacity()) * sizeof(Vector3) +
+                                 indices.capacity() * sizeof(std::uint32_t) +
+                                 (scratch.order.capacity() + scratch.remap.capacity()) * sizeof(std::uint32_t);
+    }
+}
+
+IndexedMesh MarchingCubes::ExtractChunk(const Chunk &chunk, Vector3 origin, float voxelSize, double isoLevel,
+                                        ExtractionStats *stats) const {
+    // Scratch buffers live in the thread's arena and are released together when the scope ends.
+    // Only the final, exactly sized output buffers come from the mesh buffer pool.
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    ScratchMesh scratch(arena);
+    ExtractToScratch(chunk, origin, voxelSize, isoLevel, arena, scratch, stats);
+    return GatherMesh(scratch, stats);
+}
+
+std::vector<IndexedMesh> MarchingCubes::ExtractChunkLevels(const Chunk &chunk, Vector3 origin, float voxelSize,
+                                                           const std::vector<double> &isoLevels, ExtractionStats *stats) const {
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    auto classifyStart = std::chrono::steady_clock::now();
+
+    // Classify every level in a single walk over the samples
+    const int levelCount = static_cast<int>(isoLevels.size());
+    ArenaVector<ArenaVector<ActiveCell>> activeCells { ArenaAllocator<ArenaVector<ActiveCell>>(arena) };
+    activeCells.reserve(levelCount);
+    for (int level = 0; level < levelCount; level++) {
+        activeCells.emplace_back(ArenaAllocator<ActiveCell>(arena));
+    }
+    ClassifyChunk(chunk, isoLevels.data(), levelCount, arena, activeCells.data(), stats);
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->classifyMilliseconds += std::chrono::duration<double, std::milli>(end - classifyStart).count();
+    }
+
+    // Then polygonise them one after another, reusing the same scratch memory for each
+    std::vector<IndexedMesh> meshes(levelCount);
+    for (int level = 0; level < levelCount; level++) {
+        ArenaScope levelScope(arena);
+        ScratchMesh scratch(arena);
+        PolygoniseToScratch(chunk, origin, voxelSize, isoLevels[level], activeCells[level], arena, scratch, stats);
+        meshes[level] = GatherMesh(scratch, stats);
+    }
+
+    return meshes;
+}
+
+IndexedMesh MarchingCubes::GatherMesh(const ScratchMesh &scratch, ExtractionStats *stats) {
+    IndexedMesh mesh;
+    mesh.vertices.resize(scratch.order.size());
+    mesh.normals.resize(scratch.order.size());
+    for (std::size_t i = 0; i < scratch.order.size(); i++) {
+        mesh.vertices[i] = scratch.vertices[scratch.order[i]];
+        mesh.normals[i] = scratch.normals[scratch.order[i]];
+    }
+
+    mesh.indices.resize(scratch.indices.size());
+    for (std::size_t i = 0; i < scratch.indices.size(); i++) {
+        mesh.indices[i] = scratch.remap[scratch.indices[i]];
+    }
+
+    if (stats != nullptr) {
+        stats->bytesAllocated += (mesh.vertices.capacity() + mesh.normals.capacity()) * sizeof(Vector3) +
+                                 mesh.indices.capacity() * sizeof(std::uint32_t);
+    }
+
+    return mesh;
+}
+
+Mesh MarchingCubes::ExtractChunkMesh(const Chunk &chunk, Vector3 origin, float voxelSize, double isoLevel,
+                                     ExtractionStats *stats) const {
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    ScratchMesh scratch(arena);
+    ExtractToScratch(chunk, origin, voxelSize, isoLevel, arena, scratch, stats);
+
+    Mesh mesh = {};
+    if (scratch.indices.empty()) {
+        return mesh;
+    }
+
+    PROFILE_SCOPE(ProfileZone::MeshAssembly);
+
+    MeshBufferPool &pool = MeshBufferPool::Get();
+    const std::size_t vertexCount = scratch.order.size();
+    const std::size_t indexCount = scratch.indices.size();
+
+    if (vertexCount <= MAX_MESH_INDEXED_VERTICES) {
+        mesh.vertexCount = static_cast<int>(vertexCount);
+        mesh.triangleCount = static_cast<int>(indexCount / 3);
+        mesh.vertices = static_cast<float *>(pool.Acquire(vertexCount * 3 * sizeof(float)));
+        mesh.normals = static_cast<float *>(pool.Acquire(vertexCount * 3 * sizeof(float)));
+        mesh.indices = static_cast<unsigned short *>(pool.Acquire(indexCount * sizeof(unsigned short)));
+
+        // Gather the vertices into canonical order straight into the mesh arrays
+        for (std::size_t i = 0; i < vertexCount; i++) {
+            const Vector3 &position = scratch.vertices[scratch.order[i]];
+            const Vector3 &normal = scratch.normals[scratch.order[i]];
+            mesh.vertices[i * 3 + 0] = position.x;
+            mesh.vertices[i * 3 + 1] = position.y;
+            mesh.vertices[i * 3 + 2] = position.z;
+            mesh.normals[i * 3 + 0] = normal.x;
+            mesh.normals[i * 3 + 1] = normal.y;
+            mesh.normals[i * 3 + 2] = normal.z;
+        }
+
+        for (std::size_t i = 0; i < indexCount; i++) {
+            mesh.indices[i] = static_cast<unsigned short>(scratch.remap[scratch.indices[i]]);
+        }
+    } else {
+        // Too many vertices for Raylib's 16 bit indices, write every triangle corner out instead
+        mesh.vertexCount = static_cast<int>(indexCount);
+        mesh.triangleCount = static_cast<int>(indexCount / 3);
+        mesh.vertices = static_cast<float *>(pool.Acquire(indexCount * 3 * sizeof(float)));
+        mesh.normals = static_cast<float *>(pool.Acquire(indexCount * 3 * sizeof(float)));
+
+        for (std::size_t i = 0; i < indexCount; i++) {
+            const Vector3 &position = scratch.vertices[scratch.indices[i]];
+            const Vector3 &normal = scratch.normals[scratch.indices[i]];
+            mesh.vertices[i * 3 + 0] = position.x;
+            mesh.vertices[i * 3 + 1] = position.y;
+            mesh.vertices[i * 3 + 2] = position.z;
+            mesh.normals[i * 3 + 0] = normal.x;
+            mesh.normals[i * 3 + 1] = normal.y;
+            mesh.normals[i * 3 + 2] = normal.z;
+        }
+    }
+
+    if (stats != nullptr) {
+        stats->bytesAllocated += MeshBufferBytes(mesh);
+    }
+
+    return mesh;
+}
+
+std::size_t MarchingCubes::MeshBufferBytes(const Mesh &mesh) {
+    std::size_t bytes = 2 * static_cast<std::size_t>(mesh.vertexCount) * 3 * sizeof(float);
+    if (mesh.indices != nullptr) {
+        bytes += static_cast<std::size_t>(mesh.triangleCount) * 3 * sizeof(unsigned short);
+    }
+    return bytes;
+}
+
+void MarchingCubes::ReleaseMeshBuffers(Mesh &mesh) {
+    MeshBufferPool &pool = MeshBufferPool::Get();
+    std::size_t vertexBytes = static_cast<std::size_t>(mesh.vertexCount) * 3 * sizeof(float);
+    pool.Release(mesh.vertices, vertexBytes);
+    pool.Release(mesh.normals, vertexBytes);
+    if (mesh.indices != nullptr) {
+        pool.Release(mesh.indices, static_cast<std::size_t>(mesh.triangleCount) * 3 * sizeof(unsigned short));
+    }
+
+    mesh.vertices = nullptr;
+    mesh.normals = nullptr;
+    mesh.indices = nullptr;
+}
+
 Vector3 MarchingCubes::VertexInterpolate(double isoLevel, Vector3 p1, Vector3 p2, double valp1, double valp2) {
     if (std::abs(isoLevel - valp1) < 0.00001) {
         return p1;
@@ -0,0 +1,140 @@
+#ifndef MARCHINGCUBESCELL_H
+#define MARCHINGCUBESCELL_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+#include "MarchingCubes.h"
+#include "MarchingCubesTables.h"
+
+// The steps of polygonising a cell that every indexed extractor shares, whatever its samples are stored in
+// and however it finds the vertices of shared edges. Keeping them in one place keeps the extractors' meshes
+// identical to each other.
+
+// An edge of a cell: the corners at its lower and upper end, and the axis it runs along.
+// Edges are always walked from their lower end, so every cell sharing an edge finds the same vertex on it.
+struct CellEdge {
+    int start;
+    int end;
+    int axis;
+};
+
+inline constexpr std::array<CellEdge, 12> cellEdges = [] {
+    std::array<CellEdge, 12> edges {};
+    for (int edge = 0; edge < 12; edge++) {
+        int a = MarchingCubesTables::edgeCorners[edge][0];
+        int b = MarchingCubesTables::edgeCorners[edge][1];
+        const int *pa = MarchingCubesTables::cornerOffsets[a];
+        const int *pb = MarchingCubesTables::cornerOffsets[b];
+        bool aFirst = pa[0] + pa[1] + pa[2] <= pb[0] + pb[1] + pb[2];
+        edges[edge] = { aFirst ? a : b, aFirst ? b : a, pa[0] != pb[0] ? 0 : (pa[1] != pb[1] ? 1 : 2) };
+    }
+    return edges;
+}();
+
+struct SurfaceVertex {
+    Vector3 position;
+    Vector3 normal;
+};
+
+// The vertex where the surface crosses the sample edge from p1 to p2, spacing long along axis, with densities
+// d1 and d2 and density gradients g1 and g2 at its samples. The normal blends the gradients by how far along
+// the edge the vertex landed.
+inline SurfaceVertex InterpolateEdgeVertex(double isoLevel, Vector3 p1, Vector3 p2, double d1, double d2,
+                                           Vector3 g1, Vector3 g2, int axis, float spacing) {
+    SurfaceVertex vertex;
+    vertex.position = MarchingCubes::VertexInterpolate(isoLevel, p1, p2, d1, d2);
+
+    float along = axis == 0 ? vertex.position.x - p1.x : (axis == 1 ? vertex.position.y - p1.y : vertex.position.z - p1.z);
+    float mu = along / spacing;
+    Vector3 gradient = { g1.x + mu * (g2.x - g1.x), g1.y + mu * (g2.y - g1.y), g1.z + mu * (g2.z - g1.z) };
+
+    float length = std::sqrt(gradient.x * gradient.x + gradient.y * gradient.y + gradient.z * gradient.z);
+    vertex.normal = length > 0.0f ? Vector3 { gradient.x / length, gradient.y / length, gradient.z / length } : Vector3 { 0.0f, 1.0f, 0.0f };
+    return vertex;
+}
+
+// Density gradient at a sample of a chunk, central differences inside and one-sided on the chunk faces
+inline Vector3 ChunkSampleGradient(const Chunk &chunk, int x, int y, int z) {
+    int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, CHUNK_SIZE);
+    int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, CHUNK_SIZE);
+    int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, CHUNK_SIZE);
+    return Vector3 {
+        (chunk.At(x1, y, z) - chunk.At(x0, y, z)) / (x1 - x0),
+        (chunk.At(x, y1, z) - chunk.At(x, y0, z)) / (y1 - y0),
+        (chunk.At(x, y, z1) - chunk.At(x, y, z0)) / (z1 - z0)
+    };
+}
+
+// Emit the triangles of a cell. vertexOf(edge) finds or creates the vertex on one of the cell's edges and
+// returns its index, and positionOf(index) gives a vertex's position. Triangles with two corners at the same
+// position, which collapse when a crossing lands exactly on a sample, are dropped, the rest go to emit(a, b, c).
+// Returns the number of triangles dropped.
+template <typename VertexOf, typename PositionOf, typename Emit>
+int PolygoniseCell(int cubeIndex, VertexOf &&vertexOf, PositionOf &&positionOf, Emit &&emit) {
+    auto samePosition = [&](std::uint32_t a, std::uint32_t b) {
+        Vector3 pa = positionOf(a);
+        Vector3 pb = positionOf(b);
+        return pa.x == pb.x && pa.y == pb.y && pa.z == pb.z;
+    };
+
+    int degenerate = 0;
+    const int *triangles = MarchingCubesTables::triTable[cubeIndex];
+    for (int i = 0; triangles[i] != -1; i += 3) {
+        std::uint32_t a = vertexOf(triangles[i]);
+        std::uint32_t b = vertexOf(triangles[i + 1]);
+        std::uint32_t c = vertexOf(triangles[i + 2]);
+
+        if (samePosition(a, b) || samePosition(b, c) || samePosition(a, c)) {
+            degenerate++;
+            continue;
+        }
+
+        emit(a, b, c);
+    }
+    return degenerate;
+}
+
+// Vertex on each edge of one layer of cells, for extractors that walk a grid of width * height samples
+// layer by layer along z: the x and y edges of the layer's lower and upper plane of samples, and the
+// z edges running between them. Edges are found by their lower sample.
+class LayerEdgeVertices {
+public:
+    static constexpr std::uint32_t NONE = ~0u;
+
+    LayerEdgeVertices(int width, int height)
+        : width(width), lower(PlaneSamples(width, height) * 2, NONE), upper(PlaneSamples(width, height) * 2, NONE),
+          between(PlaneSamples(width, height), NONE) {}
+
+    // Move up one layer. The upper plane's edges become the lower plane's, all others are emptied.
+    void NextLayer() {
+        std::swap(lower, upper);
+        std::fill(upper.begin(), upper.end(), NONE);
+        std::fill(between.begin(), between.end(), NONE);
+    }
+
+    // Slot of the edge along axis from sample (x, y) of the lower or upper plane, NONE until a vertex is stored
+    std::uint32_t &At(int x, int y, bool upperPlane, int axis) {
+        std::size_t sample = static_cast<std::size_t>(y) * width + x;
+        return axis == 2 ? between[sample] : (upperPlane ? upper : lower)[sample * 2 + axis];
+    }
+
+    std::size_t GetBytes() const { return (lower.capacity() + upper.capacity() + between.capacity()) * sizeof(std::uint32_t); }
+
+private:
+    static std::size_t PlaneSamples(int width, int height) { return static_cast<std::size_t>(width) * height; }
+
+    int width;
+    std::vector<std::uint32_t> lower;
+    std::vector<std::uint32_t> upper;
+    std::vector<std::uint32_t> between;
+};
+
+#endif // MARCHINGCUBESCELL_H
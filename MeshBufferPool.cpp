@@ -0,0 +1,103 @@
+#include "MeshBufferPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <new>
+
+static_assert(MeshBufferPool::MIN_CLASS_BYTES << (MeshBufferPool::CLASS_COUNT - 1) == MeshBufferPool::MAX_CLASS_BYTES,
+              "CLASS_COUNT must cover MIN_CLASS_BYTES to MAX_CLASS_BYTES");
+
+MeshBufferPool &MeshBufferPool::Get() {
+    // Never destroyed, so buffers released during static destruction still have somewhere to go
+    static MeshBufferPool *pool = new MeshBufferPool();
+    return *pool;
+}
+
+MeshBufferPool::~MeshBufferPool() {
+    Trim();
+}
+
+std::size_t MeshBufferPool::ClassBytes(std::size_t bytes) {
+    if (bytes > MAX_CLASS_BYTES) {
+        return bytes;
+    }
+    return std::max(MIN_CLASS_BYTES, std::bit_ceil(bytes));
+}
+
+int MeshBufferPool::ClassIndex(std::size_t bytes) {
+    return std::countr_zero(ClassBytes(bytes)) - std::countr_zero(MIN_CLASS_BYTES);
+}
+
+void *MeshBufferPool::Acquire(std::size_t bytes) {
+    std::size_t classBytes = ClassBytes(bytes);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.acquisitions++;
+        stats.liveBytes += classBytes;
+        stats.peakLiveBytes = std::max(stats.peakLiveBytes, stats.liveBytes);
+
+        if (bytes <= MAX_CLASS_BYTES) {
+            std::vector<void *> &freeList = freeLists[ClassIndex(bytes)];
+            if (!freeList.empty()) {
+                void *buffer = freeList.back();
+                freeList.pop_back();
+                stats.pooledBytes -= classBytes;
+                stats.reuses++;
+                return buffer;
+            }
+        }
+    }
+
+    // Allocate outside the lock, the heap has its own
+    void *buffer = std::malloc(classBytes);
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.liveBytes -= classBytes;
+        throw std::bad_alloc();
+    }
+    return buffer;
+}
+
+void MeshBufferPool::Release(void *buffer, std::size_t bytes) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    std::size_t classBytes = ClassBytes(bytes);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.liveBytes -= classBytes;
+
+        if (bytes <= MAX_CLASS_BYTES && stats.pooledBytes + classBytes <= retainLimit) {
+            freeLists[ClassIndex(bytes)].push_back(buffer);
+            stats.pooledBytes += classBytes;
+            return;
+        }
+    }
+
+    std::free(buffer);
+}
+
+void MeshBufferPool::SetRetainLimit(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    retainLimit = bytes;
+}
+
+void MeshBufferPool::Trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::vector<void *> &freeList : freeLists) {
+        for (void *buffer : freeList) {
+            std::free(buffer);
+        }
+        freeList.clear();
+    }
+    stats.pooledBytes = 0;
+}
+
+MeshBufferPool::Stats MeshBufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
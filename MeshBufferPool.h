@@ -0,0 +1,90 @@
+#ifndef MESHBUFFERPOOL_H
+#define MESHBUFFERPOOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Size-classed pool for the long lived vertex and index buffers of chunk meshes.
+// Every request is rounded up to a power of two, and released buffers go on a free list for their
+// class instead of back to the heap. Streaming terrain builds and drops thousands of chunk meshes,
+// and recycling the buffers keeps that churn from fragmenting the heap.
+// Safe to use from any thread.
+class MeshBufferPool {
+public:
+    // Smallest and largest size class. Larger requests bypass the free lists.
+    static constexpr std::size_t MIN_CLASS_BYTES = 256;
+    static constexpr std::size_t MAX_CLASS_BYTES = 64 << 20;
+    static constexpr int CLASS_COUNT = 19;
+
+    struct Stats {
+        // Bytes in buffers currently handed out, by their rounded up size
+        std::uint64_t liveBytes = 0;
+        std::uint64_t peakLiveBytes = 0;
+
+        // Bytes in released buffers waiting to be reused
+        std::uint64_t pooledBytes = 0;
+
+        std::uint64_t acquisitions = 0;
+
+        // Acquisitions served from a free list
+        std::uint64_t reuses = 0;
+    };
+
+    static MeshBufferPool &Get();
+
+    MeshBufferPool() = default;
+    ~MeshBufferPool();
+    MeshBufferPool(const MeshBufferPool &) = delete;
+    MeshBufferPool &operator=(const MeshBufferPool &) = delete;
+
+    // Returns a buffer of at least bytes bytes, aligned for any type
+    void *Acquire(std::size_t bytes);
+
+    // Return a buffer. bytes must be the size it was acquired with.
+    void Release(void *buffer, std::size_t bytes);
+
+    // Released buffers beyond this many bytes go back to the heap instead of the free lists
+    void SetRetainLimit(std::size_t bytes);
+
+    // Free every pooled buffer
+    void Trim();
+
+    Stats GetStats() const;
+
+    // Rounded up size of the class serving a request, or bytes itself if it bypasses the pool
+    static std::size_t ClassBytes(std::size_t bytes);
+
+private:
+    static int ClassIndex(std::size_t bytes);
+
+    mutable std::mutex mutex;
+    std::array<std::vector<void *>, CLASS_COUNT> freeLists;
+    std::size_t retainLimit = 256 << 20;
+    Stats stats;
+};
+
+// Standard allocator on top of MeshBufferPool::Get()
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(std::size_t count) { return static_cast<T *>(MeshBufferPool::Get().Acquire(count * sizeof(T))); }
+    void deallocate(T *pointer, std::size_t count) { MeshBufferPool::Get().Release(pointer, count * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+};
+
+template <typename T>
+using PooledVector = std::vector<T, PoolAllocator<T>>;
+
+#endif // MESHBUFFERPOOL_H
@@ -0,0 +1,212 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Profiler.h"
+#include "ScratchArena.h"
+
+namespace {
+    constexpr std::uint32_t NO_VERTEX = ~0u;
+
+    // Pick the next fanning vertex: the candidate still referenced by unemitted triangles that
+    // entered the cache earliest, as long as its remaining triangles will not push it out.
+    std::uint32_t NextFanningVertex(const std::uint32_t *candidates, std::size_t candidateCount,
+                                    const std::uint32_t *liveTriangles, const std::uint32_t *cacheTime,
+                                    std::uint32_t time, int cacheSize) {
+        std::uint32_t best = NO_VERTEX;
+        std::int64_t bestPriority = -1;
+        for (std::size_t i = 0; i < candidateCount; i++) {
+            std::uint32_t vertex = candidates[i];
+            if (liveTriangles[vertex] == 0) {
+                continue;
+            }
+
+            std::int64_t age = time - cacheTime[vertex];
+            std::int64_t priority = age + 2 * std::int64_t(liveTriangles[vertex]) <= cacheSize ? age : 0;
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = vertex;
+            }
+        }
+        return best;
+    }
+}
+
+std::uint64_t CountCacheMisses(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount, int cacheSize) {
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    // A FIFO cache evicts in insertion order, so a vertex is still cached while fewer than
+    // cacheSize misses have happened since it was inserted
+    std::uint64_t *insertedAt = arena.AllocateArray<std::uint64_t>(vertexCount);
+    std::fill(insertedAt, insertedAt + vertexCount, ~std::uint64_t(0));
+
+    std::uint64_t misses = 0;
+    for (std::size_t i = 0; i < indexCount; i++) {
+        std::uint32_t vertex = indices[i];
+        if (insertedAt[vertex] == ~std::uint64_t(0) || misses - insertedAt[vertex] >= std::uint64_t(cacheSize)) {
+            insertedAt[vertex] = misses;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+float ComputeACMR(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount, int cacheSize) {
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(CountCacheMisses(indices, indexCount, vertexCount, cacheSize)) / triangleCount;
+}
+
+void OptimizeVertexCache(std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount, int cacheSize) {
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) {
+        return;
+    }
+
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    // Triangles around each vertex, as offsets into one shared list
+    std::uint32_t *liveTriangles = arena.AllocateArray<std::uint32_t>(vertexCount);
+    std::uint32_t *adjacencyStart = arena.AllocateArray<std::uint32_t>(vertexCount + 1);
+    std::uint32_t *adjacency = arena.AllocateArray<std::uint32_t>(indexCount);
+
+    std::fill(liveTriangles, liveTriangles + vertexCount, 0u);
+    for (std::size_t i = 0; i < indexCount; i++) {
+        liveTriangles[indices[i]]++;
+    }
+
+    adjacencyStart[0] = 0;
+    for (std::size_t v = 0; v < vertexCount; v++) {
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    }
+
+    std::uint32_t *fill = arena.AllocateArray<std::uint32_t>(vertexCount);
+    std::copy(adjacencyStart, adjacencyStart + vertexCount, fill);
+    for (std::size_t i = 0; i < indexCount; i++) {
+        adjacency[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+
+    // Time a vertex last entered the simulated cache. Starting the clock past the cache size
+    // makes every vertex count as uncached.
+    std::uint32_t *cacheTime = arena.AllocateArray<std::uint32_t>(vertexCount);
+    std::fill(cacheTime, cacheTime + vertexCount, 0u);
+    std::uint32_t time = cacheSize + 1;
+
+    bool *emitted = arena.AllocateArray<bool>(triangleCount);
+    std::fill(emitted, emitted + triangleCount, false);
+
+    // Vertices of recently emitted triangles, to restart from when a fan runs dry
+    std::uint32_t *deadEnds = arena.AllocateArray<std::uint32_t>(indexCount);
+    std::size_t deadEndCount = 0;
+
+    std::uint32_t *candidates = arena.AllocateArray<std::uint32_t>(indexCount);
+    std::uint32_t *output = arena.AllocateArray<std::uint32_t>(indexCount);
+    std::size_t outputCount = 0;
+
+    std::uint32_t scanCursor = 0;
+    std::uint32_t fanning = 0;
+    while (fanning != NO_VERTEX) {
+        // Emit every remaining triangle around the fanning vertex
+        std::size_t candidateCount = 0;
+        for (std::uint32_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+            std::uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++) {
+                std::uint32_t vertex = indices[triangle * 3 + corner];
+                output[outputCount++] = vertex;
+                deadEnds[deadEndCount++] = vertex;
+                candidates[candidateCount++] = vertex;
+                liveTriangles[vertex]--;
+
+                if (time - cacheTime[vertex] > static_cast<std::uint32_t>(cacheSize)) {
+                    cacheTime[vertex] = time++;
+                }
+            }
+        }
+
+        fanning = NextFanningVertex(candidates, candidateCount, liveTriangles, cacheTime, time, cacheSize);
+        if (fanning != NO_VERTEX) {
+            continue;
+        }
+
+        // Dead end: go back to a recently used vertex with triangles left, or else the next one in order
+        while (deadEndCount > 0 && fanning == NO_VERTEX) {
+            std::uint32_t vertex = deadEnds[--deadEndCount];
+            if (liveTriangles[vertex] > 0) {
+                fanning = vertex;
+            }
+        }
+        while (scanCursor < vertexCount && fanning == NO_VERTEX) {
+            if (liveTriangles[scanCursor] > 0) {
+                fanning = scanCursor;
+            }
+            scanCursor++;
+        }
+    }
+
+    std::copy(output, output + outputCount, indices);
+}
+
+void OptimizeVertexFetch(IndexedMesh &mesh) {
+    std::size_t vertexCount = mesh.vertices.size();
+    if (vertexCount == 0) {
+        return;
+    }
+
+    ScratchArena &arena = ScratchArena::ForThread();
+    ArenaScope scope(arena);
+
+    std::uint32_t *remap = arena.AllocateArray<std::uint32_t>(vertexCount);
+    std::fill(remap, remap + vertexCount, NO_VERTEX);
+
+    std::uint32_t next = 0;
+    for (std::uint32_t &index : mesh.indices) {
+        if (remap[index] == NO_VERTEX) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    for (std::size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == NO_VERTEX) {
+            remap[v] = next++;
+        }
+    }
+
+    Vector3 *vertices = arena.AllocateArray<Vector3>(vertexCount);
+    Vector3 *normals = arena.AllocateArray<Vector3>(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; v++) {
+        vertices[remap[v]] = mesh.vertices[v];
+        normals[remap[v]] = mesh.normals[v];
+    }
+    std::copy(vertices, vertices + vertexCount, mesh.vertices.begin());
+    std::copy(normals, normals + vertexCount, mesh.normals.begin());
+}
+
+void OptimizeMesh(IndexedMesh &mesh, ExtractionStats *stats) {
+    PROFILE_SCOPE(ProfileZone::MeshAssembly);
+
+    if (stats) {
+        stats->cacheMissesBefore += CountCacheMisses(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    OptimizeVertexFetch(mesh);
+
+    if (stats) {
+        auto end = std::chrono::steady_clock::now();
+        stats->optimizeMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        stats->cacheMissesAfter += CountCacheMisses(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        stats->trianglesOptimized += mesh.indices.size() / 3;
+    }
+}
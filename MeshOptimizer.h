@@ -0,0 +1,43 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+
+// Reordering of extracted meshes for the GPU's vertex caches.
+// Marching cubes emits triangles in cell scan order, so a vertex shared by the cells of two
+// neighbouring rows has long left the post-transform cache by the time the second row uses it again.
+// Reordering the triangles so neighbours follow each other lets most references hit the cache,
+// and renumbering the vertices in order of first use makes the vertex fetches walk memory linearly.
+//
+// Both passes only change the order of the data, never the surface, but the result is no longer
+// the canonical order ExtractChunk produces, so hash meshes before optimizing them.
+
+// Modelled post-transform cache size. Caches are FIFO on most GPUs and hold 16 to 32 vertices.
+constexpr int VERTEX_CACHE_SIZE = 16;
+
+// Number of vertex shader invocations drawing the triangles would take with a FIFO cache of the given size
+std::uint64_t CountCacheMisses(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount,
+                               int cacheSize = VERTEX_CACHE_SIZE);
+
+// Average cache miss ratio: cache misses per triangle. 3 is the worst case, a regular grid
+// approaches 0.5 and chunk meshes in scan order typically sit around 1.
+float ComputeACMR(const std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount,
+                  int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder triangles for the post-transform cache in place, using Tipsify (Sander, Nehab and Barczak,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). Runs in linear time.
+void OptimizeVertexCache(std::uint32_t *indices, std::size_t indexCount, std::size_t vertexCount,
+                         int cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumber vertices in the order the indices first reference them, moving positions and normals to match.
+// Vertices no triangle references are moved to the end.
+void OptimizeVertexFetch(IndexedMesh &mesh);
+
+// Run both passes on a mesh. Pass stats to record the cache misses before and after.
+void OptimizeMesh(IndexedMesh &mesh, ExtractionStats *stats = nullptr);
+
+#endif // MESHOPTIMIZER_H
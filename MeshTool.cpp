@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+#include "DensityField.h"
+#include "DensityProgram.h"
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+#include "MeshOptimizer.h"
+#include "MeshWriter.h"
+#include "SlabExtractor.h"
+#include "TaskSystem.h"
+#include "VolumeFile.h"
+
+// stillness-mesh: extracts the isosurface of a density source to a mesh file, without a window.
+// Chunks are sampled and polygonised on every core and handed to the writer in order as they complete.
+
+namespace {
+    const char *USAGE =
+        "Usage: stillness-mesh [options] <source> <output.ply|.obj|.glb>\n"
+        "\n"
+        "Sources:\n"
+        "  noise                    noise heightmap terrain, see --seed and friends\n"
+        "  <scene.sdf>              signed distance scene, see ParseDensityScene in DensityProgram.h\n"
+        "  <volume.nrrd|.nhdr|.vtk> raw volume, sampled at its own resolution\n"
+        "\n"
+        "Options:\n"
+        "  --grid X,Y,Z       cells along each axis for noise and scenes (default 128,64,128)\n"
+        "  --origin X,Y,Z     world position of the first sample (default: the grid centered on 0)\n"
+        "  --voxel-size S     distance between samples for noise and scenes (default 1)\n"
+        "  --iso L            isoLevel, densities below it are inside (default 0)\n"
+        "  --bright-inside    for volumes: samples above --iso are inside, as in most scans\n"
+        "  --threads N        extraction threads (default: every core)\n"
+        "  --optimize         reorder each chunk's triangles for the GPU vertex cache\n"
+        "  --stream           for volumes: extract slab by slab on one thread, in constant memory,\n"
+        "                     with vertices shared across chunk seams\n"
+        "  --stats PATH       also write the report to PATH\n"
+        "  --seed N --base-height H --amplitude A --frequency F\n"
+        "                     noise terrain parameters (default 1337, -10, 8, 0.01)\n"
+        "\n"
+        "Chunk meshes are written as they are, so vertices on the seams between chunks are duplicated.\n";
+
+    struct Options {
+        std::string source;
+        std::string output;
+        int grid[3] = { 128, 64, 128 };
+        std::optional<Vector3> origin;
+        float voxelSize = 1.0f;
+        double isoLevel = 0.0;
+        bool brightInside = false;
+        int threads = 0;
+        bool optimize = false;
+        bool stream = false;
+        std::string statsPath;
+
+        int seed = 1337;
+        float baseHeight = -10.0f;
+        float amplitude = 8.0f;
+        float frequency = 0.01f;
+    };
+
+    bool ParseNumber(const char *text, double &value) {
+        char *end;
+        value = std::strtod(text, &end);
+        return end != text && *end == '\0';
+    }
+
+    bool ParseTriple(const char *text, double values[3]) {
+        std::string copy = text;
+        for (int i = 0; i < 3; i++) {
+            std::size_t comma = copy.find(',');
+            if ((i < 2) != (comma != std::string::npos)) {
+                return false;
+            }
+            if (!ParseNumber(copy.substr(0, comma).c_str(), values[i])) {
+                return false;
+            }
+            copy = i < 2 ? copy.substr(comma + 1) : "";
+        }
+        return true;
+    }
+
+    // Returns false and prints why if the command line cannot be used
+    bool ParseOptions(int argc, char **argv, Options &options) {
+        std::vector<std::string> positional;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                positional.push_back(arg);
+                continue;
+            }
+
+            if (arg == "--bright-inside") {
+                options.brightInside = true;
+                continue;
+            }
+            if (arg == "--optimize") {
+                options.optimize = true;
+                continue;
+            }
+            if (arg == "--stream") {
+                options.stream = true;
+                continue;
+            }
+            if (arg == "--help") {
+                std::fputs(USAGE, stdout);
+                std::exit(0);
+            }
+
+            if (i + 1 == argc) {
+                std::fprintf(stderr, "%s needs a value\n", arg.c_str());
+                return false;
+            }
+            const char *value = argv[++i];
+
+            double number = 0.0;
+            double triple[3];
+            bool valid;
+            if (arg == "--grid" || arg == "--origin") {
+                valid = ParseTriple(value, triple);
+            } else if (arg == "--stats") {
+                options.statsPath = value;
+                continue;
+            } else {
+                valid = ParseNumber(value, number);
+            }
+            if (!valid) {
+                std::fprintf(stderr, "Invalid value '%s' for %s\n", value, arg.c_str());
+                return false;
+            }
+
+            if (arg == "--grid") {
+                for (int axis = 0; axis < 3; axis++) {
+                    options.grid[axis] = static_cast<int>(triple[axis]);
+                    if (options.grid[axis] < 1) {
+                        std::fprintf(stderr, "The grid needs at least one cell along each axis\n");
+                        return false;
+                    }
+                }
+            } else if (arg == "--origin") {
+                options.origin = Vector3 { static_cast<float>(triple[0]), static_cast<float>(triple[1]), static_cast<float>(triple[2]) };
+            } else if (arg == "--voxel-size") {
+                options.voxelSize = static_cast<float>(number);
+                if (options.voxelSize <= 0.0f) {
+                    std::fprintf(stderr, "The voxel size must be positive\n");
+                    return false;
+                }
+            } else if (arg == "--iso") {
+                options.isoLevel = number;
+            } else if (arg == "--threads") {
+                options.threads = std::max(1, static_cast<int>(number));
+            } else if (arg == "--seed") {
+                options.seed = static_cast<int>(number);
+            } else if (arg == "--base-height") {
+                options.baseHeight = static_cast<float>(number);
+            } else if (arg == "--amplitude") {
+                options.amplitude = static_cast<float>(number);
+            } else if (arg == "--frequency") {
+                options.frequency = static_cast<float>(number);
+            } else {
+                std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        if (positional.size() != 2) {
+            std::fputs(USAGE, stderr);
+            return false;
+        }
+        options.source = positional[0];
+        options.output = positional[1];
+
+        if (options.threads == 0) {
+            options.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        return true;
+    }
+
+    // Where the samples come from: a density field sampled on a grid, or a volume file read a chunk at a time
+    struct Source {
+        std::unique_ptr<DensityField> field;
+        VolumeReader volume;
+        std::mutex volumeMutex;
+
+        // Cells along each axis, and the world position and spacing of the samples
+        int cells[3] = { 0, 0, 0 };
+        Vector3 origin = { 0.0f, 0.0f, 0.0f };
+        Vector3 spacing = { 1.0f, 1.0f, 1.0f };
+        bool isVolume = false;
+    };
+
+    bool OpenSource(const Options &options, Source &source) {
+        auto gridOrigin = [&] {
+            return options.origin.value_or(Vector3 { -options.grid[0] * 0.5f * options.voxelSize,
+                                                     -options.grid[1] * 0.5f * options.voxelSize,
+                                                     -options.grid[2] * 0.5f * options.voxelSize });
+        };
+
+        std::string extension = std::filesystem::path(options.source).extension().string();
+        if (options.source == "noise" || extension == ".sdf") {
+            if (options.source == "noise") {
+                source.field = std::make_unique<TerrainDensityField>(options.seed, options.baseHeight, options.amplitude, options.frequency);
+            } else {
+                DensityExpr scene;
+                std::string error;
+                if (!LoadDensityScene(options.source, scene, error)) {
+                    std::fprintf(stderr, "%s\n", error.c_str());
+                    return false;
+                }
+                source.field = std::make_unique<DensityProgram>(scene);
+            }
+
+            std::copy(options.grid, options.grid + 3, source.cells);
+            source.origin = gridOrigin();
+            source.spacing = { options.voxelSize, options.voxelSize, options.voxelSize };
+            return true;
+        }
+
+        if (!source.volume.Open(options.source)) {
+            std::fprintf(stderr, "%s\n", source.volume.GetError().c_str());
+            return false;
+        }
+
+        const VolumeHeader &header = source.volume.GetHeader();
+        if (header.width < 2 || header.height < 2 || header.depth < 2) {
+            std::fprintf(stderr, "%s: a volume needs at least two samples along each axis\n", options.source.c_str());
+            return false;
+        }
+        if (options.brightInside) {
+            source.volume.SetDensityMapping(-1.0f, 0.0f);
+        }
+
+        source.cells[0] = header.width - 1;
+        source.cells[1] = header.height - 1;
+        source.cells[2] = header.depth - 1;
+        source.origin = options.origin.value_or(header.origin);
+        source.spacing = header.spacing;
+        source.isVolume = true;
+        return true;
+    }
+
+    // Turn a chunk mesh extracted in sample units into a world space piece of the grid. Chunks are whole,
+    // so along the far faces of the grid they run past it: triangles reaching past the last sample are
+    // dropped along with the vertices only they used. Volumes repeat their edge samples there, which
+    // never produces a triangle that lies entirely on the last sample plane, so the cut is exact.
+    void FinishChunkMesh(IndexedMesh &mesh, const Source &source, ExtractionStats &stats) {
+        auto inside = [&](const Vector3 &p) {
+            return p.x <= source.cells[0] && p.y <= source.cells[1] && p.z <= source.cells[2];
+        };
+
+        std::size_t indexCount = 0;
+        for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const std::uint32_t *triangle = &mesh.indices[i];
+            if (inside(mesh.vertices[triangle[0]]) && inside(mesh.vertices[triangle[1]]) && inside(mesh.vertices[triangle[2]])) {
+                std::copy(triangle, triangle + 3, &mesh.indices[indexCount]);
+                indexCount += 3;
+            }
+        }
+
+        // Kept vertices are numbered in their original order, so they only ever move down and can be compacted in place
+        std::vector<std::uint32_t> remap(mesh.vertices.size(), ~0u);
+        for (std::size_t i = 0; i < indexCount; i++) {
+            remap[mesh.indices[i]] = 0;
+        }
+        std::uint32_t kept = 0;
+        for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+            if (remap[i] != ~0u) {
+                remap[i] = kept++;
+                mesh.vertices[remap[i]] = mesh.vertices[i];
+                mesh.normals[remap[i]] = mesh.normals[i];
+            }
+        }
+        for (std::size_t i = 0; i < indexCount; i++) {
+            mesh.indices[i] = remap[mesh.indices[i]];
+        }
+
+        stats.trianglesEmitted -= (mesh.indices.size() - indexCount) / 3;
+        stats.verticesEmitted -= mesh.vertices.size() - kept;
+        mesh.indices.resize(indexCount);
+        mesh.vertices.resize(kept);
+        mesh.normals.resize(kept);
+
+        // Normals are gradients, which scale by the inverse of the spacing
+        for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+            Vector3 &p = mesh.vertices[i];
+            p = { source.origin.x + p.x * source.spacing.x, source.origin.y + p.y * source.spacing.y, source.origin.z + p.z * source.spacing.z };
+
+            Vector3 &n = mesh.normals[i];
+            n = { n.x / source.spacing.x, n.y / source.spacing.y, n.z / source.spacing.z };
+            float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            if (length > 0.0f) {
+                n = { n.x / length, n.y / length, n.z / length };
+            }
+        }
+    }
+
+    struct RunTotals {
+        ExtractionStats stats;
+        int chunks = 0;
+        double densityMilliseconds = 0.0;
+        double writeWaitMilliseconds = 0.0;
+    };
+
+    // Sample and extract every chunk of the grid as tasks, on options.threads - 1 workers and the writing thread.
+    // Chunks are written in order, and at most a few chunks per thread are queued or done ahead of the writer,
+    // so memory stays bounded.
+    bool ExtractChunks(const Options &options, Source &source, double isoLevel, MeshWriter &writer, RunTotals &totals) {
+        const int chunksX = (source.cells[0] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        const int chunksY = (source.cells[1] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        const int chunksZ = (source.cells[2] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        const int chunkCount = chunksX * chunksY * chunksZ;
+        const int window = options.threads * 4;
+        totals.chunks = chunkCount;
+
+        TaskSystem tasks(options.threads - 1);
+        CancelToken cancel = CancelToken::Create();
+        std::vector<TaskHandle> chunkTasks(chunkCount);
+        std::vector<IndexedMesh> finished(chunkCount);
+        std::atomic<bool> failed = false;
+
+        // By TaskSystem::GetWorkerIndex, which is 0 for the writing thread
+        MarchingCubes marchingCubes;
+        std::vector<Chunk> workerChunks(options.threads);
+        std::vector<ExtractionStats> workerStats(options.threads);
+        std::vector<double> workerDensityMs(options.threads, 0.0);
+
+        auto extract = [&](int index) {
+            const int worker = TaskSystem::GetWorkerIndex();
+            Chunk &chunk = workerChunks[worker];
+            ChunkCoord coord = { index % chunksX, index / chunksX % chunksY, index / (chunksX * chunksY) };
+            Vector3 sampleOrigin = { static_cast<float>(coord.x * CHUNK_SIZE), static_cast<float>(coord.y * CHUNK_SIZE), static_cast<float>(coord.z * CHUNK_SIZE) };
+
+            auto start = std::chrono::steady_clock::now();
+            bool sampled = true;
+            if (source.isVolume) {
+                std::lock_guard<std::mutex> lock(source.volumeMutex);
+                sampled = source.volume.ReadChunk(coord, chunk);
+            } else {
+                Vector3 origin = { source.origin.x + sampleOrigin.x * source.spacing.x,
+                                   source.origin.y + sampleOrigin.y * source.spacing.y,
+                                   source.origin.z + sampleOrigin.z * source.spacing.z };
+                chunk.coord = coord;
+                source.field->SampleBlock(origin, source.spacing.x, CHUNK_SAMPLES, chunk.densities.data());
+                chunk.UpdateBounds();
+            }
+            workerDensityMs[worker] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (!sampled) {
+                failed = true;
+                cancel.Cancel();
+                return;
+            }
+
+            IndexedMesh mesh = marchingCubes.ExtractChunk(chunk, sampleOrigin, 1.0f, isoLevel, &workerStats[worker]);
+            FinishChunkMesh(mesh, source, workerStats[worker]);
+            if (options.optimize && !mesh.indices.empty()) {
+                OptimizeMesh(mesh, &workerStats[worker]);
+            }
+            finished[index] = std::move(mesh);
+        };
+
+        int submitted = 0;
+        for (int index = 0; index < chunkCount; index++) {
+            for (; submitted < std::min(index + window, chunkCount); submitted++) {
+                chunkTasks[submitted] = tasks.Submit([&extract, submitted] { extract(submitted); }, {}, 0.0f, cancel);
+            }
+
+            // Runs queued chunks while this one is not done yet
+            auto start = std::chrono::steady_clock::now();
+            bool ran = tasks.Wait(chunkTasks[index]);
+            totals.writeWaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!ran || failed) {
+                break;
+            }
+
+            writer.Append(finished[index]);
+            finished[index] = {};
+        }
+
+        // Drops the chunks still queued if one failed
+        tasks.WaitAll();
+
+        for (int i = 0; i < options.threads; i++) {
+            totals.stats.Merge(workerStats[i]);
+            totals.densityMilliseconds += workerDensityMs[i];
+        }
+
+        if (failed) {
+            std::fprintf(stderr, "%s\n", source.volume.GetError().c_str());
+        }
+        return !failed;
+    }
+
+    std::string Report(const Options &options, const Source &source, double isoLevel, const MeshWriter &writer,
+                       const RunTotals &totals, double totalMilliseconds) {
+        char text[1024];
+        std::string report;
+
+        std::snprintf(text, sizeof(text),
+                      "Source: %s\n"
+                      "Grid: %d x %d x %d cells, spacing %g %g %g, origin %g %g %g, isoLevel %g\n",
+                      options.source.c_str(), source.cells[0], source.cells[1], source.cells[2],
+                      source.spacing.x, source.spacing.y, source.spacing.z, source.origin.x, source.origin.y, source.origin.z, isoLevel);
+        report += text;
+
+        if (options.stream) {
+            std::snprintf(text, sizeof(text), "Extraction: streamed slab by slab on one thread\n");
+        } else {
+            std::snprintf(text, sizeof(text), "Extraction: %d chunks on %d threads, %.1f ms sampling, %.1f ms waiting for chunks\n",
+                          totals.chunks, options.threads, totals.densityMilliseconds, totals.writeWaitMilliseconds);
+        }
+        report += text;
+
+        std::error_code error;
+        std::uintmax_t bytes = std::filesystem::file_size(options.output, error);
+        std::snprintf(text, sizeof(text), "Output: %s, %llu vertices, %llu triangles, %.2f MiB\nTotal: %.1f ms\n",
+                      options.output.c_str(), static_cast<unsigned long long>(writer.GetVertexCount()),
+                      static_cast<unsigned long long>(writer.GetTriangleCount()), error ? 0.0 : bytes / 1048576.0, totalMilliseconds);
+        report += text;
+
+        return report + totals.stats.ToString();
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    MeshFormat format;
+    if (!MeshFormatFromPath(options.output, format)) {
+        std::fprintf(stderr, "Cannot tell the mesh format of '%s', use .ply, .obj or .glb\n", options.output.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Source source;
+    if (!OpenSource(options, source)) {
+        return 1;
+    }
+    if (options.stream && !source.isVolume) {
+        std::fprintf(stderr, "--stream only works on volumes\n");
+        return 1;
+    }
+
+    // Bright inside flips the sign of the densities, and with it the isoLevel
+    double isoLevel = options.brightInside && source.isVolume ? -options.isoLevel : options.isoLevel;
+
+    std::unique_ptr<MeshWriter> writer = MeshWriter::Create(format);
+    if (!writer->Open(options.output)) {
+        std::fprintf(stderr, "%s\n", writer->GetError().c_str());
+        return 1;
+    }
+
+    RunTotals totals;
+    bool extracted;
+    if (options.stream) {
+        // The slab extractor works in world space and shares vertices across the whole volume
+        VolumeHeader header = source.volume.GetHeader();
+        header.origin = source.origin;
+        source.volume.Close();
+        extracted = source.volume.Open(header);
+        if (extracted) {
+            if (options.brightInside) {
+                source.volume.SetDensityMapping(-1.0f, 0.0f);
+            }
+            extracted = ExtractVolume(source.volume, isoLevel, [&](const IndexedMesh &layer, std::uint32_t firstVertex) {
+                writer->AppendLayer(layer, firstVertex);
+            }, &totals.stats);
+        }
+        if (!extracted) {
+            std::fprintf(stderr, "%s\n", source.volume.GetError().c_str());
+        }
+    } else {
+        extracted = ExtractChunks(options, source, isoLevel, *writer, totals);
+    }
+
+    bool written = writer->Close();
+    if (!written) {
+        std::fprintf(stderr, "%s\n", writer->GetError().c_str());
+    }
+    if (!extracted || !written) {
+        return 1;
+    }
+
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::string report = Report(options, source, isoLevel, *writer, totals, totalMs);
+    std::fputs(report.c_str(), stdout);
+
+    if (!options.statsPath.empty()) {
+        std::FILE *file = std::fopen(options.statsPath.c_str(), "w");
+        if (file == nullptr || std::fputs(report.c_str(), file) < 0) {
+            std::fprintf(stderr, "Cannot write the report to '%s'\n", options.statsPath.c_str());
+            if (file != nullptr) {
+                std::fclose(file);
+            }
+            return 1;
+        }
+        std::fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,461 @@
+#include "MeshWriter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+namespace {
+    constexpr std::size_t COPY_BUFFER_BYTES = 1 << 20;
+
+    template <typename T>
+    void AppendBytes(std::vector<char> &bytes, const T &value) {
+        const char *data = reinterpret_cast<const char *>(&value);
+        bytes.insert(bytes.end(), data, data + sizeof(T));
+    }
+
+    void AppendText(std::vector<char> &text, const char *value) {
+        text.insert(text.end(), value, value + std::strlen(value));
+    }
+
+    // Shortest text that reads back as exactly the same float
+    void AppendNumber(std::vector<char> &text, float value) {
+        char buffer[32];
+        char *end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        text.insert(text.end(), buffer, end);
+    }
+
+    void AppendNumber(std::vector<char> &text, std::uint64_t value) {
+        char buffer[32];
+        char *end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        text.insert(text.end(), buffer, end);
+    }
+
+    // Binary PLY. The counts in the header are unknown until the end, so the header is written with room
+    // for them and patched on Close. Vertices go straight to the output and faces to a temporary file,
+    // which is appended after the last vertex.
+    class PlyMeshWriter : public MeshWriter {
+    protected:
+        bool Begin() override {
+            faces = OpenTemporary();
+            if (faces == nullptr) {
+                return false;
+            }
+
+            std::string header = Header(0, 0);
+            Write(output, std::vector<char>(header.begin(), header.end()));
+            return true;
+        }
+
+        void WriteVertices(const IndexedMesh &mesh) override {
+            std::vector<char> bytes;
+            bytes.reserve(mesh.vertices.size() * 6 * sizeof(float));
+            for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+                AppendBytes(bytes, mesh.vertices[i]);
+                AppendBytes(bytes, mesh.normals[i]);
+            }
+            Write(output, std::move(bytes));
+        }
+
+        void WriteTriangles(const IndexedMesh &mesh, std::uint32_t indexOffset) override {
+            std::vector<char> bytes;
+            bytes.reserve(mesh.indices.size() / 3 * (1 + 3 * sizeof(std::uint32_t)));
+            for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+                bytes.push_back(3);
+                for (int corner = 0; corner < 3; corner++) {
+                    AppendBytes(bytes, static_cast<std::uint32_t>(mesh.indices[i + corner] + indexOffset));
+                }
+            }
+            Write(faces, std::move(bytes));
+        }
+
+        void End() override {
+            QueueCopy(faces);
+
+            std::string header = Header(vertexCount, triangleCount);
+            std::FILE *file = output;
+            QueueJob([this, file, header] {
+                if (std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+                    Fail("cannot write the PLY header");
+                }
+            });
+        }
+
+    private:
+        // Counts are padded to a fixed width, so the final header is as long as the placeholder
+        static std::string Header(std::uint64_t vertices, std::uint64_t faces) {
+            char header[512];
+            std::snprintf(header, sizeof(header),
+                "ply\n"
+                "format %s 1.0\n"
+                "comment stillness isosurface\n"
+                "element vertex %012llu\n"
+                "property float x\nproperty float y\nproperty float z\n"
+                "property float nx\nproperty float ny\nproperty float nz\n"
+                "element face %012llu\n"
+                "property list uchar uint vertex_indices\n"
+                "end_header\n",
+                std::endian::native == std::endian::little ? "binary_little_endian" : "binary_big_endian",
+                static_cast<unsigned long long>(vertices), static_cast<unsigned long long>(faces));
+            return header;
+        }
+
+        std::FILE *faces = nullptr;
+    };
+
+    // Wavefront OBJ. Vertices only have to be defined before the faces using them, so everything is
+    // written straight to the output.
+    class ObjMeshWriter : public MeshWriter {
+    protected:
+        bool Begin() override {
+            std::vector<char> text;
+            AppendText(text, "# stillness isosurface\n");
+            Write(output, std::move(text));
+            return true;
+        }
+
+        void WriteVertices(const IndexedMesh &mesh) override {
+            std::vector<char> text;
+            text.reserve(mesh.vertices.size() * 80);
+            for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+                const Vector3 &position = mesh.vertices[i];
+                const Vector3 &normal = mesh.normals[i];
+                AppendText(text, "v ");
+                AppendNumber(text, position.x);
+                text.push_back(' ');
+                AppendNumber(text, position.y);
+                text.push_back(' ');
+                AppendNumber(text, position.z);
+                AppendText(text, "\nvn ");
+                AppendNumber(text, normal.x);
+                text.push_back(' ');
+                AppendNumber(text, normal.y);
+                text.push_back(' ');
+                AppendNumber(text, normal.z);
+                text.push_back('\n');
+            }
+            Write(output, std::move(text));
+        }
+
+        void WriteTriangles(const IndexedMesh &mesh, std::uint32_t indexOffset) override {
+            std::vector<char> text;
+            text.reserve(mesh.indices.size() / 3 * 48);
+            for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+                text.push_back('f');
+                for (int corner = 0; corner < 3; corner++) {
+                    // OBJ counts from 1, and each vertex has the normal of the same number
+                    std::uint64_t index = static_cast<std::uint64_t>(mesh.indices[i + corner]) + indexOffset + 1;
+                    text.push_back(' ');
+                    AppendNumber(text, index);
+                    AppendText(text, "//");
+                    AppendNumber(text, index);
+                }
+                text.push_back('\n');
+            }
+            Write(output, std::move(text));
+        }
+
+        void End() override {
+        }
+    };
+
+    // Binary glTF. The JSON chunk describing the buffers comes first and needs the final counts and bounds,
+    // so the interleaved vertices and the indices are kept in temporary files and copied in after it.
+    // glTF sizes are 32 bit, which limits a file to 4 GiB, about 170 million vertices.
+    class GltfMeshWriter : public MeshWriter {
+    protected:
+        bool Begin() override {
+            vertices = OpenTemporary();
+            indices = OpenTemporary();
+            return vertices != nullptr && indices != nullptr;
+        }
+
+        void WriteVertices(const IndexedMesh &mesh) override {
+            std::vector<char> bytes;
+            bytes.reserve(mesh.vertices.size() * VERTEX_STRIDE);
+            for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+                AppendBytes(bytes, mesh.vertices[i]);
+                AppendBytes(bytes, mesh.normals[i]);
+            }
+            Write(vertices, std::move(bytes));
+        }
+
+        void WriteTriangles(const IndexedMesh &mesh, std::uint32_t indexOffset) override {
+            std::vector<char> bytes;
+            bytes.reserve(mesh.indices.size() * sizeof(std::uint32_t));
+            for (std::uint32_t index : mesh.indices) {
+                AppendBytes(bytes, static_cast<std::uint32_t>(index + indexOffset));
+            }
+            Write(indices, std::move(bytes));
+        }
+
+        void End() override {
+            std::uint64_t vertexBytes = vertexCount * VERTEX_STRIDE;
+            std::uint64_t indexBytes = triangleCount * 3 * sizeof(std::uint32_t);
+            std::string json = Json(vertexBytes, indexBytes);
+
+            // The JSON chunk is padded with spaces to keep the binary chunk 4 byte aligned
+            json.append((4 - json.size() % 4) % 4, ' ');
+
+            std::uint64_t totalBytes = 12 + 8 + json.size() + 8 + vertexBytes + indexBytes;
+            if (totalBytes > 0xffffffffu) {
+                Fail("mesh too large for a glTF file");
+                return;
+            }
+
+            std::vector<char> header;
+            AppendBytes(header, std::uint32_t(0x46546c67));     // "glTF"
+            AppendBytes(header, std::uint32_t(2));
+            AppendBytes(header, static_cast<std::uint32_t>(totalBytes));
+            AppendBytes(header, static_cast<std::uint32_t>(json.size()));
+            AppendBytes(header, std::uint32_t(0x4e4f534a));     // "JSON"
+            header.insert(header.end(), json.begin(), json.end());
+            AppendBytes(header, static_cast<std::uint32_t>(vertexBytes + indexBytes));
+            AppendBytes(header, std::uint32_t(0x004e4942));     // "BIN"
+            Write(output, std::move(header));
+
+            QueueCopy(vertices);
+            QueueCopy(indices);
+        }
+
+    private:
+        static constexpr std::uint64_t VERTEX_STRIDE = 2 * sizeof(Vector3);
+
+        std::string Json(std::uint64_t vertexBytes, std::uint64_t indexBytes) const {
+            std::string json = R"({"asset":{"version":"2.0","generator":"stillness"},"scene":0)";
+            if (triangleCount == 0) {
+                return json + R"(,"scenes":[{"nodes":[]}]})";
+            }
+
+            auto number = [](auto value) {
+                std::vector<char> text;
+                AppendNumber(text, value);
+                return std::string(text.begin(), text.end());
+            };
+
+            json += R"(,"scenes":[{"nodes":[0]}],"nodes":[{"mesh":0}])";
+            json += R"(,"meshes":[{"primitives":[{"attributes":{"POSITION":0,"NORMAL":1},"indices":2}]}])";
+            json += R"(,"buffers":[{"byteLength":)" + number(vertexBytes + indexBytes) + "}]";
+            json += R"(,"bufferViews":[{"buffer":0,"byteOffset":0,"byteLength":)" + number(vertexBytes) +
+                    R"(,"byteStride":)" + number(VERTEX_STRIDE) + R"(,"target":34962})";
+            json += R"(,{"buffer":0,"byteOffset":)" + number(vertexBytes) + R"(,"byteLength":)" + number(indexBytes) +
+                    R"(,"target":34963}])";
+            json += R"(,"accessors":[{"bufferView":0,"byteOffset":0,"componentType":5126,"count":)" + number(vertexCount) +
+                    R"(,"type":"VEC3","min":[)" + number(boundsMin.x) + "," + number(boundsMin.y) + "," + number(boundsMin.z) +
+                    R"(],"max":[)" + number(boundsMax.x) + "," + number(boundsMax.y) + "," + number(boundsMax.z) + "]}";
+            json += R"(,{"bufferView":0,"byteOffset":12,"componentType":5126,"count":)" + number(vertexCount) + R"(,"type":"VEC3"})";
+            json += R"(,{"bufferView":1,"byteOffset":0,"componentType":5125,"count":)" + number(triangleCount * 3) + R"(,"type":"SCALAR"}]})";
+            return json;
+        }
+
+        std::FILE *vertices = nullptr;
+        std::FILE *indices = nullptr;
+    };
+}
+
+bool MeshFormatFromPath(const std::string &path, MeshFormat &format) {
+    std::size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "ply") {
+        format = MeshFormat::Ply;
+    } else if (extension == "obj") {
+        format = MeshFormat::Obj;
+    } else if (extension == "glb") {
+        format = MeshFormat::Gltf;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+BackgroundWriter::BackgroundWriter(std::size_t maxPendingBytes) : maxPendingBytes(maxPendingBytes) {
+    thread = std::thread(&BackgroundWriter::Run, this);
+}
+
+BackgroundWriter::~BackgroundWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobQueued.notify_one();
+    thread.join();
+}
+
+void BackgroundWriter::Queue(std::function<void()> job, std::size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // A single job larger than the limit still goes through once the queue has drained
+    jobDone.wait(lock, [&] { return pendingBytes == 0 || pendingBytes + bytes <= maxPendingBytes; });
+
+    jobs.push_back({ std::move(job), bytes });
+    pendingBytes += bytes;
+    lock.unlock();
+    jobQueued.notify_one();
+}
+
+void BackgroundWriter::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&] { return jobs.empty() && !busy; });
+}
+
+void BackgroundWriter::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobQueued.wait(lock, [&] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+
+        lock.unlock();
+        job.run();
+        lock.lock();
+
+        busy = false;
+        pendingBytes -= job.bytes;
+        jobDone.notify_all();
+    }
+}
+
+std::unique_ptr<MeshWriter> MeshWriter::Create(MeshFormat format) {
+    switch (format) {
+        case MeshFormat::Ply: return std::make_unique<PlyMeshWriter>();
+        case MeshFormat::Obj: return std::make_unique<ObjMeshWriter>();
+        case MeshFormat::Gltf: return std::make_unique<GltfMeshWriter>();
+    }
+    return nullptr;
+}
+
+MeshWriter::~MeshWriter() {
+    // Let queued writes finish before the files go away. A writer destroyed without Close leaves an incomplete file.
+    io.Flush();
+    for (std::FILE *file : temporaries) {
+        std::fclose(file);
+    }
+    if (output != nullptr) {
+        std::fclose(output);
+    }
+}
+
+bool MeshWriter::Open(const std::string &path) {
+    output = std::fopen(path.c_str(), "wb");
+    if (output == nullptr) {
+        Fail("cannot create '" + path + "'");
+        return false;
+    }
+    return Begin();
+}
+
+void MeshWriter::Append(const IndexedMesh &mesh) {
+    AppendPiece(mesh, static_cast<std::uint32_t>(vertexCount));
+}
+
+void MeshWriter::AppendLayer(const IndexedMesh &layer, std::uint32_t firstVertex) {
+    if (firstVertex != vertexCount) {
+        Fail("layers appended out of order");
+        return;
+    }
+    AppendPiece(layer, 0);
+}
+
+void MeshWriter::AppendPiece(const IndexedMesh &mesh, std::uint32_t indexOffset) {
+    if (output == nullptr) {
+        return;
+    }
+
+    if (vertexCount == 0 && !mesh.vertices.empty()) {
+        boundsMin = mesh.vertices.front();
+        boundsMax = mesh.vertices.front();
+    }
+    for (const Vector3 &position : mesh.vertices) {
+        boundsMin = { std::min(boundsMin.x, position.x), std::min(boundsMin.y, position.y), std::min(boundsMin.z, position.z) };
+        boundsMax = { std::max(boundsMax.x, position.x), std::max(boundsMax.y, position.y), std::max(boundsMax.z, position.z) };
+    }
+
+    if (!mesh.vertices.empty()) {
+        WriteVertices(mesh);
+    }
+    if (!mesh.indices.empty()) {
+        WriteTriangles(mesh, indexOffset);
+    }
+
+    vertexCount += mesh.vertices.size();
+    triangleCount += mesh.indices.size() / 3;
+}
+
+bool MeshWriter::Close() {
+    if (output == nullptr) {
+        return false;
+    }
+
+    End();
+    io.Flush();
+
+    if (std::fclose(output) != 0) {
+        Fail("cannot finish writing the output");
+    }
+    output = nullptr;
+
+    std::lock_guard<std::mutex> lock(errorMutex);
+    return !failed;
+}
+
+std::string MeshWriter::GetError() const {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    return error;
+}
+
+void MeshWriter::Write(std::FILE *file, std::vector<char> &&bytes) {
+    std::size_t size = bytes.size();
+    io.Queue([this, file, bytes = std::move(bytes)] {
+        if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+            Fail("write failed, the disk may be full");
+        }
+    }, size);
+}
+
+void MeshWriter::QueueJob(std::function<void()> job) {
+    io.Queue(std::move(job), 0);
+}
+
+void MeshWriter::QueueCopy(std::FILE *from) {
+    std::FILE *to = output;
+    QueueJob([this, from, to] {
+        std::vector<char> buffer(COPY_BUFFER_BYTES);
+        std::rewind(from);
+        std::size_t count;
+        while ((count = std::fread(buffer.data(), 1, buffer.size(), from)) > 0) {
+            if (std::fwrite(buffer.data(), 1, count, to) != count) {
+                Fail("write failed, the disk may be full");
+                return;
+            }
+        }
+        if (std::ferror(from)) {
+            Fail("cannot read back a temporary file");
+        }
+    });
+}
+
+void MeshWriter::Fail(const std::string &message) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!failed) {
+        failed = true;
+        error = message;
+    }
+}
+
+std::FILE *MeshWriter::OpenTemporary() {
+    std::FILE *file = std::tmpfile();
+    if (file == nullptr) {
+        Fail("cannot create a temporary file");
+        return nullptr;
+    }
+    temporaries.push_back(file);
+    return file;
+}
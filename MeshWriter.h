@@ -0,0 +1,140 @@
+#ifndef MESHWRITER_H
+#define MESHWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <raylib.h>
+
+#include "MarchingCubes.h"
+
+// Export of extracted surfaces to binary PLY, OBJ and binary glTF (.glb).
+// Meshes are written piece by piece, a chunk or a layer of a streamed volume at a time, so the whole
+// surface never has to be in memory. Pieces are encoded on the calling thread and written to disk on
+// the writer's own I/O thread, which the caller only waits for when too much data is queued.
+// Formats that need totals up front keep the data in temporary files until Close.
+
+enum class MeshFormat {
+    Ply,
+    Obj,
+    Gltf
+};
+
+// Pick the format from a file extension: .ply, .obj or .glb. Returns false for anything else.
+bool MeshFormatFromPath(const std::string &path, MeshFormat &format);
+
+// Runs jobs one after another on a thread of its own
+class BackgroundWriter {
+public:
+    // Queue blocks once the jobs waiting to run hold more than this many bytes
+    explicit BackgroundWriter(std::size_t maxPendingBytes = 64 << 20);
+    ~BackgroundWriter();
+    BackgroundWriter(const BackgroundWriter &) = delete;
+    BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+
+    // Queue a job holding bytes bytes of data
+    void Queue(std::function<void()> job, std::size_t bytes);
+
+    // Wait until every queued job has run
+    void Flush();
+
+private:
+    void Run();
+
+    struct Job {
+        std::function<void()> run;
+        std::size_t bytes;
+    };
+
+    std::mutex mutex;
+    std::condition_variable jobQueued;
+    std::condition_variable jobDone;
+    std::deque<Job> jobs;
+    std::size_t pendingBytes = 0;
+    std::size_t maxPendingBytes;
+    bool busy = false;
+    bool stopping = false;
+    std::thread thread;
+};
+
+class MeshWriter {
+public:
+    static std::unique_ptr<MeshWriter> Create(MeshFormat format);
+
+    virtual ~MeshWriter();
+    MeshWriter(const MeshWriter &) = delete;
+    MeshWriter &operator=(const MeshWriter &) = delete;
+
+    bool Open(const std::string &path);
+
+    // Append a mesh whose indices refer to its own vertices, like a chunk from ExtractChunk
+    void Append(const IndexedMesh &mesh);
+
+    // Append a layer from SlabExtractor, whose indices count vertices across the whole stream.
+    // firstVertex must equal GetVertexCount(): layers have to arrive in order.
+    void AppendLayer(const IndexedMesh &layer, std::uint32_t firstVertex);
+
+    // Finish the file and wait for it to be written. Returns false if anything failed along the way.
+    bool Close();
+
+    std::uint64_t GetVertexCount() const { return vertexCount; }
+    std::uint64_t GetTriangleCount() const { return triangleCount; }
+
+    // Why Open or Close failed
+    std::string GetError() const;
+
+protected:
+    MeshWriter() = default;
+
+    // Called once the output file is open, to write or reserve a header
+    virtual bool Begin() = 0;
+
+    // Encode the vertices of a piece, and its triangles with indexOffset added to every index
+    virtual void WriteVertices(const IndexedMesh &mesh) = 0;
+    virtual void WriteTriangles(const IndexedMesh &mesh, std::uint32_t indexOffset) = 0;
+
+    // Queue whatever completes the file, after the last piece
+    virtual void End() = 0;
+
+    // Queue bytes to be appended to a file, or a job, on the I/O thread
+    void Write(std::FILE *file, std::vector<char> &&bytes);
+    void QueueJob(std::function<void()> job);
+
+    // Queue appending everything written to a temporary file to the output
+    void QueueCopy(std::FILE *from);
+
+    // Record an error, from any thread. Only the first one is kept.
+    void Fail(const std::string &message);
+
+    // A temporary file, deleted when closed. Returns null and records an error on failure.
+    std::FILE *OpenTemporary();
+
+    std::FILE *output = nullptr;
+    std::uint64_t vertexCount = 0;
+    std::uint64_t triangleCount = 0;
+
+    // Bounds of the positions written so far
+    Vector3 boundsMin = { 0.0f, 0.0f, 0.0f };
+    Vector3 boundsMax = { 0.0f, 0.0f, 0.0f };
+
+private:
+    void AppendPiece(const IndexedMesh &mesh, std::uint32_t indexOffset);
+
+    std::vector<std::FILE *> temporaries;
+    mutable std::mutex errorMutex;
+    std::string error;
+    bool failed = false;
+
+    // Declared last so the I/O thread stops before anything its jobs use is destroyed
+    BackgroundWriter io;
+};
+
+#endif // MESHWRITER_H
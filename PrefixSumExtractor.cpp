@@ -0,0 +1,358 @@
+#include "PrefixSumExtractor.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "MarchingCubesCell.h"
+#include "Profiler.h"
+
+namespace {
+    // Bits of the CHUNK_SAMPLES samples of a row, and of the CHUNK_SIZE edges or cells along it
+    constexpr std::uint64_t SAMPLE_MASK = (std::uint64_t(1) << CHUNK_SAMPLES) - 1;
+    constexpr std::uint64_t CELL_MASK = (std::uint64_t(1) << CHUNK_SIZE) - 1;
+}
+
+PrefixSumExtractor::PrefixSumExtractor(float voxelSize, double isoLevel) : voxelSize(voxelSize), isoLevel(isoLevel) {
+    // The smallest float not below the isoLevel: a float sample is below one exactly when it is below the other
+    insideBelow = static_cast<float>(isoLevel);
+    if (insideBelow < isoLevel) {
+        insideBelow = std::nextafter(insideBelow, std::numeric_limits<float>::infinity());
+    }
+
+    for (int cubeIndex = 0; cubeIndex < 256; cubeIndex++) {
+        int corners = 0;
+        while (MarchingCubesTables::triTable[cubeIndex][corners] != -1) {
+            corners++;
+        }
+        caseTriangles[cubeIndex] = static_cast<std::uint8_t>(corners / 3);
+    }
+}
+
+void PrefixSumExtractor::AddChunk(const Chunk &chunk, Vector3 origin) {
+    chunks.push_back({ &chunk, origin });
+}
+
+IndexedMesh PrefixSumExtractor::Extract(TaskSystem *tasks, ExtractionStats *stats) {
+    // A system without workers runs every part on this thread while it waits
+    TaskSystem inlineTasks(0);
+    TaskSystem &system = tasks != nullptr ? *tasks : inlineTasks;
+    const int parts = system.GetWorkerCount() + 1;
+    const int rows = static_cast<int>(chunks.size()) * CHUNK_ROWS;
+
+    rowInside.resize(rows);
+    rowEdges.resize(rows);
+    rowVertices.resize(rows);
+    rowTriangles.resize(rows);
+    rowKept.resize(rows);
+    partTotals.assign(parts, { 0, 0 });
+
+    IndexedMesh mesh;
+    std::vector<ExtractionStats> partStats(stats != nullptr ? parts : 0);
+    auto countStart = std::chrono::steady_clock::now();
+
+    // Counting needs the inside bits of the rows above, which may belong to another part
+    TaskHandle classified = system.ParallelFor(rows, parts, [&](int, int begin, int end) {
+        PROFILE_SCOPE(ProfileZone::Classify);
+        ClassifyRows(begin, end);
+    });
+
+    // Exclusive scan: every part scans its own rows, one task scans the part totals,
+    // and every part then adds the total of the parts before it to its rows
+    TaskHandle counted = system.ParallelFor(rows, parts, [&](int part, int begin, int end) {
+        PROFILE_SCOPE(ProfileZone::Classify);
+        CountRows(begin, end, stats != nullptr ? &partStats[part] : nullptr);
+
+        std::uint64_t vertices = 0;
+        std::uint64_t triangles = 0;
+        for (int row = begin; row < end; row++) {
+            std::uint32_t rowVertexCount = rowVertices[row];
+            std::uint32_t rowTriangleCount = rowTriangles[row];
+            rowVertices[row] = static_cast<std::uint32_t>(vertices);
+            rowTriangles[row] = static_cast<std::uint32_t>(triangles);
+            vertices += rowVertexCount;
+            triangles += rowTriangleCount;
+        }
+        partTotals[part] = { vertices, triangles };
+    }, { classified });
+
+    TaskHandle scanned = system.Submit([&] {
+        std::array<std::uint64_t, 2> sum = { 0, 0 };
+        for (std::array<std::uint64_t, 2> &totals : partTotals) {
+            std::array<std::uint64_t, 2> count = totals;
+            totals = sum;
+            sum[0] += count[0];
+            sum[1] += count[1];
+        }
+
+        // The one allocation of the output. Degenerate triangles are only known once the vertices exist,
+        // so the indices are trimmed afterwards, which never reallocates.
+        mesh.vertices.resize(sum[0]);
+        mesh.normals.resize(sum[0]);
+        mesh.indices.resize(sum[1] * 3);
+    }, { counted });
+
+    TaskHandle offsets = system.ParallelFor(rows, parts, [&](int part, int begin, int end) {
+        for (int row = begin; row < end; row++) {
+            rowVertices[row] += static_cast<std::uint32_t>(partTotals[part][0]);
+            rowTriangles[row] += static_cast<std::uint32_t>(partTotals[part][1]);
+        }
+    }, { scanned });
+    system.Wait(offsets);
+
+    auto writeStart = std::chrono::steady_clock::now();
+
+    // Finding degenerate triangles takes the positions of vertices other parts write
+    TaskHandle vertices = system.ParallelFor(rows, parts, [&](int, int begin, int end) {
+        PROFILE_SCOPE(ProfileZone::Polygonise);
+        WriteVertices(begin, end, mesh);
+    });
+    TaskHandle triangles = system.ParallelFor(rows, parts, [&](int, int begin, int end) {
+        PROFILE_SCOPE(ProfileZone::Polygonise);
+        WriteTriangles(begin, end, mesh);
+    }, { vertices });
+    system.Wait(triangles);
+
+    // Close the gaps left by degenerate triangles. Each row's kept triangles only ever move down.
+    std::size_t written = 0;
+    for (int row = 0; row < rows; row++) {
+        std::size_t start = static_cast<std::size_t>(rowTriangles[row]) * 3;
+        std::size_t count = static_cast<std::size_t>(rowKept[row]) * 3;
+        if (written != start && count > 0) {
+            std::memmove(mesh.indices.data() + written, mesh.indices.data() + start, count * sizeof(std::uint32_t));
+        }
+        written += count;
+    }
+    std::uint64_t degenerate = (mesh.indices.size() - written) / 3;
+    mesh.indices.resize(written);
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        std::uint64_t triangleCount = written / 3 + degenerate;
+        for (const ExtractionStats &part : partStats) {
+            stats->cellsVisited += part.cellsVisited;
+            stats->cellsSkipped += part.cellsSkipped;
+            for (int i = 0; i < 256; i++) {
+                stats->caseHistogram[i] += part.caseHistogram[i];
+            }
+        }
+        stats->classifyMilliseconds += std::chrono::duration<double, std::milli>(writeStart - countStart).count();
+        stats->polygoniseMilliseconds += std::chrono::duration<double, std::milli>(end - writeStart).count();
+        stats->trianglesEmitted += written / 3;
+        stats->degenerateTrianglesRemoved += degenerate;
+        stats->verticesEmitted += mesh.vertices.size();
+        stats->verticesDeduplicated += triangleCount * 3 - mesh.vertices.size();
+        stats->bytesAllocated += rows * (sizeof(std::uint64_t) + sizeof(RowEdges) + 3 * sizeof(std::uint32_t)) +
+                                 (mesh.vertices.capacity() + mesh.normals.capacity()) * sizeof(Vector3) +
+                                 mesh.indices.capacity() * sizeof(std::uint32_t);
+    }
+
+    chunks.clear();
+    return mesh;
+}
+
+void PrefixSumExtractor::ClassifyRows(std::size_t begin, std::size_t end) {
+    const float brickIsoLevel = static_cast<float>(isoLevel);
+    for (std::size_t row = begin; row < end; row++) {
+        const Chunk &chunk = *chunks[row / CHUNK_ROWS].chunk;
+        const int y = static_cast<int>(row % CHUNK_ROWS) % CHUNK_SAMPLES;
+        const int z = static_cast<int>(row % CHUNK_ROWS) / CHUNK_SAMPLES;
+
+        // The bricks along a row hold all of its samples and share their faces, so if none of them
+        // can contain the surface, the whole row is on the side of the first one
+        const int firstBrick = Chunk::BrickIndex(0, std::min(y / BRICK_SIZE, BRICKS_PER_CHUNK - 1), std::min(z / BRICK_SIZE, BRICKS_PER_CHUNK - 1));
+        bool straddles = false;
+        for (int bx = 0; bx < BRICKS_PER_CHUNK && !straddles; bx++) {
+            straddles = chunk.BrickStraddles(firstBrick + bx, brickIsoLevel);
+        }
+
+        std::uint64_t bits = 0;
+        if (straddles) {
+            const float *samples = chunk.densities.data() + (row % CHUNK_ROWS) * CHUNK_SAMPLES;
+            for (int x = 0; x < CHUNK_SAMPLES; x++) {
+                bits |= static_cast<std::uint64_t>(samples[x] < insideBelow) << x;
+            }
+        } else if (chunk.brickMax[firstBrick] < brickIsoLevel) {
+            bits = SAMPLE_MASK;
+        }
+        rowInside[row] = bits;
+    }
+}
+
+void PrefixSumExtractor::CountRows(std::size_t begin, std::size_t end, ExtractionStats *stats) {
+    const float brickIsoLevel = static_cast<float>(isoLevel);
+    for (std::size_t row = begin; row < end; row++) {
+        const int y = static_cast<int>(row % CHUNK_ROWS) % CHUNK_SAMPLES;
+        const int z = static_cast<int>(row % CHUNK_ROWS) / CHUNK_SAMPLES;
+
+        // Every edge crossing the surface inside a chunk belongs to one of its cells, and every cell
+        // emits a vertex on each of its crossing edges, so the crossings are exactly the vertices
+        const std::uint64_t inside = rowInside[row];
+        const std::uint64_t above = y < CHUNK_SIZE ? rowInside[row + 1] : inside;
+        const std::uint64_t behind = z < CHUNK_SIZE ? rowInside[row + CHUNK_SAMPLES] : inside;
+        RowEdges &edges = rowEdges[row];
+        edges.x = (inside ^ inside >> 1) & CELL_MASK;
+        edges.y = inside ^ above;
+        edges.z = inside ^ behind;
+        rowVertices[row] = static_cast<std::uint32_t>(std::popcount(edges.x) + std::popcount(edges.y) + std::popcount(edges.z));
+
+        rowTriangles[row] = 0;
+        if (y == CHUNK_SIZE || z == CHUNK_SIZE) {
+            continue;
+        }
+
+        const std::uint64_t aboveBehind = rowInside[row + 1 + CHUNK_SAMPLES];
+
+        // The whole row of cells lies on one side of the surface
+        const bool uniform = (inside | above | behind | aboveBehind) == 0 || (inside & above & behind & aboveBehind) == SAMPLE_MASK;
+        if (uniform && stats == nullptr) {
+            continue;
+        }
+
+        // Cells are taken a brick wide run at a time, and runs in bricks that cannot contain the surface are
+        // skipped, so the stats count the same cells as ClassifyChunk. Skipped runs never hold triangles.
+        const Chunk &chunk = *chunks[row / CHUNK_ROWS].chunk;
+        std::uint32_t triangles = 0;
+        for (int bx = 0; bx < BRICKS_PER_CHUNK; bx++) {
+            if (!chunk.BrickStraddles(Chunk::BrickIndex(bx, y / BRICK_SIZE, z / BRICK_SIZE), brickIsoLevel)) {
+                if (stats != nullptr) {
+                    stats->cellsSkipped += BRICK_SIZE;
+                }
+                continue;
+            }
+
+            if (stats != nullptr) {
+                stats->cellsVisited += BRICK_SIZE;
+            }
+
+            for (int x = bx * BRICK_SIZE; x < (bx + 1) * BRICK_SIZE; x++) {
+                // Corner bits in cornerOffsets order, as in ClassifyChunk
+                int cubeIndex = static_cast<int>(
+                    (inside >> x & 1) | (inside >> (x + 1) & 1) << 1 |
+                    (behind >> (x + 1) & 1) << 2 | (behind >> x & 1) << 3 |
+                    (above >> x & 1) << 4 | (above >> (x + 1) & 1) << 5 |
+                    (aboveBehind >> (x + 1) & 1) << 6 | (aboveBehind >> x & 1) << 7);
+
+                if (stats != nullptr) {
+                    stats->caseHistogram[cubeIndex]++;
+                }
+
+                triangles += caseTriangles[cubeIndex];
+            }
+        }
+        rowTriangles[row] = triangles;
+    }
+}
+
+void PrefixSumExtractor::RowVertexIndices(std::size_t row, std::uint32_t (&indices)[3][CHUNK_SAMPLES]) const {
+    // Vertices are numbered like ExtractChunk's canonical order: by sample, then by axis
+    const RowEdges &edges = rowEdges[row];
+    const std::uint64_t axisEdges[3] = { edges.x, edges.y, edges.z };
+    std::uint64_t crossings = edges.x | edges.y | edges.z;
+    std::uint32_t vertex = rowVertices[row];
+    while (crossings != 0) {
+        int x = std::countr_zero(crossings);
+        crossings &= crossings - 1;
+        for (int axis = 0; axis < 3; axis++) {
+            if (axisEdges[axis] >> x & 1) {
+                indices[axis][x] = vertex++;
+            }
+        }
+    }
+}
+
+void PrefixSumExtractor::WriteVertices(std::size_t begin, std::size_t end, IndexedMesh &mesh) const {
+    for (std::size_t row = begin; row < end; row++) {
+        const RowEdges &edges = rowEdges[row];
+        std::uint64_t crossings = edges.x | edges.y | edges.z;
+        if (crossings == 0) {
+            continue;
+        }
+
+        const QueuedChunk &queued = chunks[row / CHUNK_ROWS];
+        const Chunk &chunk = *queued.chunk;
+        const Vector3 origin = queued.origin;
+        const int y = static_cast<int>(row % CHUNK_ROWS) % CHUNK_SAMPLES;
+        const int z = static_cast<int>(row % CHUNK_ROWS) / CHUNK_SAMPLES;
+
+        std::uint32_t vertex = rowVertices[row];
+        const std::uint64_t axisEdges[3] = { edges.x, edges.y, edges.z };
+        while (crossings != 0) {
+            int x = std::countr_zero(crossings);
+            crossings &= crossings - 1;
+
+            for (int axis = 0; axis < 3; axis++) {
+                if ((axisEdges[axis] >> x & 1) == 0) {
+                    continue;
+                }
+
+                int ex = x + (axis == 0), ey = y + (axis == 1), ez = z + (axis == 2);
+                Vector3 p1 = { origin.x + x * voxelSize, origin.y + y * voxelSize, origin.z + z * voxelSize };
+                Vector3 p2 = { origin.x + ex * voxelSize, origin.y + ey * voxelSize, origin.z + ez * voxelSize };
+                SurfaceVertex surfaceVertex = InterpolateEdgeVertex(isoLevel, p1, p2, chunk.At(x, y, z), chunk.At(ex, ey, ez),
+                                                                    ChunkSampleGradient(chunk, x, y, z),
+                                                                    ChunkSampleGradient(chunk, ex, ey, ez), axis, voxelSize);
+                mesh.vertices[vertex] = surfaceVertex.position;
+                mesh.normals[vertex] = surfaceVertex.normal;
+                vertex++;
+            }
+        }
+    }
+}
+
+void PrefixSumExtractor::WriteTriangles(std::size_t begin, std::size_t end, IndexedMesh &mesh) {
+    auto position = [&](std::uint32_t vertex) { return mesh.vertices[vertex]; };
+
+    for (std::size_t row = begin; row < end; row++) {
+        rowKept[row] = 0;
+        const int y = static_cast<int>(row % CHUNK_ROWS) % CHUNK_SAMPLES;
+        const int z = static_cast<int>(row % CHUNK_ROWS) / CHUNK_SAMPLES;
+        if (y == CHUNK_SIZE || z == CHUNK_SIZE) {
+            continue;
+        }
+
+        const std::uint64_t inside = rowInside[row];
+        const std::uint64_t above = rowInside[row + 1];
+        const std::uint64_t behind = rowInside[row + CHUNK_SAMPLES];
+        const std::uint64_t aboveBehind = rowInside[row + 1 + CHUNK_SAMPLES];
+        if ((inside | above | behind | aboveBehind) == 0 || (inside & above & behind & aboveBehind) == SAMPLE_MASK) {
+            continue;
+        }
+
+        // Vertices on the edges of the four sample rows around the cells: this one, y + 1, z + 1 and both
+        std::uint32_t vertices[4][3][CHUNK_SAMPLES];
+        RowVertexIndices(row, vertices[0]);
+        RowVertexIndices(row + 1, vertices[1]);
+        RowVertexIndices(row + CHUNK_SAMPLES, vertices[2]);
+        RowVertexIndices(row + 1 + CHUNK_SAMPLES, vertices[3]);
+
+        std::uint32_t *out = mesh.indices.data() + static_cast<std::size_t>(rowTriangles[row]) * 3;
+        std::uint32_t kept = 0;
+
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            int cubeIndex = static_cast<int>(
+                (inside >> x & 1) | (inside >> (x + 1) & 1) << 1 |
+                (behind >> (x + 1) & 1) << 2 | (behind >> x & 1) << 3 |
+                (above >> x & 1) << 4 | (above >> (x + 1) & 1) << 5 |
+                (aboveBehind >> (x + 1) & 1) << 6 | (aboveBehind >> x & 1) << 7);
+
+            // Vertices are indexed by the row and axis of the edge's lower sample, see RowVertexIndices
+            auto vertexOf = [&](int edge) {
+                const CellEdge &cellEdge = cellEdges[edge];
+                const int *start = MarchingCubesTables::cornerOffsets[cellEdge.start];
+                return vertices[start[1] + start[2] * 2][cellEdge.axis][x + start[0]];
+            };
+            auto emit = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+                out[kept * 3 + 0] = a;
+                out[kept * 3 + 1] = b;
+                out[kept * 3 + 2] = c;
+                kept++;
+            };
+            PolygoniseCell(cubeIndex, vertexOf, position, emit);
+        }
+        rowKept[row] = kept;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef PREFIXSUMEXTRACTOR_H
+#define PREFIXSUMEXTRACTOR_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+#include "TaskSystem.h"
+
+// Data-parallel marching cubes over a batch of chunks, producing one contiguous mesh with no merge step.
+//
+// The work is split by rows of samples into a part per thread of a TaskSystem, and each part goes through two passes:
+// - Count: the inside bits of each row give the edges crossing the surface, which are the vertices the
+//   row owns, and the cube indices of the cells above it, whose triangle counts come from the case tables.
+// - An exclusive scan over the counts gives every row the first vertex and triangle it writes.
+// - Write: each row interpolates its vertices, and emits its cells' triangles into its own range of the
+//   exactly sized output. The index of a vertex on another row is that row's offset plus the vertex's
+//   rank among the row's crossings, so no part ever waits for or locks against another.
+// Triangles that turn out degenerate are dropped after the write, closing the gaps they leave in order.
+//
+// The mesh of each chunk is exactly what ExtractChunk gives for it, with its indices offset by the
+// vertices of the chunks before it, whatever the number of threads.
+class PrefixSumExtractor {
+public:
+    PrefixSumExtractor(float voxelSize, double isoLevel);
+
+    // Queue a chunk, with its first sample placed at origin. It is meshed after the chunks queued before it,
+    // and must stay alive and unchanged until Extract returns.
+    void AddChunk(const Chunk &chunk, Vector3 origin);
+
+    int GetChunkCount() const { return static_cast<int>(chunks.size()); }
+
+    // Extract all queued chunks on the workers of tasks and the calling thread, or only the calling thread
+    // if tasks is null, then clear the queue. The mesh must stay below 2^32 vertices.
+    IndexedMesh Extract(TaskSystem *tasks = nullptr, ExtractionStats *stats = nullptr);
+
+private:
+    static constexpr int CHUNK_ROWS = CHUNK_SAMPLES * CHUNK_SAMPLES;
+
+    struct QueuedChunk {
+        const Chunk *chunk;
+        Vector3 origin;
+    };
+
+    // Edges crossing the surface from the samples of a row in the positive x, y and z direction, bit x for sample x
+    struct RowEdges {
+        std::uint64_t x;
+        std::uint64_t y;
+        std::uint64_t z;
+    };
+
+    void ClassifyRows(std::size_t begin, std::size_t end);
+    void CountRows(std::size_t begin, std::size_t end, ExtractionStats *stats);
+    void WriteVertices(std::size_t begin, std::size_t end, IndexedMesh &mesh) const;
+    void WriteTriangles(std::size_t begin, std::size_t end, IndexedMesh &mesh);
+
+    // Index of the vertex on each crossing edge of a row, by axis and the sample the edge starts from
+    void RowVertexIndices(std::size_t row, std::uint32_t (&indices)[3][CHUNK_SAMPLES]) const;
+
+    float voxelSize;
+    double isoLevel;
+    float insideBelow;
+
+    // Triangles of each marching cubes case
+    std::array<std::uint8_t, 256> caseTriangles;
+
+    std::vector<QueuedChunk> chunks;
+
+    // Per row of every chunk, row = chunk * CHUNK_ROWS + y + z * CHUNK_SAMPLES
+    std::vector<std::uint64_t> rowInside;
+    std::vector<RowEdges> rowEdges;
+
+    // Counts, then offsets after the scan. The triangles of a row are those of the cells from it to y + 1 and z + 1.
+    std::vector<std::uint32_t> rowVertices;
+    std::vector<std::uint32_t> rowTriangles;
+
+    // Triangles a row kept after dropping degenerate ones
+    std::vector<std::uint32_t> rowKept;
+
+    // Vertex and triangle totals of each part's rows, scanned into the offset of its first row
+    std::vector<std::array<std::uint64_t, 2>> partTotals;
+};
+
+#endif // PREFIXSUMEXTRACTOR_H
@@ -0,0 +1,178 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <raylib.h>
+
+namespace {
+    // Small, stable id for the calling thread, used as the trace event tid
+    std::uint32_t CurrentThreadId() {
+        static std::atomic<std::uint32_t> nextId { 0 };
+        thread_local std::uint32_t id = nextId.fetch_add(1);
+        return id;
+    }
+
+    float NanosecondsToMilliseconds(std::uint64_t ns) {
+        return static_cast<float>(ns) / 1000000.0f;
+    }
+}
+
+Profiler &Profiler::Get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : enabled(false), history {}, historyHead(0), historyCount(0), lastFrameEnd(0), traceHead(0) {
+    for (std::atomic<std::uint64_t> &total : frameTotals) {
+        total.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::SetEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::Record(ProfileZone zone, std::uint64_t startNs, std::uint64_t endNs) {
+    frameTotals[static_cast<int>(zone)].fetch_add(endNs - startNs, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    TraceEvent event { zone, CurrentThreadId(), startNs, endNs };
+    if (traceEvents.size() < MAX_TRACE_EVENTS) {
+        traceEvents.push_back(event);
+    } else {
+        // Full, overwrite the oldest event
+        traceEvents[traceHead] = event;
+        traceHead = (traceHead + 1) % MAX_TRACE_EVENTS;
+    }
+}
+
+void Profiler::EndFrame() {
+    std::uint64_t now = Now();
+
+    if (IsEnabled()) {
+        for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+            history[zone][historyHead] = NanosecondsToMilliseconds(frameTotals[zone].exchange(0, std::memory_order_relaxed));
+        }
+        history[PROFILE_ZONE_COUNT][historyHead] = lastFrameEnd != 0 ? NanosecondsToMilliseconds(now - lastFrameEnd) : 0.0f;
+
+        historyHead = (historyHead + 1) % HISTORY_FRAMES;
+        historyCount = std::min(historyCount + 1, HISTORY_FRAMES);
+    }
+
+    lastFrameEnd = now;
+}
+
+ProfileStats Profiler::GetZoneStats(ProfileZone zone) const {
+    return ComputeStats(history[static_cast<int>(zone)], historyCount);
+}
+
+ProfileStats Profiler::GetFrameStats() const {
+    return ComputeStats(history[PROFILE_ZONE_COUNT], historyCount);
+}
+
+ProfileStats Profiler::ComputeStats(const std::array<float, HISTORY_FRAMES> &samples, int count) {
+    ProfileStats stats {};
+    if (count == 0) {
+        return stats;
+    }
+
+    // The ring buffer is filled from the start, so the first count entries are all valid
+    std::array<float, HISTORY_FRAMES> sorted = samples;
+    std::sort(sorted.begin(), sorted.begin() + count);
+
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        sum += sorted[i];
+    }
+
+    auto percentile = [&](float p) {
+        int index = std::min(count - 1, static_cast<int>(p * count));
+        return sorted[index];
+    };
+
+    stats.average = sum / count;
+    stats.p50 = percentile(0.50f);
+    stats.p95 = percentile(0.95f);
+    stats.p99 = percentile(0.99f);
+    stats.max = sorted[count - 1];
+    return stats;
+}
+
+bool Profiler::ExportChromeTrace(const std::string &path) const {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+
+    // Timestamps are written relative to the oldest event
+    std::uint64_t origin = 0;
+    for (const TraceEvent &event : traceEvents) {
+        if (origin == 0 || event.startNs < origin) {
+            origin = event.startNs;
+        }
+    }
+
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    for (std::size_t i = 0; i < traceEvents.size(); i++) {
+        // Start at the oldest event, so events are written in the order they were recorded
+        const TraceEvent &event = traceEvents[(traceHead + i) % traceEvents.size()];
+        std::fprintf(file,
+            "{\"name\":\"%s\",\"cat\":\"stillness\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}%s\n",
+            GetZoneName(event.zone),
+            (event.startNs - origin) / 1000.0,
+            (event.endNs - event.startNs) / 1000.0,
+            event.threadId,
+            i + 1 < traceEvents.size() ? "," : "");
+    }
+    std::fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    return std::fclose(file) == 0;
+}
+
+void Profiler::DrawOverlay(int posX, int posY) const {
+    const int fontSize = 20;
+    const int lineHeight = 24;
+    const int width = 620;
+    const int height = (PROFILE_ZONE_COUNT + 3) * lineHeight + 10;
+
+    DrawRectangle(posX, posY, width, height, Fade(BLACK, 0.7f));
+
+    int y = posY + 5;
+    DrawText(TextFormat("%-14s %8s %8s %8s %8s", "ms/frame", "avg", "p50", "p95", "p99"), posX + 10, y, fontSize, LIGHTGRAY);
+    y += lineHeight;
+
+    ProfileStats frame = GetFrameStats();
+    DrawText(TextFormat("%-14s %8.2f %8.2f %8.2f %8.2f", "Frame", frame.average, frame.p50, frame.p95, frame.p99), posX + 10, y, fontSize, YELLOW);
+    y += lineHeight;
+
+    for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++) {
+        ProfileStats stats = GetZoneStats(static_cast<ProfileZone>(zone));
+        DrawText(TextFormat("%-14s %8.3f %8.3f %8.3f %8.3f", GetZoneName(static_cast<ProfileZone>(zone)), stats.average, stats.p50, stats.p95, stats.p99),
+                 posX + 10, y, fontSize, WHITE);
+        y += lineHeight;
+    }
+
+    DrawText(TextFormat("Last %d frames. F2 exports a trace.", historyCount), posX + 10, y, fontSize, GRAY);
+}
+
+std::uint64_t Profiler::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *Profiler::GetZoneName(ProfileZone zone) {
+    switch (zone) {
+        case ProfileZone::DensityFill: return "DensityFill";
+        case ProfileZone::Classify: return "Classify";
+        case ProfileZone::Polygonise: return "Polygonise";
+        case ProfileZone::MeshAssembly: return "MeshAssembly";
+        case ProfileZone::Upload: return "Upload";
+        case ProfileZone::Culling: return "Culling";
+        case ProfileZone::Draw: return "Draw";
+        default: return "Unknown";
+    }
+}
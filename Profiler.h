@@ -0,0 +1,125 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hot paths that can be timed with PROFILE_SCOPE
+enum class ProfileZone {
+    DensityFill,
+    Classify,
+    Polygonise,
+    MeshAssembly,
+    Upload,
+    Culling,
+    Draw,
+    Count
+};
+
+constexpr int PROFILE_ZONE_COUNT = static_cast<int>(ProfileZone::Count);
+
+// Summary of a zone's time per frame over the recorded history, in milliseconds
+struct ProfileStats {
+    float average;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+};
+
+// Collects scoped timings, sums them per frame and keeps a ring buffer of recent frames.
+// While enabled, every timing is also kept as a trace event that can be exported
+// in the Chrome trace-event format (chrome://tracing, Perfetto).
+// When disabled, a scope costs a single relaxed atomic load.
+class Profiler {
+public:
+    static constexpr int HISTORY_FRAMES = 240;
+    static constexpr int MAX_TRACE_EVENTS = 1 << 16;
+
+    static Profiler &Get();
+
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enable);
+
+    // Add a timing to the current frame. Safe to call from any thread.
+    void Record(ProfileZone zone, std::uint64_t startNs, std::uint64_t endNs);
+
+    // Close the current frame and push its totals into the history.
+    // Call once per frame from the main thread.
+    void EndFrame();
+
+    ProfileStats GetZoneStats(ProfileZone zone) const;
+    ProfileStats GetFrameStats() const;
+
+    // Write the recorded trace events as Chrome trace-event JSON. Returns false if the file could not be written.
+    bool ExportChromeTrace(const std::string &path) const;
+
+    // Draw the frame time and per zone percentiles as a 2D overlay. Call between BeginDrawing and EndDrawing.
+    void DrawOverlay(int posX, int posY) const;
+
+    static std::uint64_t Now();
+    static const char *GetZoneName(ProfileZone zone);
+
+private:
+    struct TraceEvent {
+        ProfileZone zone;
+        std::uint32_t threadId;
+        std::uint64_t startNs;
+        std::uint64_t endNs;
+    };
+
+    Profiler();
+
+    static ProfileStats ComputeStats(const std::array<float, HISTORY_FRAMES> &samples, int count);
+
+    std::atomic<bool> enabled;
+
+    // Nanoseconds spent in each zone during the current frame
+    std::array<std::atomic<std::uint64_t>, PROFILE_ZONE_COUNT> frameTotals;
+
+    // Milliseconds per frame, for every zone followed by the whole frame
+    std::array<std::array<float, HISTORY_FRAMES>, PROFILE_ZONE_COUNT + 1> history;
+    int historyHead;
+    int historyCount;
+    std::uint64_t lastFrameEnd;
+
+    // Ring buffer of trace events
+    mutable std::mutex traceMutex;
+    std::vector<TraceEvent> traceEvents;
+    std::size_t traceHead;
+};
+
+// Times the enclosing scope into a profiler zone
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileZone zone) : zone(zone), startNs(Profiler::Get().IsEnabled() ? Profiler::Now() : 0) {}
+
+    ~ProfileScope() {
+        if (startNs != 0) {
+            Profiler::Get().Record(zone, startNs, Profiler::Now());
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    ProfileZone zone;
+    std::uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Profiling scopes are compiled out entirely unless STILLNESS_PROFILER is defined
+#ifdef STILLNESS_PROFILER
+#define PROFILE_SCOPE(zone) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(zone)
+#else
+#define PROFILE_SCOPE(zone) do {} while (false)
+#endif
+
+#endif // PROFILER_H
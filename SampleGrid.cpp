@@ -0,0 +1,186 @@
+#include "SampleGrid.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "MarchingCubes.h"
+#include "MarchingCubesCell.h"
+#include "Profiler.h"
+
+using MarchingCubesTables::cornerOffsets;
+using MarchingCubesTables::edgeTable;
+
+template <typename Layout>
+SampleGrid<Layout> DownsampleGrid(const SampleGrid<Layout> &grid, GridReduce reduce) {
+    const Layout &layout = grid.GetLayout();
+    const int width = grid.GetWidth();
+    const int height = grid.GetHeight();
+    const int depth = grid.GetDepth();
+
+    SampleGrid<Layout> coarse((width + 1) / 2, (height + 1) / 2, (depth + 1) / 2);
+    const Layout &coarseLayout = coarse.GetLayout();
+
+    auto combine = [reduce](float a, float b) {
+        return reduce == GridReduce::Min ? std::min(a, b) : (reduce == GridReduce::Max ? std::max(a, b) : a + b);
+    };
+
+    for (int z = 0; z < coarse.GetDepth(); z++) {
+        for (int y = 0; y < coarse.GetHeight(); y++) {
+            // The four fine rows under the coarse row. Along an odd side the last sample stands in for its missing neighbour.
+            int fy = 2 * y, fz = 2 * z;
+            std::size_t rows[4];
+            rows[0] = layout.Index(0, fy, fz);
+            rows[1] = fy + 1 < height ? layout.template Next<1>(rows[0], fy) : rows[0];
+            rows[2] = fz + 1 < depth ? layout.template Next<2>(rows[0], fz) : rows[0];
+            rows[3] = fy + 1 < height ? layout.template Next<1>(rows[2], fy) : rows[2];
+
+            std::size_t out = coarseLayout.Index(0, y, z);
+            for (int x = 0; x < coarse.GetWidth(); x++) {
+                int fx = 2 * x;
+                float value = grid.AtIndex(rows[0]);
+                for (int row = 0; row < 4; row++) {
+                    std::size_t next = fx + 1 < width ? layout.template Next<0>(rows[row], fx) : rows[row];
+                    value = row == 0 ? value : combine(value, grid.AtIndex(rows[row]));
+                    value = combine(value, grid.AtIndex(next));
+
+                    // Step on to the first sample of the next pair
+                    rows[row] = fx + 2 < width ? layout.template Next<0>(next, fx + 1) : next;
+                }
+
+                coarse.AtIndex(out) = reduce == GridReduce::Average ? value * 0.125f : value;
+                if (x + 1 < coarse.GetWidth()) {
+                    out = coarseLayout.template Next<0>(out, x);
+                }
+            }
+        }
+    }
+
+    return coarse;
+}
+
+template <typename Layout>
+IndexedMesh MarchingCubes::ExtractGrid(const SampleGrid<Layout> &grid, Vector3 origin, float spacing, double isoLevel,
+                                       ExtractionStats *stats) const {
+    PROFILE_SCOPE(ProfileZone::Polygonise);
+    auto start = std::chrono::steady_clock::now();
+
+    const Layout &layout = grid.GetLayout();
+    const int width = grid.GetWidth();
+    const int height = grid.GetHeight();
+    const int depth = grid.GetDepth();
+
+    IndexedMesh mesh;
+    if (width < 2 || height < 2 || depth < 2) {
+        return mesh;
+    }
+
+    LayerEdgeVertices edgeVertices(width, height);
+    std::uint64_t deduplicated = 0;
+    std::uint64_t degenerate = 0;
+
+    // Find or create the vertex where the surface crosses an edge of the cell at (x, y, z)
+    auto edgeVertex = [&](int x, int y, int z, int edge, const float *densities) {
+        const CellEdge &cellEdge = cellEdges[edge];
+        const int *s = cornerOffsets[cellEdge.start];
+        const int *e = cornerOffsets[cellEdge.end];
+        int sx = x + s[0], sy = y + s[1], sz = z + s[2];
+        int ex = x + e[0], ey = y + e[1], ez = z + e[2];
+
+        std::uint32_t &slot = edgeVertices.At(sx, sy, s[2] == 1, cellEdge.axis);
+        if (slot != LayerEdgeVertices::NONE) {
+            deduplicated++;
+            return slot;
+        }
+
+        Vector3 p1 = { origin.x + sx * spacing, origin.y + sy * spacing, origin.z + sz * spacing };
+        Vector3 p2 = { origin.x + ex * spacing, origin.y + ey * spacing, origin.z + ez * spacing };
+        SurfaceVertex vertex = InterpolateEdgeVertex(isoLevel, p1, p2, densities[cellEdge.start], densities[cellEdge.end],
+                                                     GridGradient(grid, sx, sy, sz), GridGradient(grid, ex, ey, ez),
+                                                     cellEdge.axis, spacing);
+
+        slot = static_cast<std::uint32_t>(mesh.vertices.size());
+        mesh.vertices.push_back(vertex.position);
+        mesh.normals.push_back(vertex.normal);
+        return slot;
+    };
+
+    auto position = [&](std::uint32_t vertex) { return mesh.vertices[vertex]; };
+    auto emit = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+        mesh.indices.push_back(a);
+        mesh.indices.push_back(b);
+        mesh.indices.push_back(c);
+    };
+
+    for (int z = 0; z + 1 < depth; z++) {
+        // The upper plane of the last layer is the lower plane of this one
+        edgeVertices.NextLayer();
+
+        for (int y = 0; y + 1 < height; y++) {
+            // Indices of the four samples on the left of the cell, stepped along x with the cell.
+            // Densities are in cornerOffsets order, the left corners are 0, 4, 3 and 7.
+            std::size_t left[4];
+            left[0] = layout.Index(0, y, z);
+            left[1] = layout.template Next<1>(left[0], y);
+            left[2] = layout.template Next<2>(left[0], z);
+            left[3] = layout.template Next<1>(left[2], y);
+
+            float densities[8];
+            densities[0] = grid.AtIndex(left[0]);
+            densities[4] = grid.AtIndex(left[1]);
+            densities[3] = grid.AtIndex(left[2]);
+            densities[7] = grid.AtIndex(left[3]);
+
+            for (int x = 0; x + 1 < width; x++) {
+                std::size_t right[4];
+                for (int i = 0; i < 4; i++) {
+                    right[i] = layout.template Next<0>(left[i], x);
+                }
+                densities[1] = grid.AtIndex(right[0]);
+                densities[5] = grid.AtIndex(right[1]);
+                densities[2] = grid.AtIndex(right[2]);
+                densities[6] = grid.AtIndex(right[3]);
+
+                int cubeIndex = 0;
+                for (int i = 0; i < 8; i++) {
+                    cubeIndex |= (densities[i] < isoLevel) << i;
+                }
+                if (stats != nullptr) {
+                    stats->caseHistogram[cubeIndex]++;
+                }
+
+                if (edgeTable[cubeIndex] != 0) {
+                    auto vertexOf = [&](int edge) { return edgeVertex(x, y, z, edge, densities); };
+                    degenerate += PolygoniseCell(cubeIndex, vertexOf, position, emit);
+                }
+
+                // The right corners become the left corners of the next cell
+                std::copy(right, right + 4, left);
+                densities[0] = densities[1];
+                densities[4] = densities[5];
+                densities[3] = densities[2];
+                densities[7] = densities[6];
+            }
+        }
+    }
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->cellsVisited += static_cast<std::uint64_t>(width - 1) * (height - 1) * (depth - 1);
+        stats->AddPolygonised(std::chrono::duration<double, std::milli>(end - start).count(), mesh.indices.size() / 3,
+                              mesh.vertices.size(), deduplicated, degenerate);
+        stats->bytesAllocated += edgeVertices.GetBytes() +
+                                 mesh.vertices.capacity() * sizeof(Vector3) * 2 + mesh.indices.capacity() * sizeof(std::uint32_t);
+    }
+
+    return mesh;
+}
+
+template SampleGrid<LinearLayout> DownsampleGrid(const SampleGrid<LinearLayout> &, GridReduce);
+template SampleGrid<TiledLayout> DownsampleGrid(const SampleGrid<TiledLayout> &, GridReduce);
+template SampleGrid<MortonLayout> DownsampleGrid(const SampleGrid<MortonLayout> &, GridReduce);
+
+template IndexedMesh MarchingCubes::ExtractGrid(const SampleGrid<LinearLayout> &, Vector3, float, double, ExtractionStats *) const;
+template IndexedMesh MarchingCubes::ExtractGrid(const SampleGrid<TiledLayout> &, Vector3, float, double, ExtractionStats *) const;
+template IndexedMesh MarchingCubes::ExtractGrid(const SampleGrid<MortonLayout> &, Vector3, float, double, ExtractionStats *) const;
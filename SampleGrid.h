@@ -0,0 +1,99 @@
+#ifndef SAMPLEGRID_H
+#define SAMPLEGRID_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <raylib.h>
+
+#include "SampleLayout.h"
+
+// A dense grid of density samples of any size, stored in one of the layouts of SampleLayout.h.
+// The kernels below and MarchingCubes::ExtractGrid work on every layout and give identical results,
+// only the memory access pattern changes.
+template <typename Layout>
+class SampleGrid {
+public:
+    SampleGrid(int width, int height, int depth)
+        : width(width), height(height), depth(depth), layout(width, height, depth), samples(layout.StorageSize()) {}
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetDepth() const { return depth; }
+    const Layout &GetLayout() const { return layout; }
+
+    float At(int x, int y, int z) const { return samples[layout.Index(x, y, z)]; }
+    float &At(int x, int y, int z) { return samples[layout.Index(x, y, z)]; }
+
+    // Sample at an index from the layout
+    float AtIndex(std::size_t index) const { return samples[index]; }
+    float &AtIndex(std::size_t index) { return samples[index]; }
+
+    // The storage, StorageSize samples in layout order
+    const float *GetData() const { return samples.data(); }
+    float *GetData() { return samples.data(); }
+
+    // Copy in width * height * depth samples in x-major order
+    void Assign(const float *linear) {
+        for (int z = 0; z < depth; z++) {
+            for (int y = 0; y < height; y++) {
+                std::size_t index = layout.Index(0, y, z);
+                for (int x = 0; x < width; x++) {
+                    samples[index] = *linear++;
+                    if (x + 1 < width) {
+                        index = layout.template Next<0>(index, x);
+                    }
+                }
+            }
+        }
+    }
+
+    std::size_t GetMemoryBytes() const { return samples.size() * sizeof(float); }
+
+private:
+    int width;
+    int height;
+    int depth;
+    Layout layout;
+    std::vector<float> samples;
+};
+
+// Density gradient at a sample in samples, central differences inside the grid and one-sided on its faces.
+// Along an axis only one sample long there is no difference to take, and the gradient is 0 along it.
+// The gradient points away from the inside of the surface.
+template <typename Layout>
+Vector3 GridGradient(const SampleGrid<Layout> &grid, int x, int y, int z) {
+    const Layout &layout = grid.GetLayout();
+    const std::size_t index = layout.Index(x, y, z);
+    const int coords[3] = { x, y, z };
+    const int sizes[3] = { grid.GetWidth(), grid.GetHeight(), grid.GetDepth() };
+
+    auto axis = [&](auto axisConstant) {
+        constexpr int Axis = decltype(axisConstant)::value;
+        int coord = coords[Axis];
+        bool hasPrevious = coord > 0;
+        bool hasNext = coord + 1 < sizes[Axis];
+        float previous = grid.AtIndex(hasPrevious ? layout.template Previous<Axis>(index, coord) : index);
+        float next = grid.AtIndex(hasNext ? layout.template Next<Axis>(index, coord) : index);
+        int steps = hasPrevious + hasNext;
+        return steps > 0 ? (next - previous) / static_cast<float>(steps) : 0.0f;
+    };
+
+    return { axis(std::integral_constant<int, 0>()), axis(std::integral_constant<int, 1>()), axis(std::integral_constant<int, 2>()) };
+}
+
+// How DownsampleGrid combines the 2x2x2 samples it reduces to one
+enum class GridReduce {
+    Average,
+    Min,
+    Max
+};
+
+// Halve a grid: coarse sample (x, y, z) combines fine samples 2x..2x+1, 2y..2y+1 and 2z..2z+1,
+// repeating the last sample along any odd side. Min and max bound the fine samples conservatively.
+template <typename Layout>
+SampleGrid<Layout> DownsampleGrid(const SampleGrid<Layout> &grid, GridReduce reduce);
+
+#endif // SAMPLEGRID_H
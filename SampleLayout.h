@@ -0,0 +1,150 @@
+#ifndef SAMPLELAYOUT_H
+#define SAMPLELAYOUT_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+// Orders in which the samples of a 3D grid can be stored.
+// Every layout maps sample (x, y, z) to Index(x, y, z) in the grid's storage, and steps an index to the
+// neighbouring sample along an axis with Next<Axis> and Previous<Axis>, given the sample's coordinate on
+// that axis, which is far cheaper than computing the neighbour's index from scratch.
+//
+// LinearLayout is x-major: rows along x are contiguous, but the y and z neighbours of a sample are a row
+// and a slice apart, which on large grids are different pages. TiledLayout stores 4^3 tiles of samples
+// contiguously, and MortonLayout orders all samples along a Z-order curve, so a sample's 2x2x2
+// neighbourhood usually shares a cache line or two in either.
+
+// Spread the low 10 bits of v out to every third bit
+constexpr std::uint32_t MortonSpread(std::uint32_t v) {
+    v &= 0x3ff;
+    v = (v | v << 16) & 0x030000ff;
+    v = (v | v << 8) & 0x0300f00f;
+    v = (v | v << 4) & 0x030c30c3;
+    v = (v | v << 2) & 0x09249249;
+    return v;
+}
+
+// Gather every third bit of v back into the low 10 bits
+constexpr std::uint32_t MortonCompact(std::uint32_t v) {
+    v &= 0x09249249;
+    v = (v ^ (v >> 2)) & 0x030c30c3;
+    v = (v ^ (v >> 4)) & 0x0300f00f;
+    v = (v ^ (v >> 8)) & 0x030000ff;
+    v = (v ^ (v >> 16)) & 0x000003ff;
+    return v;
+}
+
+// Morton code of a sample, coordinates up to 1023
+constexpr std::uint32_t MortonEncode(int x, int y, int z) {
+    return MortonSpread(x) | MortonSpread(y) << 1 | MortonSpread(z) << 2;
+}
+
+constexpr void MortonDecode(std::uint32_t code, int &x, int &y, int &z) {
+    x = static_cast<int>(MortonCompact(code));
+    y = static_cast<int>(MortonCompact(code >> 1));
+    z = static_cast<int>(MortonCompact(code >> 2));
+}
+
+// Bits of a Morton code holding each axis
+constexpr std::uint32_t MORTON_AXIS_MASKS[3] = { 0x09249249, 0x12492492, 0x24924924 };
+
+// Add or subtract 1 along one axis of a Morton code. Filling the other axes' bits with ones makes the
+// carry ripple straight through them, and masking with zeros does the same for the borrow.
+template <int Axis>
+constexpr std::uint32_t MortonNext(std::uint32_t code) {
+    constexpr std::uint32_t mask = MORTON_AXIS_MASKS[Axis];
+    return (((code | ~mask) + 1) & mask) | (code & ~mask);
+}
+
+template <int Axis>
+constexpr std::uint32_t MortonPrevious(std::uint32_t code) {
+    constexpr std::uint32_t mask = MORTON_AXIS_MASKS[Axis];
+    return (((code & mask) - 1) & mask) | (code & ~mask);
+}
+
+struct LinearLayout {
+    static constexpr const char *NAME = "linear";
+
+    LinearLayout(int width, int height, int depth)
+        : strides { 1, static_cast<std::size_t>(width), static_cast<std::size_t>(width) * height },
+          storageSize(static_cast<std::size_t>(width) * height * depth) {}
+
+    std::size_t Index(int x, int y, int z) const { return x + y * strides[1] + z * strides[2]; }
+
+    template <int Axis>
+    std::size_t Next(std::size_t index, int) const { return index + strides[Axis]; }
+
+    template <int Axis>
+    std::size_t Previous(std::size_t index, int) const { return index - strides[Axis]; }
+
+    std::size_t StorageSize() const { return storageSize; }
+
+    std::size_t strides[3];
+    std::size_t storageSize;
+};
+
+// 4^3 tiles, x-major within a tile and from tile to tile. Grids are padded to whole tiles.
+struct TiledLayout {
+    static constexpr const char *NAME = "tiled 4^3";
+    static constexpr int TILE_SIZE = 4;
+
+    TiledLayout(int width, int height, int depth) {
+        std::size_t tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        std::size_t tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        std::size_t tilesZ = (depth + TILE_SIZE - 1) / TILE_SIZE;
+        tileStrides[0] = 64;
+        tileStrides[1] = 64 * tilesX;
+        tileStrides[2] = 64 * tilesX * tilesY;
+        storageSize = 64 * tilesX * tilesY * tilesZ;
+    }
+
+    std::size_t Index(int x, int y, int z) const {
+        return (x >> 2) * tileStrides[0] + (y >> 2) * tileStrides[1] + (z >> 2) * tileStrides[2] + ((x & 3) | (y & 3) << 2 | (z & 3) << 4);
+    }
+
+    // Within a tile the step is 1, 4 or 16. Leaving it moves to the same place in the next tile.
+    template <int Axis>
+    std::size_t Next(std::size_t index, int coord) const {
+        constexpr std::size_t step = std::size_t(1) << (2 * Axis);
+        return (coord & 3) != 3 ? index + step : index + tileStrides[Axis] - 3 * step;
+    }
+
+    template <int Axis>
+    std::size_t Previous(std::size_t index, int coord) const {
+        constexpr std::size_t step = std::size_t(1) << (2 * Axis);
+        return (coord & 3) != 0 ? index - step : index - tileStrides[Axis] + 3 * step;
+    }
+
+    std::size_t StorageSize() const { return storageSize; }
+
+    std::size_t tileStrides[3];
+    std::size_t storageSize;
+};
+
+// Z-order curve over the whole grid. Codes are dense only for power of two sizes: the storage runs up to
+// the code of the last sample, so a 2^n + 1 grid takes up to 8 times its sample count. Sides up to 1024.
+struct MortonLayout {
+    static constexpr const char *NAME = "morton";
+
+    static constexpr int MAX_SIDE = 1024;
+
+    MortonLayout(int width, int height, int depth) : storageSize(std::size_t(MortonEncode(width - 1, height - 1, depth - 1)) + 1) {
+        // MortonEncode keeps 10 bits of each coordinate, larger sides would wrap onto other samples
+        assert(width <= MAX_SIDE && height <= MAX_SIDE && depth <= MAX_SIDE);
+    }
+
+    std::size_t Index(int x, int y, int z) const { return MortonEncode(x, y, z); }
+
+    template <int Axis>
+    std::size_t Next(std::size_t index, int) const { return MortonNext<Axis>(static_cast<std::uint32_t>(index)); }
+
+    template <int Axis>
+    std::size_t Previous(std::size_t index, int) const { return MortonPrevious<Axis>(static_cast<std::uint32_t>(index)); }
+
+    std::size_t StorageSize() const { return storageSize; }
+
+    std::size_t storageSize;
+};
+
+#endif // SAMPLELAYOUT_H
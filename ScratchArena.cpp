@@ -0,0 +1,59 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+ScratchArena &ScratchArena::ForThread() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+void *ScratchArena::Allocate(std::size_t bytes, std::size_t alignment) {
+    while (current < blocks.size()) {
+        Block &block = blocks[current];
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.memory.get());
+        std::size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+        if (start + bytes <= block.size) {
+            usedBytes += start + bytes - offset;
+            peakBytes = std::max(peakBytes, usedBytes);
+            lastOffset = offset;
+            offset = start + bytes;
+            return block.memory.get() + start;
+        }
+
+        // Skip to the next block kept from earlier work. The tail of this one stays unused until a rewind.
+        current++;
+        offset = 0;
+    }
+
+    // Out of blocks, grow the arena
+    std::size_t size = std::max(BLOCK_SIZE, bytes + alignment);
+    blocks.push_back({ std::make_unique_for_overwrite<std::byte[]>(size), size });
+    reservedBytes += size;
+    current = blocks.size() - 1;
+    offset = 0;
+    return Allocate(bytes, alignment);
+}
+
+void ScratchArena::Free(void *pointer, std::size_t bytes) {
+    if (current >= blocks.size() || pointer == nullptr) {
+        return;
+    }
+
+    // Undo the allocation along with the padding that aligned it, exactly what Allocate added.
+    // Only once, as the offset before any earlier allocation is not kept.
+    std::byte *memory = blocks[current].memory.get();
+    std::byte *end = static_cast<std::byte *>(pointer) + bytes;
+    if (end == memory + offset && static_cast<std::byte *>(pointer) >= memory + lastOffset) {
+        usedBytes -= offset - lastOffset;
+        offset = lastOffset;
+    }
+}
+
+void ScratchArena::Rewind(Marker marker) {
+    current = marker.block;
+    offset = marker.offset;
+    lastOffset = marker.offset;
+    usedBytes = marker.usedBytes;
+}
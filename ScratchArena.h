@@ -0,0 +1,111 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator for temporary data that only lives while one piece of work runs,
+// like the scratch buffers of a chunk extraction.
+// Allocating is a pointer increment, and everything allocated after a marker is released at once
+// by rewinding to it. Blocks are kept after a rewind, so a thread that extracts chunk after chunk
+// stops touching the heap once its arena has grown to the size of the largest job.
+// An arena must only be used by one thread, ForThread gives every thread its own.
+class ScratchArena {
+public:
+    // Size of the blocks the arena grows by. Larger requests get a block of their own.
+    static constexpr std::size_t BLOCK_SIZE = 1 << 20;
+
+    struct Marker {
+        std::size_t block;
+        std::size_t offset;
+        std::size_t usedBytes;
+    };
+
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    // The calling thread's arena
+    static ScratchArena &ForThread();
+
+    void *Allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T *AllocateArray(std::size_t count) {
+        return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Give memory back early. Only has an effect on the most recent allocation,
+    // which lets a growing vector reuse the space of its previous buffer.
+    void Free(void *pointer, std::size_t bytes);
+
+    Marker GetMarker() const { return { current, offset, usedBytes }; }
+    void Rewind(Marker marker);
+
+    // Bytes handed out and not yet rewound
+    std::size_t GetUsedBytes() const { return usedBytes; }
+
+    // Largest GetUsedBytes seen so far
+    std::size_t GetPeakBytes() const { return peakBytes; }
+
+    // Bytes held in blocks, used or not
+    std::size_t GetReservedBytes() const { return reservedBytes; }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> memory;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t current = 0;        // Block allocations are made from
+    std::size_t offset = 0;         // First free byte in the current block
+    std::size_t lastOffset = 0;     // Offset before the most recent allocation, which Free rewinds to
+    std::size_t usedBytes = 0;
+    std::size_t peakBytes = 0;
+    std::size_t reservedBytes = 0;
+};
+
+// Rewinds an arena to where it was when the scope was entered
+class ArenaScope {
+public:
+    explicit ArenaScope(ScratchArena &arena) : arena(arena), marker(arena.GetMarker()) {}
+    ~ArenaScope() { arena.Rewind(marker); }
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    ScratchArena &arena;
+    ScratchArena::Marker marker;
+};
+
+// Standard allocator on top of a ScratchArena, so scratch containers keep the std::vector interface.
+// Containers using it must be destroyed before their arena is rewound past them.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(ScratchArena &arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.GetArena()) {}
+
+    T *allocate(std::size_t count) { return arena->AllocateArray<T>(count); }
+    void deallocate(T *pointer, std::size_t count) { arena->Free(pointer, count * sizeof(T)); }
+
+    ScratchArena *GetArena() const { return arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.GetArena(); }
+
+private:
+    ScratchArena *arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // SCRATCHARENA_H
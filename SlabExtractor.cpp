@@ -0,0 +1,183 @@
+#include "SlabExtractor.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+#include "Profiler.h"
+
+SlabExtractor::SlabExtractor(int width, int height, Vector3 origin, Vector3 spacing, double isoLevel)
+    : width(width), height(height), origin(origin), spacing(spacing), isoLevel(isoLevel), edgeVertices(width, height) {
+    std::size_t samples = static_cast<std::size_t>(width) * height;
+    lower.resize(samples);
+    upper.resize(samples);
+    lowerInside.resize(samples);
+    upperInside.resize(samples);
+}
+
+Vector3 SlabExtractor::SampleGradient(bool upperSlab, int x, int y) const {
+    // Central differences within the slab, one-sided on its borders. Only two slabs are kept,
+    // so across them the difference is always the one between the lower and upper slab.
+    const std::vector<float> &slab = upperSlab ? upper : lower;
+    int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, width - 1);
+    int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, height - 1);
+    std::size_t index = static_cast<std::size_t>(y) * width + x;
+
+    return {
+        (slab[y * width + x1] - slab[y * width + x0]) / ((x1 - x0) * spacing.x),
+        (slab[y1 * width + x] - slab[y0 * width + x]) / ((y1 - y0) * spacing.y),
+        (upper[index] - lower[index]) / spacing.z
+    };
+}
+
+void SlabExtractor::AddSlab(const float *densities, IndexedMesh &layer, ExtractionStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+
+    layer.vertices.clear();
+    layer.normals.clear();
+    layer.indices.clear();
+
+    // The previous upper slab becomes the lower one, along with the vertices on its edges
+    std::swap(lower, upper);
+    std::swap(lowerInside, upperInside);
+    edgeVertices.NextLayer();
+
+    std::copy(densities, densities + upper.size(), upper.begin());
+    for (std::size_t i = 0; i < upper.size(); i++) {
+        upperInside[i] = upper[i] < isoLevel;
+    }
+
+    int z = slabCount++;
+    if (z == 0) {
+        return;
+    }
+
+    PROFILE_SCOPE(ProfileZone::Polygonise);
+
+    // Slab z - 1 is the lower one
+    const float lowerZ = origin.z + (z - 1) * spacing.z;
+    const std::uint32_t firstVertex = vertexCount;
+    std::uint64_t deduplicated = 0;
+    std::uint64_t degenerate = 0;
+
+    // Find or create the vertex where the surface crosses an edge of the cell
+    auto edgeVertex = [&](int x, int y, int edge) {
+        const CellEdge &cellEdge = cellEdges[edge];
+        const int *startCorner = MarchingCubesTables::cornerOffsets[cellEdge.start];
+        const int *endCorner = MarchingCubesTables::cornerOffsets[cellEdge.end];
+        int sx = x + startCorner[0], sy = y + startCorner[1];
+        int ex = x + endCorner[0], ey = y + endCorner[1];
+        bool startUpper = startCorner[2] == 1;
+        bool endUpper = endCorner[2] == 1;
+
+        std::uint32_t &slot = edgeVertices.At(sx, sy, startUpper, cellEdge.axis);
+        if (slot != LayerEdgeVertices::NONE) {
+            deduplicated++;
+            return slot;
+        }
+
+        std::size_t startIndex = static_cast<std::size_t>(sy) * width + sx;
+        std::size_t endIndex = static_cast<std::size_t>(ey) * width + ex;
+        Vector3 p1 = { origin.x + sx * spacing.x, origin.y + sy * spacing.y, lowerZ + startCorner[2] * spacing.z };
+        Vector3 p2 = { origin.x + ex * spacing.x, origin.y + ey * spacing.y, lowerZ + endCorner[2] * spacing.z };
+        double d1 = (startUpper ? upper : lower)[startIndex];
+        double d2 = (endUpper ? upper : lower)[endIndex];
+        float edgeSpacing = cellEdge.axis == 0 ? spacing.x : (cellEdge.axis == 1 ? spacing.y : spacing.z);
+
+        SurfaceVertex vertex = InterpolateEdgeVertex(isoLevel, p1, p2, d1, d2, SampleGradient(startUpper, sx, sy),
+                                                     SampleGradient(endUpper, ex, ey), cellEdge.axis, edgeSpacing);
+        layer.vertices.push_back(vertex.position);
+        layer.normals.push_back(vertex.normal);
+        slot = vertexCount++;
+        return slot;
+    };
+
+    // Vertices not created for this layer lie on the lower slab, so they were created for the previous one
+    auto position = [&](std::uint32_t vertex) {
+        return vertex >= firstVertex ? layer.vertices[vertex - firstVertex] : previousVertices[vertex - previousFirstVertex];
+    };
+
+    auto emit = [&](std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+        layer.indices.push_back(a);
+        layer.indices.push_back(b);
+        layer.indices.push_back(c);
+    };
+
+    // The corners of a cell come in two columns of four, one at x and one at x + 1. Each column is coded as
+    // 4 bits, inside or not at (y, lower), (y + 1, lower), (y, upper) and (y + 1, upper), and the tables
+    // below move those bits to the corners they are in cornerOffsets order, on either side of the cell.
+    static constexpr auto columnCorners = [](int side) {
+        std::array<int, 16> corners {};
+        for (int code = 0; code < 16; code++) {
+            for (int i = 0; i < 8; i++) {
+                const int *corner = MarchingCubesTables::cornerOffsets[i];
+                if (corner[0] == side && (code >> (corner[1] + corner[2] * 2) & 1)) {
+                    corners[code] |= 1 << i;
+                }
+            }
+        }
+        return corners;
+    };
+    static constexpr std::array<int, 16> leftCorners = columnCorners(0);
+    static constexpr std::array<int, 16> rightCorners = columnCorners(1);
+
+    const int *edgeTable = MarchingCubesTables::edgeTable;
+    for (int y = 0; y + 1 < height; y++) {
+        const std::uint8_t *lowerRow = lowerInside.data() + static_cast<std::size_t>(y) * width;
+        const std::uint8_t *upperRow = upperInside.data() + static_cast<std::size_t>(y) * width;
+        auto column = [&](int x) {
+            return lowerRow[x] | lowerRow[x + width] << 1 | upperRow[x] << 2 | upperRow[x + width] << 3;
+        };
+
+        int left = column(0);
+        for (int x = 0; x + 1 < width; x++) {
+            int right = column(x + 1);
+            int cubeIndex = leftCorners[left] | rightCorners[right];
+            left = right;
+
+            if (stats != nullptr) {
+                stats->caseHistogram[cubeIndex]++;
+            }
+
+            if (edgeTable[cubeIndex] == 0) {
+                continue;
+            }
+
+            auto vertexOf = [&](int edge) { return edgeVertex(x, y, edge); };
+            degenerate += PolygoniseCell(cubeIndex, vertexOf, position, emit);
+        }
+    }
+
+    previousVertices.assign(layer.vertices.begin(), layer.vertices.end());
+    previousFirstVertex = firstVertex;
+
+    if (stats != nullptr) {
+        auto end = std::chrono::steady_clock::now();
+        stats->cellsVisited += static_cast<std::uint64_t>(width - 1) * (height - 1);
+        stats->AddPolygonised(std::chrono::duration<double, std::milli>(end - start).count(), layer.indices.size() / 3,
+                              layer.vertices.size(), deduplicated, degenerate);
+    }
+}
+
+bool ExtractVolume(VolumeReader &reader, double isoLevel,
+                   const std::function<void(const IndexedMesh &layer, std::uint32_t firstVertex)> &consumer,
+                   ExtractionStats *stats) {
+    const VolumeHeader &header = reader.GetHeader();
+    SlabExtractor extractor(header.width, header.height, header.origin, header.spacing, isoLevel);
+
+    std::vector<float> slab(header.SlabSamples());
+    IndexedMesh layer;
+    for (int z = 0; z < header.depth; z++) {
+        if (!reader.ReadSlab(z, slab.data())) {
+            return false;
+        }
+
+        std::uint32_t firstVertex = extractor.GetVertexCount();
+        extractor.AddSlab(slab.data(), layer, stats);
+        if (z > 0) {
+            consumer(layer, firstVertex);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef SLABEXTRACTOR_H
+#define SLABEXTRACTOR_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <raylib.h>
+
+#include "ExtractionStats.h"
+#include "MarchingCubes.h"
+#include "MarchingCubesCell.h"
+#include "VolumeFile.h"
+
+// Marching cubes over a volume of any size, fed one z slab of samples at a time.
+// Only the last two slabs and the vertices on their edges are kept, so a volume far larger than memory
+// can be streamed from disk, and the mesh handed on layer by layer without ever holding all of it.
+class SlabExtractor {
+public:
+    // Slabs hold width * height samples, spacing apart, with the first sample of the first slab at origin
+    SlabExtractor(int width, int height, Vector3 origin, Vector3 spacing, double isoLevel);
+
+    // Add the next slab of densities, x-major. From the second slab on, the layer of cells between the
+    // previous slab and this one is polygonised into layer, which is cleared first.
+    // Vertices are numbered across the whole stream: layer holds the vertices created for this layer,
+    // stream vertex i being layer.vertices[i - first] where first is GetVertexCount() from before the call,
+    // and its indices also refer to vertices of earlier layers.
+    void AddSlab(const float *densities, IndexedMesh &layer, ExtractionStats *stats = nullptr);
+
+    // Vertices created so far
+    std::uint32_t GetVertexCount() const { return vertexCount; }
+
+    int GetSlabCount() const { return slabCount; }
+
+private:
+    // Density gradient at a sample of the lower or upper slab
+    Vector3 SampleGradient(bool upperSlab, int x, int y) const;
+
+    int width;
+    int height;
+    Vector3 origin;
+    Vector3 spacing;
+    double isoLevel;
+
+    std::vector<float> lower;
+    std::vector<float> upper;
+    std::vector<std::uint8_t> lowerInside;
+    std::vector<std::uint8_t> upperInside;
+
+    // Vertex on each edge of the current layer, the lower and upper slab being its planes
+    LayerEdgeVertices edgeVertices;
+
+    // Positions of the vertices created for the previous layer, to find degenerate triangles that use them
+    std::vector<Vector3> previousVertices;
+    std::uint32_t previousFirstVertex = 0;
+
+    std::uint32_t vertexCount = 0;
+    int slabCount = 0;
+};
+
+// Stream the isosurface of a volume file through a SlabExtractor. consumer is called for every layer of
+// cells with the layer and the stream number of its first vertex, see SlabExtractor::AddSlab.
+// Returns false if reading the volume fails, the reader's GetError says why.
+bool ExtractVolume(VolumeReader &reader, double isoLevel,
+                   const std::function<void(const IndexedMesh &layer, std::uint32_t firstVertex)> &consumer,
+                   ExtractionStats *stats = nullptr);
+
+#endif // SLABEXTRACTOR_H
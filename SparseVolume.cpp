@@ -0,0 +1,308 @@
+#include "SparseVolume.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+    // Never a packed key, whose top bit is always clear
+    constexpr std::uint64_t EMPTY_KEY = ~std::uint64_t(0);
+
+    constexpr int BRICK_SHIFT = 3;
+    static_assert(1 << BRICK_SHIFT == SPARSE_BRICK_SIZE, "BRICK_SHIFT must match SPARSE_BRICK_SIZE");
+
+    bool IsBrickPointer(std::uint64_t value) {
+        return value != 0 && (value & 1) == 0;
+    }
+
+    std::uint64_t EncodeUniform(float value) {
+        return static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(value)) << 1 | 1;
+    }
+
+    float DecodeUniform(std::uint64_t value) {
+        return std::bit_cast<float>(static_cast<std::uint32_t>(value >> 1));
+    }
+}
+
+SparseVolume::Table::Table(std::size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]), used(0) {
+    for (std::size_t i = 0; i < capacity; i++) {
+        slots[i].key.store(EMPTY_KEY, std::memory_order_relaxed);
+        slots[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+SparseVolume::SparseVolume(float background, float truncation, std::size_t initialCapacity)
+    : background(background), truncation(truncation), table(new Table(std::bit_ceil(std::max<std::size_t>(initialCapacity, 16)))) {
+}
+
+SparseVolume::~SparseVolume() {
+    ReclaimRetired();
+
+    Table *current = table.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i <= current->mask; i++) {
+        std::uint64_t value = current->slots[i].value.load(std::memory_order_relaxed);
+        if (IsBrickPointer(value)) {
+            delete reinterpret_cast<Brick *>(value);
+        }
+    }
+    delete current;
+}
+
+std::uint64_t SparseVolume::PackKey(BrickCoord coord) {
+    // 21 bits per axis, offset so negative coordinates stay positive
+    constexpr std::uint64_t bias = std::uint64_t(1) << 20;
+    constexpr std::uint64_t bits = (std::uint64_t(1) << 21) - 1;
+    return ((coord.x + bias) & bits) | ((coord.y + bias) & bits) << 21 | ((coord.z + bias) & bits) << 42;
+}
+
+std::uint64_t SparseVolume::Hash(std::uint64_t key) {
+    // Finalizer from SplitMix64. Neighbouring bricks differ in few key bits, which have to reach the low bits used as the slot.
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+std::uint64_t SparseVolume::FindValue(BrickCoord coord) const {
+    const std::uint64_t key = PackKey(coord);
+    const Table *current = table.load(std::memory_order_acquire);
+
+    for (std::size_t i = Hash(key) & current->mask;; i = (i + 1) & current->mask) {
+        std::uint64_t slotKey = current->slots[i].key.load(std::memory_order_acquire);
+        if (slotKey == key) {
+            return current->slots[i].value.load(std::memory_order_acquire);
+        }
+        if (slotKey == EMPTY_KEY) {
+            return 0;
+        }
+    }
+}
+
+float SparseVolume::ValueAt(std::uint64_t value, int index) const {
+    if (value == 0) {
+        return background;
+    }
+    if (value & 1) {
+        return DecodeUniform(value);
+    }
+    return reinterpret_cast<const Brick *>(value)->samples[index];
+}
+
+float SparseVolume::Sample(int x, int y, int z) const {
+    // Arithmetic shifts round down, so negative samples land in the right brick
+    BrickCoord coord = { x >> BRICK_SHIFT, y >> BRICK_SHIFT, z >> BRICK_SHIFT };
+    constexpr int local = SPARSE_BRICK_SIZE - 1;
+    int index = (x & local) + (y & local) * SPARSE_BRICK_SIZE + (z & local) * SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE;
+    return ValueAt(FindValue(coord), index);
+}
+
+void SparseVolume::StoreBrick(BrickCoord coord, const float *samples) {
+    std::array<float, SPARSE_BRICK_SAMPLES> truncated;
+    std::transform(samples, samples + SPARSE_BRICK_SAMPLES, truncated.begin(), [&](float sample) {
+        return std::clamp(sample, -truncation, truncation);
+    });
+
+    if (std::all_of(truncated.begin() + 1, truncated.end(), [&](float sample) { return sample == truncated[0]; })) {
+        StoreUniform(coord, truncated[0]);
+        return;
+    }
+
+    Brick *brick = new Brick { truncated };
+    Store(coord, reinterpret_cast<std::uint64_t>(brick));
+}
+
+void SparseVolume::StoreUniform(BrickCoord coord, float value) {
+    value = std::clamp(value, -truncation, truncation);
+    Store(coord, value == background ? 0 : EncodeUniform(value));
+}
+
+void SparseVolume::EraseBrick(BrickCoord coord) {
+    Store(coord, 0);
+}
+
+void SparseVolume::Store(BrickCoord coord, std::uint64_t value) {
+    const std::uint64_t key = PackKey(coord);
+
+    while (true) {
+        const Table *full = nullptr;
+        {
+            std::shared_lock<std::shared_mutex> lock(growMutex);
+            Table *current = table.load(std::memory_order_acquire);
+
+            for (std::size_t i = Hash(key) & current->mask;; i = (i + 1) & current->mask) {
+                Slot &slot = current->slots[i];
+                std::uint64_t slotKey = slot.key.load(std::memory_order_acquire);
+
+                if (slotKey == EMPTY_KEY) {
+                    // Erasing a brick that was never stored
+                    if (value == 0) {
+                        return;
+                    }
+
+                    // Keep a quarter of the slots free, so probe runs stay short and always end. The slot is
+                    // reserved before it is claimed, so concurrent writers cannot all pass the check and overfill
+                    // the table between them.
+                    std::size_t reserved = current->used.fetch_add(1, std::memory_order_relaxed) + 1;
+                    if (reserved * 4 > (current->mask + 1) * 3) {
+                        current->used.fetch_sub(1, std::memory_order_relaxed);
+                        full = current;
+                        break;
+                    }
+
+                    // Another writer may claim the slot first, for this brick or another, and keeps its own reservation
+                    if (slot.key.compare_exchange_strong(slotKey, key, std::memory_order_acq_rel)) {
+                        slotKey = key;
+                    } else {
+                        current->used.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+
+                if (slotKey != key) {
+                    continue;
+                }
+
+                std::uint64_t previous = slot.value.exchange(value, std::memory_order_acq_rel);
+                if (previous != 0) {
+                    (previous & 1 ? uniformBrickCount : brickCount).fetch_sub(1, std::memory_order_relaxed);
+                }
+                if (value != 0) {
+                    (value & 1 ? uniformBrickCount : brickCount).fetch_add(1, std::memory_order_relaxed);
+                }
+                Retire(previous);
+                return;
+            }
+        }
+
+        Grow(full);
+    }
+}
+
+void SparseVolume::Retire(std::uint64_t value) {
+    if (IsBrickPointer(value)) {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        retiredBricks.push_back(reinterpret_cast<Brick *>(value));
+    }
+}
+
+void SparseVolume::Grow(const Table *full) {
+    std::unique_lock<std::shared_mutex> lock(growMutex);
+
+    // Another writer may have grown the table while this one waited
+    Table *current = table.load(std::memory_order_relaxed);
+    if (current != full) {
+        return;
+    }
+
+    // Erased bricks leave their keys behind, so a table full of them is rebuilt at the same size
+    std::size_t capacity = current->mask + 1;
+    std::size_t live = 0;
+    for (std::size_t i = 0; i < capacity; i++) {
+        live += current->slots[i].value.load(std::memory_order_relaxed) != 0;
+    }
+    std::size_t newCapacity = live * 2 > capacity ? capacity * 2 : capacity;
+
+    auto grown = std::make_unique<Table>(newCapacity);
+    for (std::size_t i = 0; i < capacity; i++) {
+        std::uint64_t value = current->slots[i].value.load(std::memory_order_relaxed);
+        if (value == 0) {
+            continue;
+        }
+
+        std::uint64_t key = current->slots[i].key.load(std::memory_order_relaxed);
+        std::size_t slot = Hash(key) & grown->mask;
+        while (grown->slots[slot].key.load(std::memory_order_relaxed) != EMPTY_KEY) {
+            slot = (slot + 1) & grown->mask;
+        }
+        grown->slots[slot].key.store(key, std::memory_order_relaxed);
+        grown->slots[slot].value.store(value, std::memory_order_relaxed);
+    }
+    grown->used.store(live, std::memory_order_relaxed);
+
+    // Readers may still be probing the old table, so it is retired rather than freed
+    table.store(grown.release(), std::memory_order_release);
+    std::lock_guard<std::mutex> retiredLock(retiredMutex);
+    retiredTables.emplace_back(current);
+}
+
+void SparseVolume::StoreChunk(const Chunk &chunk) {
+    float samples[SPARSE_BRICK_SAMPLES];
+
+    for (int bz = 0; bz < SPARSE_BRICKS_PER_CHUNK; bz++) {
+        for (int by = 0; by < SPARSE_BRICKS_PER_CHUNK; by++) {
+            for (int bx = 0; bx < SPARSE_BRICKS_PER_CHUNK; bx++) {
+                float *out = samples;
+                for (int z = 0; z < SPARSE_BRICK_SIZE; z++) {
+                    for (int y = 0; y < SPARSE_BRICK_SIZE; y++) {
+                        const float *row = chunk.densities.data() + Chunk::Index(bx * SPARSE_BRICK_SIZE, by * SPARSE_BRICK_SIZE + y, bz * SPARSE_BRICK_SIZE + z);
+                        out = std::copy(row, row + SPARSE_BRICK_SIZE, out);
+                    }
+                }
+
+                BrickCoord coord = {
+                    chunk.coord.x * SPARSE_BRICKS_PER_CHUNK + bx,
+                    chunk.coord.y * SPARSE_BRICKS_PER_CHUNK + by,
+                    chunk.coord.z * SPARSE_BRICKS_PER_CHUNK + bz
+                };
+                StoreBrick(coord, samples);
+            }
+        }
+    }
+}
+
+void SparseVolume::ReadChunk(ChunkCoord coord, Chunk &chunk) const {
+    chunk.coord = coord;
+
+    // The far faces of the chunk are the first samples of the next row of bricks
+    for (int bz = 0; bz <= SPARSE_BRICKS_PER_CHUNK; bz++) {
+        for (int by = 0; by <= SPARSE_BRICKS_PER_CHUNK; by++) {
+            for (int bx = 0; bx <= SPARSE_BRICKS_PER_CHUNK; bx++) {
+                BrickCoord brick = {
+                    coord.x * SPARSE_BRICKS_PER_CHUNK + bx,
+                    coord.y * SPARSE_BRICKS_PER_CHUNK + by,
+                    coord.z * SPARSE_BRICKS_PER_CHUNK + bz
+                };
+                std::uint64_t value = FindValue(brick);
+
+                int x0 = bx * SPARSE_BRICK_SIZE, y0 = by * SPARSE_BRICK_SIZE, z0 = bz * SPARSE_BRICK_SIZE;
+                int width = std::min(SPARSE_BRICK_SIZE, CHUNK_SAMPLES - x0);
+                int height = std::min(SPARSE_BRICK_SIZE, CHUNK_SAMPLES - y0);
+                int depth = std::min(SPARSE_BRICK_SIZE, CHUNK_SAMPLES - z0);
+
+                for (int z = 0; z < depth; z++) {
+                    for (int y = 0; y < height; y++) {
+                        float *out = chunk.densities.data() + Chunk::Index(x0, y0 + y, z0 + z);
+                        if (IsBrickPointer(value)) {
+                            const float *row = reinterpret_cast<const Brick *>(value)->samples.data() + (y + z * SPARSE_BRICK_SIZE) * SPARSE_BRICK_SIZE;
+                            std::copy(row, row + width, out);
+                        } else {
+                            std::fill(out, out + width, ValueAt(value, 0));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    chunk.UpdateBounds();
+}
+
+void SparseVolume::ReclaimRetired() {
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    for (Brick *brick : retiredBricks) {
+        delete brick;
+    }
+    retiredBricks.clear();
+    retiredTables.clear();
+}
+
+std::size_t SparseVolume::GetMemoryBytes() const {
+    std::lock_guard<std::mutex> lock(retiredMutex);
+
+    std::size_t bytes = (GetBrickCount() + retiredBricks.size()) * sizeof(Brick);
+    bytes += (table.load(std::memory_order_acquire)->mask + 1) * sizeof(Slot);
+    for (const std::unique_ptr<Table> &retired : retiredTables) {
+        bytes += (retired->mask + 1) * sizeof(Slot);
+    }
+    return bytes;
+}
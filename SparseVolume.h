@@ -0,0 +1,130 @@
+#ifndef SPARSEVOLUME_H
+#define SPARSEVOLUME_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "Chunk.h"
+
+// Number of samples along each axis of a sparse volume brick
+constexpr int SPARSE_BRICK_SIZE = 8;
+constexpr int SPARSE_BRICK_SAMPLES = SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE;
+constexpr int SPARSE_BRICKS_PER_CHUNK = CHUNK_SIZE / SPARSE_BRICK_SIZE;
+static_assert(CHUNK_SIZE % SPARSE_BRICK_SIZE == 0, "chunks must be made of whole bricks");
+
+struct BrickCoord {
+    int x;
+    int y;
+    int z;
+
+    bool operator==(const BrickCoord &other) const = default;
+};
+
+// Density samples of a world far too large for dense arrays, stored as bricks of 8^3 samples in an
+// open addressing hash table keyed by brick coordinate. Only bricks with detail hold samples: a brick
+// of one value is stored as just that value, and anywhere no brick is stored has the background value,
+// so the vast uniform stretches of air and rock cost next to nothing.
+//
+// Reads never lock. Writes from several threads run concurrently and only wait for each other while
+// the table grows. A brick replaced or erased stays allocated until ReclaimRetired, because a reader may
+// still be looking at it.
+// Brick coordinates must lie within +-2^20, which is 8 million samples either side of the origin.
+class SparseVolume {
+public:
+    // Samples are clamped to +-truncation as they are stored, which turns the bricks away from the surface
+    // uniform. It has to exceed the change in density between neighbouring samples near the surface by
+    // more than the distance of the isoLevel from 0, so vertices and normals come out unchanged.
+    explicit SparseVolume(float background, float truncation = std::numeric_limits<float>::infinity(), std::size_t initialCapacity = 1024);
+    ~SparseVolume();
+    SparseVolume(const SparseVolume &) = delete;
+    SparseVolume &operator=(const SparseVolume &) = delete;
+
+    float GetBackground() const { return background; }
+    float GetTruncation() const { return truncation; }
+
+    // Density at a sample, x-major within bricks like everywhere else
+    float Sample(int x, int y, int z) const;
+
+    // Store the SPARSE_BRICK_SAMPLES samples of a brick, x-major. Bricks of a single value after truncation
+    // are stored as that value, and bricks of only the background value are erased.
+    void StoreBrick(BrickCoord coord, const float *samples);
+    void StoreUniform(BrickCoord coord, float value);
+    void EraseBrick(BrickCoord coord);
+
+    // Store the samples of a chunk, which covers SPARSE_BRICKS_PER_CHUNK bricks along each axis.
+    // The far faces of the chunk belong to its neighbours and are left out.
+    void StoreChunk(const Chunk &chunk);
+
+    // Fill a chunk with the samples starting at coord * CHUNK_SIZE, including its far faces, and update its bounds
+    void ReadChunk(ChunkCoord coord, Chunk &chunk) const;
+
+    // Free replaced and erased bricks, and tables left behind by growing.
+    // Only call this while no other thread is using the volume.
+    void ReclaimRetired();
+
+    // Bricks holding samples, and bricks stored as a single value
+    std::size_t GetBrickCount() const { return brickCount.load(std::memory_order_relaxed); }
+    std::size_t GetUniformBrickCount() const { return uniformBrickCount.load(std::memory_order_relaxed); }
+
+    // Memory held by bricks and tables, including retired ones
+    std::size_t GetMemoryBytes() const;
+
+private:
+    struct Brick {
+        std::array<float, SPARSE_BRICK_SAMPLES> samples;
+    };
+
+    // A slot's value is 0 when nothing is stored, a Brick pointer, or a uniform value with the low bit set
+    struct Slot {
+        std::atomic<std::uint64_t> key;
+        std::atomic<std::uint64_t> value;
+    };
+
+    struct Table {
+        explicit Table(std::size_t capacity);
+
+        std::size_t mask;
+        std::unique_ptr<Slot[]> slots;
+
+        // Slots with a key, counting those whose value has since been erased
+        std::atomic<std::size_t> used;
+    };
+
+    static std::uint64_t PackKey(BrickCoord coord);
+    static std::uint64_t Hash(std::uint64_t key);
+
+    // Value stored for a brick, 0 if there is none
+    std::uint64_t FindValue(BrickCoord coord) const;
+    float ValueAt(std::uint64_t value, int index) const;
+
+    // Swap in a new value for a brick, retiring what it replaces
+    void Store(BrickCoord coord, std::uint64_t value);
+    void Retire(std::uint64_t value);
+
+    // Double the table, or rebuild it without erased entries, once it is too full to insert into
+    void Grow(const Table *full);
+
+    float background;
+    float truncation;
+
+    std::atomic<Table *> table;
+
+    // Held shared by writers and exclusively while the table grows
+    std::shared_mutex growMutex;
+
+    std::atomic<std::size_t> brickCount = 0;
+    std::atomic<std::size_t> uniformBrickCount = 0;
+
+    mutable std::mutex retiredMutex;
+    std::vector<Brick *> retiredBricks;
+    std::vector<std::unique_ptr<Table>> retiredTables;
+};
+
+#endif // SPARSEVOLUME_H
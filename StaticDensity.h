@@ -0,0 +1,197 @@
+#ifndef STATICDENSITY_H
+#define STATICDENSITY_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <raylib.h>
+
+#include "DensityField.h"
+
+// Compile-time counterpart of DensityProgram.
+// A density graph that is fixed when the program is built can be written as nested node types,
+// e.g. StaticDensity::Subtract(StaticDensity::Terrain(...), StaticDensity::Sphere(...)).
+// The whole graph then inlines into a single function, with no per node dispatch,
+// and StaticDensityField puts it behind the same DensityField API as the interpreted path.
+// Every node computes the same formula as its DensityOp, so both paths produce the same densities.
+namespace StaticDensity {
+    struct SphereNode {
+        Vector3 center;
+        float radius;
+
+        float operator()(float x, float y, float z) const {
+            float dx = x - center.x, dy = y - center.y, dz = z - center.z;
+            return std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+        }
+    };
+
+    struct BoxNode {
+        Vector3 center;
+        Vector3 halfExtents;
+
+        float operator()(float x, float y, float z) const {
+            float qx = std::abs(x - center.x) - halfExtents.x;
+            float qy = std::abs(y - center.y) - halfExtents.y;
+            float qz = std::abs(z - center.z) - halfExtents.z;
+            float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f), oz = std::max(qz, 0.0f);
+            float outside = std::sqrt(ox * ox + oy * oy + oz * oz);
+            float inside = std::min(std::max(qx, std::max(qy, qz)), 0.0f);
+            return outside + inside;
+        }
+    };
+
+    struct CapsuleNode {
+        Vector3 start;
+        Vector3 end;
+        float radius;
+
+        float operator()(float x, float y, float z) const {
+            float bax = end.x - start.x, bay = end.y - start.y, baz = end.z - start.z;
+            float inverseLengthSqr = 1.0f / std::max(bax * bax + bay * bay + baz * baz, 1e-12f);
+            float pax = x - start.x, pay = y - start.y, paz = z - start.z;
+            float h = std::clamp((pax * bax + pay * bay + paz * baz) * inverseLengthSqr, 0.0f, 1.0f);
+            float dx = pax - bax * h, dy = pay - bay * h, dz = paz - baz * h;
+            return std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+        }
+    };
+
+    struct TorusNode {
+        Vector3 center;
+        float majorRadius;
+        float minorRadius;
+
+        float operator()(float x, float y, float z) const {
+            float dx = x - center.x, dy = y - center.y, dz = z - center.z;
+            float ring = std::sqrt(dx * dx + dz * dz) - majorRadius;
+            return std::sqrt(ring * ring + dy * dy) - minorRadius;
+        }
+    };
+
+    struct TerrainNode {
+        FastNoiseLite noise;
+        float baseHeight;
+        float amplitude;
+
+        float operator()(float x, float y, float z) const {
+            return y - (baseHeight + noise.GetNoise(x, z) * amplitude);
+        }
+    };
+
+    template <typename A, typename B>
+    struct UnionNode {
+        A a;
+        B b;
+
+        float operator()(float x, float y, float z) const {
+            return std::min(a(x, y, z), b(x, y, z));
+        }
+    };
+
+    template <typename A, typename B>
+    struct SubtractNode {
+        A a;
+        B b;
+
+        float operator()(float x, float y, float z) const {
+            return std::max(a(x, y, z), -b(x, y, z));
+        }
+    };
+
+    template <typename A, typename B>
+    struct IntersectNode {
+        A a;
+        B b;
+
+        float operator()(float x, float y, float z) const {
+            return std::max(a(x, y, z), b(x, y, z));
+        }
+    };
+
+    template <typename A, typename B>
+    struct SmoothUnionNode {
+        A a;
+        B b;
+        float blendRadius;
+
+        float operator()(float x, float y, float z) const {
+            float da = a(x, y, z);
+            float db = b(x, y, z);
+            float h = std::clamp(0.5f + 0.5f * (db - da) / blendRadius, 0.0f, 1.0f);
+            return db + (da - db) * h - blendRadius * h * (1.0f - h);
+        }
+    };
+
+    inline SphereNode Sphere(Vector3 center, float radius) {
+        return { center, radius };
+    }
+
+    inline BoxNode Box(Vector3 center, Vector3 halfExtents) {
+        return { center, halfExtents };
+    }
+
+    inline CapsuleNode Capsule(Vector3 start, Vector3 end, float radius) {
+        return { start, end, radius };
+    }
+
+    inline TorusNode Torus(Vector3 center, float majorRadius, float minorRadius) {
+        return { center, majorRadius, minorRadius };
+    }
+
+    inline TerrainNode Terrain(int seed, float baseHeight, float amplitude, float frequency) {
+        return { CreateTerrainNoise(seed, frequency), baseHeight, amplitude };
+    }
+
+    template <typename A, typename B>
+    UnionNode<A, B> Union(A a, B b) {
+        return { std::move(a), std::move(b) };
+    }
+
+    template <typename A, typename B>
+    SubtractNode<A, B> Subtract(A a, B b) {
+        return { std::move(a), std::move(b) };
+    }
+
+    template <typename A, typename B>
+    IntersectNode<A, B> Intersect(A a, B b) {
+        return { std::move(a), std::move(b) };
+    }
+
+    template <typename A, typename B>
+    SmoothUnionNode<A, B> SmoothUnion(A a, B b, float blendRadius) {
+        return { std::move(a), std::move(b), std::max(blendRadius, 1e-6f) };
+    }
+}
+
+// Puts a statically composed density graph behind the DensityField API
+template <typename Expr>
+class StaticDensityField : public DensityField {
+public:
+    explicit StaticDensityField(Expr expr) : expr(std::move(expr)) {}
+
+    float Sample(Vector3 position) const override {
+        return expr(position.x, position.y, position.z);
+    }
+
+    void SampleBlock(Vector3 origin, float spacing, int size, float *out) const override {
+        for (int z = 0; z < size; z++) {
+            float pz = origin.z + z * spacing;
+            for (int y = 0; y < size; y++) {
+                float py = origin.y + y * spacing;
+                for (int x = 0; x < size; x++) {
+                    *out++ = expr(origin.x + x * spacing, py, pz);
+                }
+            }
+        }
+    }
+
+private:
+    Expr expr;
+};
+
+template <typename Expr>
+StaticDensityField<Expr> MakeStaticDensityField(Expr expr) {
+    return StaticDensityField<Expr>(std::move(expr));
+}
+
+#endif // STATICDENSITY_H
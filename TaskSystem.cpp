@@ -0,0 +1,258 @@
+#include "TaskSystem.h"
+
+#include <algorithm>
+
+namespace {
+    thread_local int currentWorkerIndex = 0;
+}
+
+TaskSystem::TaskSystem(int workerCount) {
+    workers.reserve(std::max(workerCount, 0));
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&TaskSystem::WorkerLoop, this, i + 1);
+    }
+}
+
+TaskSystem::~TaskSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+TaskSystem &TaskSystem::Get() {
+    static TaskSystem system(static_cast<int>(std::max(std::thread::hardware_concurrency(), 2u)) - 1);
+    return system;
+}
+
+int TaskSystem::GetWorkerIndex() {
+    return currentWorkerIndex;
+}
+
+TaskHandle TaskSystem::Submit(Function work, const std::vector<TaskHandle> &dependencies, float priority, CancelToken cancel) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    std::uint32_t index;
+    if (!freeTasks.empty()) {
+        index = freeTasks.back();
+        freeTasks.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(tasks.size());
+        tasks.emplace_back();
+    }
+
+    Task &task = tasks[index];
+    task.work = std::move(work);
+    task.cancel = std::move(cancel);
+    task.priority = priority;
+    task.state = TaskState::Waiting;
+    task.outcome = std::make_shared<TaskOutcome>(TaskOutcome::Pending);
+    task.remaining = 0;
+    task.dependencyCancelled = false;
+    task.dependents.clear();
+    waitingCount++;
+
+    for (const TaskHandle &dependency : dependencies) {
+        if (!IsFinishedLocked(dependency)) {
+            tasks[dependency.index].dependents.push_back(index);
+            task.remaining++;
+        } else if (dependency.IsValid() && *dependency.outcome == TaskOutcome::Cancelled) {
+            task.dependencyCancelled = true;
+        }
+    }
+
+    TaskHandle handle = { index, task.outcome };
+    if (task.remaining == 0) {
+        Enqueue(index);
+        lock.unlock();
+        taskReady.notify_one();
+
+        // Without workers only waiting threads run tasks
+        if (workers.empty()) {
+            taskFinished.notify_all();
+        }
+    }
+    return handle;
+}
+
+TaskHandle TaskSystem::ParallelFor(int count, int parts, std::function<void(int part, int begin, int end)> work,
+                                   const std::vector<TaskHandle> &dependencies, float priority, CancelToken cancel) {
+    parts = std::clamp(parts, 1, std::max(count, 1));
+    auto shared = std::make_shared<std::function<void(int, int, int)>>(std::move(work));
+
+    std::vector<TaskHandle> partTasks;
+    partTasks.reserve(parts);
+    for (int part = 0; part < parts; part++) {
+        int begin = static_cast<int>(static_cast<std::int64_t>(count) * part / parts);
+        int end = static_cast<int>(static_cast<std::int64_t>(count) * (part + 1) / parts);
+        partTasks.push_back(Submit([shared, part, begin, end] { (*shared)(part, begin, end); }, dependencies, priority, cancel));
+    }
+
+    // Joins the parts, so later tasks need only depend on this one
+    return Submit([] {}, partTasks, priority, cancel);
+}
+
+void TaskSystem::SetPriority(const TaskHandle &handle, float priority) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (IsFinishedLocked(handle)) {
+        return;
+    }
+
+    Task &task = tasks[handle.index];
+    if (task.priority == priority) {
+        return;
+    }
+    task.priority = priority;
+
+    // A ready task gets a new entry, and the old one is skipped when it comes up
+    if (task.state == TaskState::Ready) {
+        readyCount--;
+        Enqueue(handle.index);
+    }
+}
+
+bool TaskSystem::IsFinished(const TaskHandle &task) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return IsFinishedLocked(task);
+}
+
+bool TaskSystem::IsFinishedLocked(const TaskHandle &task) const {
+    // A pending outcome means the task still holds its slot
+    return !task.IsValid() || *task.outcome != TaskOutcome::Pending;
+}
+
+bool TaskSystem::Wait(const TaskHandle &task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!IsFinishedLocked(task)) {
+        if (!RunOne(lock)) {
+            taskFinished.wait(lock);
+        }
+    }
+    return !task.IsValid() || *task.outcome == TaskOutcome::Ran;
+}
+
+void TaskSystem::WaitAll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (waitingCount + readyCount + runningCount > 0) {
+        if (!RunOne(lock)) {
+            taskFinished.wait(lock);
+        }
+    }
+}
+
+TaskSystem::Stats TaskSystem::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return { waitingCount, readyCount, runningCount, completedCount, cancelledCount };
+}
+
+void TaskSystem::WorkerLoop(int workerIndex) {
+    currentWorkerIndex = workerIndex;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (!RunOne(lock)) {
+            taskReady.wait(lock);
+        }
+    }
+}
+
+bool TaskSystem::RunOne(std::unique_lock<std::mutex> &lock) {
+    while (!readyQueue.empty()) {
+        std::pop_heap(readyQueue.begin(), readyQueue.end());
+        ReadyEntry entry = readyQueue.back();
+        readyQueue.pop_back();
+
+        Task &task = tasks[entry.index];
+        if (task.state != TaskState::Ready || task.queueSequence != entry.sequence) {
+            continue;
+        }
+        readyCount--;
+
+        if (task.dependencyCancelled || task.cancel.IsCancelled()) {
+            Finish(entry.index, false);
+            return true;
+        }
+
+        task.state = TaskState::Running;
+        runningCount++;
+        Function work = std::move(task.work);
+
+        lock.unlock();
+        work();
+        work = nullptr;
+        lock.lock();
+
+        runningCount--;
+        Finish(entry.index, true);
+        return true;
+    }
+    return false;
+}
+
+void TaskSystem::Enqueue(std::uint32_t index) {
+    Task &task = tasks[index];
+    if (task.state == TaskState::Waiting) {
+        waitingCount--;
+    }
+    task.state = TaskState::Ready;
+    task.queueSequence = nextSequence++;
+    readyQueue.push_back({ task.priority, task.queueSequence, index });
+    std::push_heap(readyQueue.begin(), readyQueue.end());
+    readyCount++;
+
+    // Reprioritizing every frame leaves an entry behind each time, which may never reach the top
+    if (readyQueue.size() > 2 * readyCount + 64) {
+        std::erase_if(readyQueue, [this](const ReadyEntry &entry) {
+            const Task &queued = tasks[entry.index];
+            return queued.state != TaskState::Ready || queued.queueSequence != entry.sequence;
+        });
+        std::make_heap(readyQueue.begin(), readyQueue.end());
+    }
+}
+
+void TaskSystem::Finish(std::uint32_t index, bool ran) {
+    // Finishing one task can release others that were cancelled with it, which finish in turn
+    std::vector<std::pair<std::uint32_t, bool>> finishing = { { index, ran } };
+    bool released = false;
+
+    while (!finishing.empty()) {
+        auto [current, currentRan] = finishing.back();
+        finishing.pop_back();
+
+        Task &task = tasks[current];
+        std::vector<std::uint32_t> dependents = std::move(task.dependents);
+        task.dependents.clear();
+        task.work = nullptr;
+        task.cancel = {};
+        task.state = TaskState::Free;
+        *task.outcome = currentRan ? TaskOutcome::Ran : TaskOutcome::Cancelled;
+        task.outcome = nullptr;
+        freeTasks.push_back(current);
+        (currentRan ? completedCount : cancelledCount)++;
+
+        for (std::uint32_t dependentIndex : dependents) {
+            Task &dependent = tasks[dependentIndex];
+            dependent.dependencyCancelled = dependent.dependencyCancelled || !currentRan;
+            if (--dependent.remaining > 0) {
+                continue;
+            }
+
+            if (dependent.dependencyCancelled) {
+                waitingCount--;
+                finishing.push_back({ dependentIndex, false });
+            } else {
+                Enqueue(dependentIndex);
+                released = true;
+            }
+        }
+    }
+
+    taskFinished.notify_all();
+    if (released) {
+        taskReady.notify_all();
+    }
+}
@@ -0,0 +1,183 @@
+#ifndef TASKSYSTEM_H
+#define TASKSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared flag that cancels a group of tasks, like every stage of one chunk.
+// Tasks not started yet when it is set are dropped along with everything depending on them,
+// and running tasks can poll it to stop early. A default constructed token is never cancelled.
+class CancelToken {
+public:
+    static CancelToken Create() {
+        CancelToken token;
+        token.flag = std::make_shared<std::atomic<bool>>(false);
+        return token;
+    }
+
+    void Cancel() const {
+        if (flag != nullptr) {
+            flag->store(true, std::memory_order_relaxed);
+        }
+    }
+
+    bool IsCancelled() const { return flag != nullptr && flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// How a task ended, or Pending until it has
+enum class TaskOutcome : std::uint8_t {
+    Pending,
+    Ran,
+    Cancelled
+};
+
+// A submitted task. The outcome is shared by every copy of the handle and by the task while it is live,
+// so it stays readable after the task's slot has been reused. A default constructed handle counts as run.
+struct TaskHandle {
+    std::uint32_t index = ~0u;
+    std::shared_ptr<TaskOutcome> outcome;
+
+    bool IsValid() const { return outcome != nullptr; }
+};
+
+// Thread pool running a graph of tasks, shared by everything in the engine that runs in parallel.
+//
+// A task runs once all tasks it depends on have finished, and of the tasks ready to run the one with
+// the highest priority goes first, in submission order among equals. A task that is cancelled, or depends
+// on one that was, finishes without running.
+//
+// Workers live as long as the system, so each keeps its own ScratchArena::ForThread warm from task to task.
+// Threads waiting for a task run other ready tasks in the meantime, so a system with no workers at all
+// runs everything on the threads that wait.
+class TaskSystem {
+public:
+    using Function = std::function<void()>;
+
+    explicit TaskSystem(int workerCount);
+
+    // Tasks not started yet are dropped, running ones are finished first
+    ~TaskSystem();
+
+    TaskSystem(const TaskSystem &) = delete;
+    TaskSystem &operator=(const TaskSystem &) = delete;
+
+    // The engine's shared system, with a worker for every hardware thread but the calling one.
+    // There is always at least one, so tasks nobody waits for still run on a single core.
+    static TaskSystem &Get();
+
+    int GetWorkerCount() const { return static_cast<int>(workers.size()); }
+
+    // Index of the worker running the calling thread, from 1 to GetWorkerCount, or 0 on any other thread
+    static int GetWorkerIndex();
+
+    TaskHandle Submit(Function work, const std::vector<TaskHandle> &dependencies = {}, float priority = 0.0f,
+                      CancelToken cancel = {});
+
+    // Split 0 to count into parts equal runs and run work(part, begin, end) on each as a task.
+    // Returns a task that finishes once all parts have.
+    TaskHandle ParallelFor(int count, int parts, std::function<void(int part, int begin, int end)> work,
+                           const std::vector<TaskHandle> &dependencies = {}, float priority = 0.0f, CancelToken cancel = {});
+
+    // Move a task that has not started yet within the queue
+    void SetPriority(const TaskHandle &task, float priority);
+
+    // True once a task has run or been cancelled
+    bool IsFinished(const TaskHandle &task) const;
+
+    // Wait for a task, running others meanwhile. Returns false if it was cancelled instead of run.
+    bool Wait(const TaskHandle &task);
+    void WaitAll();
+
+    struct Stats {
+        // Tasks waiting for dependencies, ready to run and running
+        std::size_t waiting;
+        std::size_t ready;
+        std::size_t running;
+
+        std::uint64_t completed;
+        std::uint64_t cancelled;
+    };
+
+    Stats GetStats() const;
+
+private:
+    enum class TaskState : std::uint8_t {
+        Free,
+        Waiting,
+        Ready,
+        Running
+    };
+
+    struct Task {
+        Function work;
+        CancelToken cancel;
+        float priority = 0.0f;
+        TaskState state = TaskState::Free;
+
+        // Shared with the task's handles, and only read or written under the mutex
+        std::shared_ptr<TaskOutcome> outcome;
+
+        // Dependencies not finished yet, and whether any of the finished ones was cancelled
+        int remaining = 0;
+        bool dependencyCancelled = false;
+
+        // Tasks depending on this one
+        std::vector<std::uint32_t> dependents;
+
+        // Sequence of the task's current entry in the ready queue. Entries left behind by SetPriority are skipped.
+        std::uint64_t queueSequence = 0;
+    };
+
+    struct ReadyEntry {
+        float priority;
+        std::uint64_t sequence;
+        std::uint32_t index;
+
+        // Highest priority first, then first submitted
+        bool operator<(const ReadyEntry &other) const {
+            return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+        }
+    };
+
+    void WorkerLoop(int workerIndex);
+
+    // Run or cancel the best ready task, unlocking while it runs. Returns false if none is ready.
+    bool RunOne(std::unique_lock<std::mutex> &lock);
+
+    void Enqueue(std::uint32_t index);
+
+    // Mark a task finished and release the tasks waiting on it
+    void Finish(std::uint32_t index, bool ran);
+
+    bool IsFinishedLocked(const TaskHandle &task) const;
+
+    mutable std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable taskFinished;
+
+    std::vector<Task> tasks;
+    std::vector<std::uint32_t> freeTasks;
+    // Max heap of ready tasks. Skipped entries are dropped once they outnumber the live ones.
+    std::vector<ReadyEntry> readyQueue;
+    std::uint64_t nextSequence = 0;
+
+    std::size_t waitingCount = 0;
+    std::size_t readyCount = 0;
+    std::size_t runningCount = 0;
+    std::uint64_t completedCount = 0;
+    std::uint64_t cancelledCount = 0;
+
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // TASKSYSTEM_H
@@ -0,0 +1,156 @@
+#include "UploadQueue.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+namespace {
+    // Share of the frame time uploads and everything else on the CPU may take together
+    constexpr double FRAME_SHARE = 0.75;
+
+    // Upload speed assumed until one has been measured, and how fast the measurement follows changes
+    constexpr double INITIAL_BYTES_PER_MILLISECOND = 256.0 * 1024.0;
+    constexpr double THROUGHPUT_SMOOTHING = 0.1;
+    constexpr double LATENCY_SMOOTHING = 0.1;
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+UploadQueue::UploadQueue(int targetFps) : frameMilliseconds(1000.0 / std::max(targetFps, 1)) {
+    stats.bytesPerMillisecond = INITIAL_BYTES_PER_MILLISECOND;
+}
+
+UploadQueue::~UploadQueue() {
+    for (Upload &upload : uploads) {
+        UnloadPackedMesh(upload.mesh);
+    }
+    for (CompletedUpload &upload : completed) {
+        UnloadPackedMesh(upload.mesh);
+    }
+}
+
+UploadQueue::UploadId UploadQueue::Enqueue(const PackedMesh &packed, float priority) {
+    if (packed.indices.empty()) {
+        return 0;
+    }
+
+    Upload upload;
+    upload.id = nextId++;
+    upload.priority = priority;
+    upload.queued = std::chrono::steady_clock::now();
+    upload.vertices = reinterpret_cast<const std::uint8_t *>(packed.vertices.data());
+    upload.indices = reinterpret_cast<const std::uint8_t *>(packed.indices.data());
+    upload.vertexBytes = packed.vertices.size() * sizeof(PackedVertex);
+    upload.indexBytes = packed.indices.size() * sizeof(std::uint16_t);
+    upload.uploaded = 0;
+    {
+        PROFILE_SCOPE(ProfileZone::Upload);
+        upload.mesh = LoadPackedMeshBuffers(packed, false);
+    }
+
+    stats.queuedMeshes++;
+    stats.queuedBytes += upload.vertexBytes + upload.indexBytes;
+    uploads.push_back(upload);
+    return upload.id;
+}
+
+void UploadQueue::SetPriority(UploadId id, float priority) {
+    auto it = std::find_if(uploads.begin(), uploads.end(), [id](const Upload &upload) { return upload.id == id; });
+    if (it != uploads.end()) {
+        it->priority = priority;
+    }
+}
+
+void UploadQueue::Cancel(UploadId id) {
+    auto it = std::find_if(uploads.begin(), uploads.end(), [id](const Upload &upload) { return upload.id == id; });
+    if (it == uploads.end()) {
+        return;
+    }
+
+    stats.queuedMeshes--;
+    stats.queuedBytes -= it->vertexBytes + it->indexBytes - it->uploaded;
+    UnloadPackedMesh(it->mesh);
+    uploads.erase(it);
+}
+
+void UploadQueue::Update(double otherWorkMilliseconds) {
+    PROFILE_SCOPE(ProfileZone::Upload);
+
+    double allowedMilliseconds = std::max(frameMilliseconds * FRAME_SHARE - otherWorkMilliseconds, 0.0);
+    std::uint64_t budget = std::max(static_cast<std::uint64_t>(allowedMilliseconds * stats.bytesPerMillisecond),
+                                    static_cast<std::uint64_t>(MIN_FRAME_BYTES));
+    stats.budgetBytes = budget;
+    stats.uploadedBytes = 0;
+    stats.uploadMilliseconds = 0.0;
+    if (uploads.empty()) {
+        return;
+    }
+
+    // Most important first, then first queued
+    std::stable_sort(uploads.begin(), uploads.end(), [](const Upload &a, const Upload &b) { return a.priority > b.priority; });
+
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t uploaded = 0;
+
+    for (Upload &upload : uploads) {
+        if (uploaded >= budget) {
+            break;
+        }
+
+        std::size_t total = upload.vertexBytes + upload.indexBytes;
+        while (upload.uploaded < total && uploaded < budget) {
+            // A slice never spans the two buffers
+            bool inVertices = upload.uploaded < upload.vertexBytes;
+            std::size_t bufferOffset = inVertices ? upload.uploaded : upload.uploaded - upload.vertexBytes;
+            std::size_t bufferBytes = inVertices ? upload.vertexBytes : upload.indexBytes;
+            std::size_t slice = std::min({ bufferBytes - bufferOffset, MAX_SLICE_BYTES, static_cast<std::size_t>(budget - uploaded) });
+
+            // Whole vertices and indices, unless the budget is smaller than one
+            std::size_t element = inVertices ? sizeof(PackedVertex) : sizeof(std::uint16_t);
+            if (slice < bufferBytes - bufferOffset) {
+                slice = std::max(slice / element * element, element);
+            }
+
+            if (inVertices) {
+                UpdatePackedVertices(upload.mesh, upload.vertices + bufferOffset, static_cast<int>(slice), static_cast<int>(bufferOffset));
+            } else {
+                UpdatePackedIndices(upload.mesh, upload.indices + bufferOffset, static_cast<int>(slice), static_cast<int>(bufferOffset));
+            }
+            upload.uploaded += slice;
+            uploaded += slice;
+        }
+
+        if (upload.uploaded == total) {
+            double latency = MillisecondsSince(upload.queued);
+            stats.averageLatencyMilliseconds = stats.completedMeshes == 0 ? latency
+                : stats.averageLatencyMilliseconds + (latency - stats.averageLatencyMilliseconds) * LATENCY_SMOOTHING;
+            stats.maxLatencyMilliseconds = std::max(stats.maxLatencyMilliseconds, latency);
+            stats.completedMeshes++;
+            completed.push_back({ upload.id, upload.mesh });
+        }
+    }
+
+    std::size_t queuedBefore = uploads.size();
+    uploads.erase(std::remove_if(uploads.begin(), uploads.end(), [](const Upload &upload) {
+        return upload.uploaded == upload.vertexBytes + upload.indexBytes;
+    }), uploads.end());
+
+    double elapsed = MillisecondsSince(start);
+    stats.queuedMeshes -= queuedBefore - uploads.size();
+    stats.queuedBytes -= uploaded;
+    stats.uploadedBytes = uploaded;
+    stats.uploadMilliseconds = elapsed;
+
+    // Too short a measurement says more about the clock than about the uploads
+    if (elapsed > 0.05) {
+        stats.bytesPerMillisecond += (uploaded / elapsed - stats.bytesPerMillisecond) * THROUGHPUT_SMOOTHING;
+    }
+}
+
+std::vector<UploadQueue::CompletedUpload> UploadQueue::TakeCompleted() {
+    std::vector<CompletedUpload> taken;
+    taken.swap(completed);
+    return taken;
+}
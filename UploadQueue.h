@@ -0,0 +1,104 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <raylib.h>
+
+#include "VertexPacking.h"
+
+// Spreads the upload of packed meshes over frames, so a burst of finished chunks does not blow the frame.
+//
+// A queued mesh gets its GPU buffers right away, empty, and its data is copied into them in slices of at
+// most MAX_SLICE_BYTES, the most important mesh first. Each frame may upload as many bytes as fit in the
+// time the frame has left: the frame budget less the time the rest of the last frame took, at the
+// throughput uploads have been measured at. The budget is a target, not a hard limit:
+// - However full the frame, at least MIN_FRAME_BYTES go up, so a frame already over its time still uploads.
+// - Slices hold whole vertices and indices, so the last slice of a frame can go up to one vertex over.
+//
+// Main thread only, as it talks to the GPU.
+class UploadQueue {
+public:
+    using UploadId = std::uint64_t;
+
+    static constexpr std::size_t MAX_SLICE_BYTES = 64 << 10;
+    static constexpr std::size_t MIN_FRAME_BYTES = 16 << 10;
+
+    // The frame budget is a share of the frame time at targetFps, leaving the rest to the driver and the GPU
+    explicit UploadQueue(int targetFps = 120);
+
+    // Frees the buffers of meshes still queued
+    ~UploadQueue();
+
+    UploadQueue(const UploadQueue &) = delete;
+    UploadQueue &operator=(const UploadQueue &) = delete;
+
+    // Queue a packed mesh, whose arrays must stay alive and unchanged until it completes or is cancelled.
+    // Higher priorities go up first. Returns 0 if the mesh is empty.
+    UploadId Enqueue(const PackedMesh &packed, float priority = 0.0f);
+
+    // Change the priority of a queued mesh, e.g. when the view has moved. Does nothing once the mesh has completed.
+    void SetPriority(UploadId id, float priority);
+
+    // Drop a queued mesh and free its buffers. Does nothing once the mesh has completed.
+    void Cancel(UploadId id);
+
+    // Upload this frame's share. otherWorkMilliseconds is the time the last frame spent on everything but uploads.
+    void Update(double otherWorkMilliseconds);
+
+    struct CompletedUpload {
+        UploadId id;
+        Mesh mesh;
+    };
+
+    // Meshes completed by Update since the last call, ready to draw. Unload them with UnloadPackedMesh.
+    std::vector<CompletedUpload> TakeCompleted();
+
+    struct Stats {
+        std::size_t queuedMeshes = 0;
+        std::uint64_t queuedBytes = 0;
+
+        // The last Update's budget, and what it used of it, which can be slightly more, see above
+        std::uint64_t budgetBytes = 0;
+        std::uint64_t uploadedBytes = 0;
+        double uploadMilliseconds = 0.0;
+
+        // Measured upload speed the budget is based on
+        double bytesPerMillisecond = 0.0;
+
+        // Time from Enqueue until a mesh completes, a moving average and the longest yet
+        double averageLatencyMilliseconds = 0.0;
+        double maxLatencyMilliseconds = 0.0;
+
+        std::uint64_t completedMeshes = 0;
+    };
+
+    const Stats &GetStats() const { return stats; }
+
+private:
+    struct Upload {
+        UploadId id;
+        float priority;
+        Mesh mesh;
+        std::chrono::steady_clock::time_point queued;
+
+        const std::uint8_t *vertices;
+        const std::uint8_t *indices;
+        std::size_t vertexBytes;
+        std::size_t indexBytes;
+
+        // Bytes copied so far, vertices first
+        std::size_t uploaded;
+    };
+
+    double frameMilliseconds;
+    std::vector<Upload> uploads;
+    std::vector<CompletedUpload> completed;
+    UploadId nextId = 1;
+    Stats stats;
+};
+
+#endif // UPLOADQUEUE_H
@@ -0,0 +1,169 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <raymath.h>
+#include <rlgl.h>
+
+namespace {
+    // OpenGL component types, rlgl only names the float and byte ones
+    constexpr int GL_SHORT_TYPE = 0x1402;
+    constexpr int GL_UNSIGNED_SHORT_TYPE = 0x1403;
+
+    // Raylib's MAX_MESH_VERTEX_BUFFERS. UnloadMesh frees this many buffer ids, the last one holds the indices.
+    constexpr int MESH_VERTEX_BUFFERS = 7;
+    constexpr int INDEX_BUFFER = 6;
+
+    constexpr float SNORM16_MAX = 32767.0f;
+    constexpr float UNORM16_MAX = 65535.0f;
+
+    float SignNotZero(float value) {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    // Round to nearest by truncating, much cheaper than std::lround
+    std::int16_t ToSnorm16(float value) {
+        return static_cast<std::int16_t>(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX + (value >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+std::uint16_t QuantizeCoordinate(float value, float extent) {
+    float unit = std::clamp(value / extent, 0.0f, 1.0f);
+    return static_cast<std::uint16_t>(unit * UNORM16_MAX + 0.5f);
+}
+
+float DequantizeCoordinate(std::uint16_t value, float extent) {
+    return value / UNORM16_MAX * extent;
+}
+
+void EncodeOctahedral(Vector3 normal, std::int16_t out[2]) {
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float x = normal.x / l1;
+    float y = normal.y / l1;
+
+    if (normal.z < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * SignNotZero(x);
+        float foldedY = (1.0f - std::abs(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    out[0] = ToSnorm16(x);
+    out[1] = ToSnorm16(y);
+}
+
+Vector3 DecodeOctahedral(const std::int16_t encoded[2]) {
+    // Same steps as OctahedralDecode in default.vert
+    float x = std::max(encoded[0] / SNORM16_MAX, -1.0f);
+    float y = std::max(encoded[1] / SNORM16_MAX, -1.0f);
+    float z = 1.0f - std::abs(x) - std::abs(y);
+
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    float length = std::sqrt(x * x + y * y + z * z);
+    return { x / length, y / length, z / length };
+}
+
+PackedVertex PackVertex(Vector3 position, Vector3 normal, Vector3 origin, float extent) {
+    PackedVertex vertex {};
+    vertex.position[0] = QuantizeCoordinate(position.x - origin.x, extent);
+    vertex.position[1] = QuantizeCoordinate(position.y - origin.y, extent);
+    vertex.position[2] = QuantizeCoordinate(position.z - origin.z, extent);
+    EncodeOctahedral(normal, vertex.normal);
+    return vertex;
+}
+
+Vector3 UnpackPosition(const PackedVertex &vertex, Vector3 origin, float extent) {
+    return {
+        origin.x + DequantizeCoordinate(vertex.position[0], extent),
+        origin.y + DequantizeCoordinate(vertex.position[1], extent),
+        origin.z + DequantizeCoordinate(vertex.position[2], extent)
+    };
+}
+
+Vector3 UnpackNormal(const PackedVertex &vertex) {
+    return DecodeOctahedral(vertex.normal);
+}
+
+bool PackMesh(const IndexedMesh &mesh, Vector3 origin, float extent, PackedMesh &out) {
+    if (mesh.vertices.size() > 65536) {
+        return false;
+    }
+
+    out.origin = origin;
+    out.extent = extent;
+
+    out.vertices.resize(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); i++) {
+        out.vertices[i] = PackVertex(mesh.vertices[i], mesh.normals[i], origin, extent);
+    }
+
+    out.indices.resize(mesh.indices.size());
+    for (std::size_t i = 0; i < mesh.indices.size(); i++) {
+        out.indices[i] = static_cast<std::uint16_t>(mesh.indices[i]);
+    }
+
+    return true;
+}
+
+Mesh UploadPackedMesh(const PackedMesh &packed) {
+    return LoadPackedMeshBuffers(packed, true);
+}
+
+Mesh LoadPackedMeshBuffers(const PackedMesh &packed, bool withData) {
+    Mesh mesh = {};
+    if (packed.indices.empty()) {
+        return mesh;
+    }
+
+    mesh.vertexCount = static_cast<int>(packed.vertices.size());
+    mesh.triangleCount = static_cast<int>(packed.indices.size() / 3);
+    mesh.indices = const_cast<unsigned short *>(packed.indices.data());
+
+    // Same buffer id layout as UploadMesh, so UnloadMesh can free the GPU side
+    mesh.vboId = static_cast<unsigned int *>(MemAlloc(MESH_VERTEX_BUFFERS * sizeof(unsigned int)));
+    mesh.vaoId = rlLoadVertexArray();
+    rlEnableVertexArray(mesh.vaoId);
+
+    constexpr int stride = sizeof(PackedVertex);
+    mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION] = rlLoadVertexBuffer(withData ? packed.vertices.data() : nullptr, mesh.vertexCount * stride, false);
+
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, GL_UNSIGNED_SHORT_TYPE, true, stride,
+                         reinterpret_cast<const void *>(offsetof(PackedVertex, position)));
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+    // The normal shares the vertex buffer, only the position slot owns it
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 2, GL_SHORT_TYPE, true, stride,
+                         reinterpret_cast<const void *>(offsetof(PackedVertex, normal)));
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL);
+
+    mesh.vboId[INDEX_BUFFER] = rlLoadVertexBufferElement(withData ? packed.indices.data() : nullptr,
+                                                         static_cast<int>(packed.indices.size() * sizeof(std::uint16_t)), false);
+
+    rlDisableVertexArray();
+    return mesh;
+}
+
+void UpdatePackedVertices(const Mesh &mesh, const void *data, int bytes, int offset) {
+    rlUpdateVertexBuffer(mesh.vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION], data, bytes, offset);
+}
+
+void UpdatePackedIndices(const Mesh &mesh, const void *data, int bytes, int offset) {
+    rlUpdateVertexBufferElements(mesh.vboId[INDEX_BUFFER], data, bytes, offset);
+}
+
+void UnloadPackedMesh(Mesh &mesh) {
+    // The index array belongs to the PackedMesh, keep UnloadMesh from freeing it
+    mesh.indices = nullptr;
+    UnloadMesh(mesh);
+}
+
+Matrix PackedMeshTransform(const PackedMesh &packed) {
+    return MatrixMultiply(MatrixScale(packed.extent, packed.extent, packed.extent),
+                          MatrixTranslate(packed.origin.x, packed.origin.y, packed.origin.z));
+}
@@ -0,0 +1,69 @@
+#ifndef VERTEXPACKING_H
+#define VERTEXPACKING_H
+
+#include <cstdint>
+
+#include <raylib.h>
+
+#include "MarchingCubes.h"
+#include "MeshBufferPool.h"
+
+// Compact vertex format for terrain meshes, 12 bytes per vertex instead of 24.
+// Positions are quantized to 16 bits per axis relative to the mesh's bounding cube, which for a chunk
+// is the chunk itself, and normals are octahedral encoded into two 16 bit components.
+// Indices are 16 bit, so a packed mesh holds at most 65536 vertices.
+//
+// The GPU decodes positions for free: the attribute is read as normalized unsigned shorts and
+// PackedMeshTransform scales the unit cube back to the chunk. The normal is decoded in default.vert
+// when its octahedralNormals uniform is set.
+struct PackedVertex {
+    std::uint16_t position[3];
+    std::uint16_t padding;          // Keeps the normal 4 byte aligned for the GPU
+    std::int16_t normal[2];
+};
+
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay tightly packed");
+
+struct PackedMesh {
+    PooledVector<PackedVertex> vertices;
+    PooledVector<std::uint16_t> indices;
+
+    // World space corner and edge length of the cube the positions are quantized in
+    Vector3 origin;
+    float extent;
+};
+
+// Quantize a coordinate in [0, extent] to 16 bits, and back
+std::uint16_t QuantizeCoordinate(float value, float extent);
+float DequantizeCoordinate(std::uint16_t value, float extent);
+
+// Octahedral normal encoding. The normal does not need to be normalized, but must not be zero.
+void EncodeOctahedral(Vector3 normal, std::int16_t out[2]);
+Vector3 DecodeOctahedral(const std::int16_t encoded[2]);
+
+PackedVertex PackVertex(Vector3 position, Vector3 normal, Vector3 origin, float extent);
+Vector3 UnpackPosition(const PackedVertex &vertex, Vector3 origin, float extent);
+Vector3 UnpackNormal(const PackedVertex &vertex);
+
+// Pack an indexed mesh whose vertices lie within the cube at origin with the given edge length.
+// Returns false, leaving out untouched, if the mesh has too many vertices for 16 bit indices.
+bool PackMesh(const IndexedMesh &mesh, Vector3 origin, float extent, PackedMesh &out);
+
+// Upload a packed mesh to the GPU as a Raylib mesh that DrawMesh can draw.
+// DrawMesh only draws indexed when the mesh has a CPU index array, so the returned mesh points at
+// packed.indices, which must stay alive until the mesh is released with UnloadPackedMesh.
+Mesh UploadPackedMesh(const PackedMesh &packed);
+
+// Create the GPU buffers of a packed mesh, filled with its data or, without it, left for the caller to fill
+// with UpdatePackedVertices and UpdatePackedIndices.
+Mesh LoadPackedMeshBuffers(const PackedMesh &packed, bool withData);
+
+// Copy part of the vertex or index data into buffers made by LoadPackedMeshBuffers. Sizes and offsets are in bytes.
+void UpdatePackedVertices(const Mesh &mesh, const void *data, int bytes, int offset);
+void UpdatePackedIndices(const Mesh &mesh, const void *data, int bytes, int offset);
+void UnloadPackedMesh(Mesh &mesh);
+
+// Model transform that maps the unit cube of the decoded positions onto the mesh's bounding cube
+Matrix PackedMeshTransform(const PackedMesh &packed);
+
+#endif // VERTEXPACKING_H
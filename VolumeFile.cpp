@@ -0,0 +1,408 @@
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    // Buffer size for the data stream, large enough that a slab is read in a few system calls
+    constexpr std::size_t STREAM_BUFFER_BYTES = 1 << 20;
+
+    bool Seek(std::FILE *file, std::uint64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    std::string Trim(const std::string &text) {
+        std::size_t start = text.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos) {
+            return "";
+        }
+        std::size_t end = text.find_last_not_of(" \t\r\n");
+        return text.substr(start, end - start + 1);
+    }
+
+    std::string ToLower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    bool ParseSampleType(const std::string &name, VolumeSampleType &type) {
+        std::string lower = ToLower(name);
+        if (lower == "uchar" || lower == "unsigned char" || lower == "uint8" || lower == "uint8_t" || lower == "unsigned_char") {
+            type = VolumeSampleType::UInt8;
+        } else if (lower == "ushort" || lower == "unsigned short" || lower == "unsigned short int" ||
+                   lower == "uint16" || lower == "uint16_t" || lower == "unsigned_short") {
+            type = VolumeSampleType::UInt16;
+        } else if (lower == "float") {
+            type = VolumeSampleType::Float32;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Lengths of the vectors in an NRRD list like "(1,0,0) (0,1,0) (0,0,2.5)"
+    std::vector<float> VectorLengths(const std::string &text) {
+        std::vector<float> lengths;
+        std::size_t open = text.find('(');
+        while (open != std::string::npos) {
+            std::size_t close = text.find(')', open);
+            if (close == std::string::npos) {
+                break;
+            }
+
+            std::string components = text.substr(open + 1, close - open - 1);
+            std::replace(components.begin(), components.end(), ',', ' ');
+            std::istringstream stream(components);
+            float squared = 0.0f;
+            float value;
+            while (stream >> value) {
+                squared += value * value;
+            }
+            lengths.push_back(std::sqrt(squared));
+            open = text.find('(', close);
+        }
+        return lengths;
+    }
+
+    bool ReadNrrdHeader(std::ifstream &stream, const std::string &path, VolumeHeader &header, std::string &error) {
+        std::string dataFile;
+        std::uint64_t byteSkip = 0;
+        int dimension = 0;
+        bool haveSizes = false;
+        bool haveType = false;
+
+        // Fields run until a blank line or the end of a detached header
+        std::string line;
+        while (std::getline(stream, line)) {
+            line = Trim(line);
+            if (line.empty()) {
+                break;
+            }
+            if (line[0] == '#') {
+                continue;
+            }
+
+            // Key/value pairs ("key:=value") are free form metadata
+            std::size_t separator = line.find(": ");
+            if (separator == std::string::npos) {
+                continue;
+            }
+
+            std::string key = ToLower(line.substr(0, separator));
+            std::string value = Trim(line.substr(separator + 2));
+            std::istringstream values(value);
+
+            if (key == "type") {
+                if (!ParseSampleType(value, header.sampleType)) {
+                    error = "unsupported sample type '" + value + "'";
+                    return false;
+                }
+                haveType = true;
+            } else if (key == "dimension") {
+                values >> dimension;
+            } else if (key == "sizes") {
+                haveSizes = static_cast<bool>(values >> header.width >> header.height >> header.depth);
+            } else if (key == "encoding") {
+                if (ToLower(value) != "raw") {
+                    error = "unsupported encoding '" + value + "', only raw data can be streamed";
+                    return false;
+                }
+            } else if (key == "endian") {
+                header.bigEndian = ToLower(value) == "big";
+            } else if (key == "spacings") {
+                values >> header.spacing.x >> header.spacing.y >> header.spacing.z;
+            } else if (key == "space directions") {
+                std::vector<float> lengths = VectorLengths(value);
+                if (lengths.size() == 3) {
+                    header.spacing = { lengths[0], lengths[1], lengths[2] };
+                }
+            } else if (key == "space origin") {
+                std::string components = value;
+                std::replace_if(components.begin(), components.end(), [](char c) { return c == '(' || c == ')' || c == ','; }, ' ');
+                std::istringstream origin(components);
+                origin >> header.origin.x >> header.origin.y >> header.origin.z;
+            } else if (key == "byte skip") {
+                long long skip = 0;
+                values >> skip;
+                if (skip < 0) {
+                    error = "byte skip -1 is not supported";
+                    return false;
+                }
+                byteSkip = static_cast<std::uint64_t>(skip);
+            } else if (key == "data file" || key == "datafile") {
+                dataFile = value;
+            }
+        }
+
+        if (dimension != 3 || !haveSizes || !haveType) {
+            error = "NRRD header must give type, dimension 3 and sizes";
+            return false;
+        }
+
+        if (dataFile.empty()) {
+            // Attached data starts right after the blank line ending the header
+            header.dataFile = path;
+            header.dataOffset = static_cast<std::uint64_t>(stream.tellg()) + byteSkip;
+        } else {
+            // Detached data is found relative to the header
+            std::filesystem::path dataPath(dataFile);
+            if (dataPath.is_relative()) {
+                dataPath = std::filesystem::path(path).parent_path() / dataPath;
+            }
+            header.dataFile = dataPath.string();
+            header.dataOffset = byteSkip;
+        }
+        return true;
+    }
+
+    bool ReadVtkHeader(std::ifstream &stream, const std::string &path, VolumeHeader &header, std::string &error) {
+        std::string line;
+        std::getline(stream, line);     // Title
+
+        std::getline(stream, line);
+        if (ToLower(Trim(line)) != "binary") {
+            error = "only BINARY VTK files are supported";
+            return false;
+        }
+
+        // Legacy VTK binary data is always big endian
+        header.bigEndian = true;
+
+        bool haveDimensions = false;
+        bool haveScalars = false;
+        while (std::getline(stream, line)) {
+            std::istringstream values(line);
+            std::string keyword;
+            values >> keyword;
+            keyword = ToLower(keyword);
+
+            if (keyword == "dataset") {
+                std::string type;
+                values >> type;
+                if (ToLower(type) != "structured_points") {
+                    error = "unsupported dataset '" + type + "', only STRUCTURED_POINTS is supported";
+                    return false;
+                }
+            } else if (keyword == "dimensions") {
+                haveDimensions = static_cast<bool>(values >> header.width >> header.height >> header.depth);
+            } else if (keyword == "spacing" || keyword == "aspect_ratio") {
+                values >> header.spacing.x >> header.spacing.y >> header.spacing.z;
+            } else if (keyword == "origin") {
+                values >> header.origin.x >> header.origin.y >> header.origin.z;
+            } else if (keyword == "scalars") {
+                std::string name, type;
+                int components = 1;
+                values >> name >> type >> components;
+                if (!ParseSampleType(type, header.sampleType)) {
+                    error = "unsupported scalar type '" + type + "'";
+                    return false;
+                }
+                if (components != 1) {
+                    error = "only single component scalars are supported";
+                    return false;
+                }
+                haveScalars = true;
+            } else if (keyword == "lookup_table") {
+                // The samples follow this line
+                break;
+            }
+        }
+
+        if (!haveDimensions || !haveScalars || !stream) {
+            error = "VTK file must give DIMENSIONS, SCALARS and LOOKUP_TABLE";
+            return false;
+        }
+
+        header.dataFile = path;
+        header.dataOffset = static_cast<std::uint64_t>(stream.tellg());
+        return true;
+    }
+}
+
+int VolumeHeader::SampleBytes() const {
+    switch (sampleType) {
+        case VolumeSampleType::UInt8: return 1;
+        case VolumeSampleType::UInt16: return 2;
+        case VolumeSampleType::Float32: return 4;
+    }
+    return 1;
+}
+
+bool ReadVolumeHeader(const std::string &path, VolumeHeader &header, std::string &error) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        error = "cannot open '" + path + "'";
+        return false;
+    }
+
+    header = VolumeHeader();
+
+    std::string magic;
+    std::getline(stream, magic);
+    magic = Trim(magic);
+
+    bool parsed;
+    if (magic.rfind("NRRD", 0) == 0) {
+        parsed = ReadNrrdHeader(stream, path, header, error);
+    } else if (ToLower(magic).rfind("# vtk datafile", 0) == 0) {
+        parsed = ReadVtkHeader(stream, path, header, error);
+    } else {
+        error = "'" + path + "' is neither an NRRD nor a VTK file";
+        return false;
+    }
+
+    if (parsed && (header.width <= 0 || header.height <= 0 || header.depth <= 0)) {
+        error = "volume has no samples";
+        return false;
+    }
+    return parsed;
+}
+
+VolumeReader::~VolumeReader() {
+    Close();
+}
+
+bool VolumeReader::Open(const std::string &path) {
+    VolumeHeader parsed;
+    if (!ReadVolumeHeader(path, parsed, error)) {
+        return false;
+    }
+    return Open(parsed);
+}
+
+bool VolumeReader::Open(const VolumeHeader &volumeHeader) {
+    Close();
+
+    header = volumeHeader;
+    file = std::fopen(header.dataFile.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open data file '" + header.dataFile + "'";
+        return false;
+    }
+
+    streamBuffer.resize(STREAM_BUFFER_BYTES);
+    std::setvbuf(file, streamBuffer.data(), _IOFBF, streamBuffer.size());
+
+    filePosition = ~std::uint64_t(0);
+    return true;
+}
+
+void VolumeReader::Close() {
+    if (file != nullptr) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+void VolumeReader::SetDensityMapping(float scale, float offset) {
+    densityScale = scale;
+    densityOffset = offset;
+}
+
+bool VolumeReader::ReadSlab(int z, float *densities) {
+    if (z < 0 || z >= header.depth) {
+        error = "slab out of range";
+        return false;
+    }
+    return ReadSamples(static_cast<std::uint64_t>(z) * header.SlabSamples(), header.SlabSamples(), densities);
+}
+
+bool VolumeReader::ReadChunk(ChunkCoord coord, Chunk &chunk) {
+    chunk.coord = coord;
+
+    int x0 = coord.x * CHUNK_SIZE;
+    int readStart = std::clamp(x0, 0, header.width - 1);
+    int readEnd = std::clamp(x0 + CHUNK_SIZE, 0, header.width - 1);
+    int readCount = readEnd - readStart + 1;
+
+    std::vector<float> row(readCount);
+    for (int z = 0; z < CHUNK_SAMPLES; z++) {
+        int vz = std::clamp(coord.z * CHUNK_SIZE + z, 0, header.depth - 1);
+        for (int y = 0; y < CHUNK_SAMPLES; y++) {
+            int vy = std::clamp(coord.y * CHUNK_SIZE + y, 0, header.height - 1);
+
+            std::uint64_t first = (static_cast<std::uint64_t>(vz) * header.height + vy) * header.width + readStart;
+            if (!ReadSamples(first, row.size(), row.data())) {
+                return false;
+            }
+
+            float *out = chunk.densities.data() + Chunk::Index(0, y, z);
+            for (int x = 0; x < CHUNK_SAMPLES; x++) {
+                out[x] = row[std::clamp(x0 + x, 0, header.width - 1) - readStart];
+            }
+        }
+    }
+
+    chunk.UpdateBounds();
+    return true;
+}
+
+bool VolumeReader::ReadSamples(std::uint64_t first, std::size_t count, float *densities) {
+    if (file == nullptr) {
+        error = "no volume open";
+        return false;
+    }
+
+    const int sampleBytes = header.SampleBytes();
+    std::uint64_t offset = header.dataOffset + first * sampleBytes;
+
+    // Sequential reads continue where the last one stopped, anything else seeks
+    if (offset != filePosition && !Seek(file, offset)) {
+        filePosition = ~std::uint64_t(0);
+        error = "seek failed in '" + header.dataFile + "'";
+        return false;
+    }
+
+    readBuffer.resize(count * sampleBytes);
+    if (std::fread(readBuffer.data(), 1, readBuffer.size(), file) != readBuffer.size()) {
+        filePosition = ~std::uint64_t(0);
+        error = "unexpected end of '" + header.dataFile + "'";
+        return false;
+    }
+    filePosition = offset + readBuffer.size();
+
+    const bool swap = header.bigEndian != (std::endian::native == std::endian::big);
+    const unsigned char *bytes = readBuffer.data();
+
+    switch (header.sampleType) {
+        case VolumeSampleType::UInt8:
+            for (std::size_t i = 0; i < count; i++) {
+                densities[i] = bytes[i] * densityScale + densityOffset;
+            }
+            break;
+
+        case VolumeSampleType::UInt16:
+            for (std::size_t i = 0; i < count; i++) {
+                std::uint16_t value;
+                std::memcpy(&value, bytes + i * 2, 2);
+                if (swap) {
+                    value = static_cast<std::uint16_t>(value << 8 | value >> 8);
+                }
+                densities[i] = value * densityScale + densityOffset;
+            }
+            break;
+
+        case VolumeSampleType::Float32:
+            for (std::size_t i = 0; i < count; i++) {
+                std::uint32_t bits;
+                std::memcpy(&bits, bytes + i * 4, 4);
+                if (swap) {
+                    bits = (bits << 24) | ((bits << 8) & 0x00ff0000u) | ((bits >> 8) & 0x0000ff00u) | (bits >> 24);
+                }
+                densities[i] = std::bit_cast<float>(bits) * densityScale + densityOffset;
+            }
+            break;
+    }
+
+    return true;
+}
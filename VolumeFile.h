@@ -0,0 +1,99 @@
+#ifndef VOLUMEFILE_H
+#define VOLUMEFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+
+// Scanned or simulated volumes stored on disk as a plain grid of samples, like CT and MRI data.
+// The samples are described by a header: an NRRD header (.nrrd, or a detached .nhdr next to a .raw file),
+// a legacy VTK STRUCTURED_POINTS file, or a VolumeHeader filled in by hand for a headerless raw file.
+// Only raw (uncompressed) encodings of 8 and 16 bit unsigned and 32 bit float samples are supported.
+
+enum class VolumeSampleType {
+    UInt8,
+    UInt16,
+    Float32
+};
+
+struct VolumeHeader {
+    // Samples along each axis, x-major like Chunk::densities: x varies fastest, then y, then z
+    int width = 0;
+    int height = 0;
+    int depth = 0;
+
+    VolumeSampleType sampleType = VolumeSampleType::UInt8;
+    bool bigEndian = false;
+
+    // Distance between samples along each axis, and the position of the first sample
+    Vector3 spacing = { 1.0f, 1.0f, 1.0f };
+    Vector3 origin = { 0.0f, 0.0f, 0.0f };
+
+    // File holding the samples, which may be the header file itself, and where in it they start
+    std::string dataFile;
+    std::uint64_t dataOffset = 0;
+
+    int SampleBytes() const;
+    std::uint64_t SlabSamples() const { return static_cast<std::uint64_t>(width) * height; }
+};
+
+// Parse the header of a volume file, detecting NRRD and VTK by their first line.
+// Returns false and sets error if the file cannot be read or describes an unsupported volume.
+bool ReadVolumeHeader(const std::string &path, VolumeHeader &header, std::string &error);
+
+// Reads the samples of a volume a slab at a time, so volumes far larger than memory can be processed.
+// Reads are buffered and sequential slabs are read without seeking.
+class VolumeReader {
+public:
+    VolumeReader() = default;
+    ~VolumeReader();
+    VolumeReader(const VolumeReader &) = delete;
+    VolumeReader &operator=(const VolumeReader &) = delete;
+
+    // Open a volume by its header file
+    bool Open(const std::string &path);
+
+    // Open a raw volume described in code
+    bool Open(const VolumeHeader &header);
+
+    void Close();
+
+    const VolumeHeader &GetHeader() const { return header; }
+
+    // Why the last Open or read failed
+    const std::string &GetError() const { return error; }
+
+    // Samples are turned into densities as sample * scale + offset.
+    // Densities below the isoLevel are inside, while scans are usually brighter inside, so a scale of -1
+    // with the isoLevel set to minus the threshold value extracts the bright tissue.
+    void SetDensityMapping(float scale, float offset);
+
+    // Read the width * height densities of slab z
+    bool ReadSlab(int z, float *densities);
+
+    // Fill a chunk with the samples of the volume starting at coord * CHUNK_SIZE, so the chunk based
+    // extraction can be used on volumes that fit in memory. Samples past the edge of the volume repeat the edge.
+    bool ReadChunk(ChunkCoord coord, Chunk &chunk);
+
+private:
+    // Read count consecutive samples starting at the given sample index and convert them to densities
+    bool ReadSamples(std::uint64_t first, std::size_t count, float *densities);
+
+    VolumeHeader header;
+    std::string error;
+
+    std::FILE *file = nullptr;
+    std::uint64_t filePosition = 0;
+    std::vector<char> streamBuffer;
+    std::vector<unsigned char> readBuffer;
+
+    float densityScale = 1.0f;
+    float densityOffset = 0.0f;
+};
+
+#endif // VOLUMEFILE_H
@@ -0,0 +1,363 @@
+#include "VolumeRaycaster.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <raymath.h>
+
+#include "DensityPyramid.h"
+
+namespace {
+    // Number of regula falsi iterations used to refine a hit inside a cell
+    constexpr int ROOT_ITERATIONS = 8;
+
+    // Pyramid level whose cells a ray crosses between chunks and bricks, 8 cells or 2 bricks wide
+    constexpr int BLOCK_LEVEL = 3;
+    static_assert((1 << BLOCK_LEVEL) % BRICK_SIZE == 0, "blocks are made of whole bricks");
+
+    // Rays per task when a batch is split over a TaskSystem
+    constexpr int RAYS_PER_TASK = 1024;
+
+    // Remembers the last chunk that was looked up.
+    // Coherent rays in a batch mostly start in the same chunk.
+    struct ChunkCache {
+        ChunkCoord coord { std::numeric_limits<int>::min(), 0, 0 };
+        const Chunk *chunk = nullptr;
+
+        const Chunk *Find(const VoxelWorld &world, ChunkCoord target) {
+            if (!(target == coord)) {
+                coord = target;
+                chunk = world.FindChunk(target);
+            }
+            return chunk;
+        }
+    };
+
+    // Incremental 3D-DDA through a grid of cubes size wide, cell 0 starting at gridOrigin.
+    // tMax is the distance along the ray to the next cell boundary on each axis and tDelta the distance between
+    // boundaries, so stepping to the next cell is one comparison and one addition.
+    struct GridWalk {
+        int cell[3];
+        int step[3];
+        float tMax[3];
+        float tDelta[3];
+
+        // Start in the cell holding the point at distance t along the ray. With a limit, cells are clamped to
+        // 0 to limit - 1, as a point on the boundary of the parent grid's cell may round to just outside it.
+        GridWalk(Vector3 origin, Vector3 direction, float t, Vector3 gridOrigin, float size, int limit = 0) {
+            const float o[3] = { origin.x, origin.y, origin.z };
+            const float d[3] = { direction.x, direction.y, direction.z };
+            const float g[3] = { gridOrigin.x, gridOrigin.y, gridOrigin.z };
+
+            for (int axis = 0; axis < 3; axis++) {
+                int c = static_cast<int>(std::floor((o[axis] + d[axis] * t - g[axis]) / size));
+                cell[axis] = limit > 0 ? std::clamp(c, 0, limit - 1) : c;
+
+                if (d[axis] > 0.0f) {
+                    step[axis] = 1;
+                    tDelta[axis] = size / d[axis];
+                    tMax[axis] = (g[axis] + (cell[axis] + 1) * size - o[axis]) / d[axis];
+                } else if (d[axis] < 0.0f) {
+                    step[axis] = -1;
+                    tDelta[axis] = -size / d[axis];
+                    tMax[axis] = (g[axis] + cell[axis] * size - o[axis]) / d[axis];
+                } else {
+                    step[axis] = 0;
+                    tDelta[axis] = std::numeric_limits<float>::infinity();
+                    tMax[axis] = std::numeric_limits<float>::infinity();
+                }
+            }
+        }
+
+        // Distance at which the ray leaves the current cell
+        float Exit() const { return std::min({ tMax[0], tMax[1], tMax[2] }); }
+
+        // Step into the next cell along the ray
+        void Advance() {
+            int axis = tMax[0] <= tMax[1] ? (tMax[0] <= tMax[2] ? 0 : 2) : (tMax[1] <= tMax[2] ? 1 : 2);
+            cell[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+
+        bool Inside(int limit) const {
+            return cell[0] >= 0 && cell[0] < limit && cell[1] >= 0 && cell[1] < limit && cell[2] >= 0 && cell[2] < limit;
+        }
+    };
+
+    // The eight corner densities of a cell, ordered by x + 2y + 4z
+    struct CellCorners {
+        std::array<float, 8> d;
+
+        CellCorners(const Chunk &chunk, int x, int y, int z) {
+            d[0] = chunk.At(x, y, z);
+            d[1] = chunk.At(x + 1, y, z);
+            d[2] = chunk.At(x, y + 1, z);
+            d[3] = chunk.At(x + 1, y + 1, z);
+            d[4] = chunk.At(x, y, z + 1);
+            d[5] = chunk.At(x + 1, y, z + 1);
+            d[6] = chunk.At(x, y + 1, z + 1);
+            d[7] = chunk.At(x + 1, y + 1, z + 1);
+        }
+
+        // Analytic gradient of the trilinear interpolation, in cell local units
+        Vector3 Gradient(float u, float v, float w) const {
+            float dx = (1 - v) * (1 - w) * (d[1] - d[0]) + v * (1 - w) * (d[3] - d[2]) +
+                       (1 - v) * w * (d[5] - d[4]) + v * w * (d[7] - d[6]);
+            float dy = (1 - u) * (1 - w) * (d[2] - d[0]) + u * (1 - w) * (d[3] - d[1]) +
+                       (1 - u) * w * (d[6] - d[4]) + u * w * (d[7] - d[5]);
+            float dz = (1 - u) * (1 - v) * (d[4] - d[0]) + u * (1 - v) * (d[5] - d[1]) +
+                       (1 - u) * v * (d[6] - d[2]) + u * v * (d[7] - d[3]);
+            return { dx, dy, dz };
+        }
+    };
+
+    // The trilinear density less the isoLevel along a ray through a cell, as the cubic c[0] + c[1] s + c[2] s^2 + c[3] s^3
+    // in the distance s from where the ray enters. start is the entry point and rate the ray direction, both in
+    // cell local units.
+    struct CellCubic {
+        float c[4];
+
+        CellCubic(const CellCorners &corners, float isoLevel, Vector3 start, Vector3 rate) {
+            const std::array<float, 8> &d = corners.d;
+            float k0 = d[0] - isoLevel;
+            float kx = d[1] - d[0], ky = d[2] - d[0], kz = d[4] - d[0];
+            float kxy = d[3] - d[2] - d[1] + d[0];
+            float kxz = d[5] - d[4] - d[1] + d[0];
+            float kyz = d[6] - d[4] - d[2] + d[0];
+            float kxyz = d[7] - d[6] - d[5] + d[4] - d[3] + d[2] + d[1] - d[0];
+
+            float u = start.x, v = start.y, w = start.z;
+            float a = rate.x, b = rate.y, e = rate.z;
+            c[0] = k0 + kx * u + ky * v + kz * w + kxy * u * v + kxz * u * w + kyz * v * w + kxyz * u * v * w;
+            c[1] = kx * a + ky * b + kz * e + kxy * (u * b + v * a) + kxz * (u * e + w * a) + kyz * (v * e + w * b) +
+                   kxyz * (u * v * e + u * w * b + v * w * a);
+            c[2] = kxy * a * b + kxz * a * e + kyz * b * e + kxyz * (u * b * e + v * a * e + w * a * b);
+            c[3] = kxyz * a * b * e;
+        }
+
+        float operator()(float s) const { return c[0] + s * (c[1] + s * (c[2] + s * c[3])); }
+
+        // The first distance in [0, length] where the cubic drops below zero, or a negative value if it does not.
+        // Between its extrema the cubic is monotonic, so splitting the segment there brackets every crossing,
+        // even one where the surface enters and leaves the cell between two samples.
+        float FirstCrossing(float length) const {
+            float points[4] = { 0.0f, 0.0f, 0.0f, length };
+            int count = 1;
+
+            // Roots of the derivative c[1] + 2 c[2] s + 3 c[3] s^2 inside the segment, in order
+            float qa = 3.0f * c[3], qb = 2.0f * c[2], qc = c[1];
+            float roots[2];
+            int rootCount = 0;
+            if (std::abs(qa) > 1e-12f) {
+                float discriminant = qb * qb - 4.0f * qa * qc;
+                if (discriminant > 0.0f) {
+                    // The form that avoids cancellation between qb and the square root
+                    float q = -0.5f * (qb + std::copysign(std::sqrt(discriminant), qb));
+                    roots[rootCount++] = q / qa;
+                    if (q != 0.0f) {
+                        roots[rootCount++] = qc / q;
+                    }
+                }
+            } else if (qb != 0.0f) {
+                roots[rootCount++] = -qc / qb;
+            }
+            if (rootCount == 2 && roots[1] < roots[0]) {
+                std::swap(roots[0], roots[1]);
+            }
+            for (int i = 0; i < rootCount; i++) {
+                if (roots[i] > 0.0f && roots[i] < length) {
+                    points[count++] = roots[i];
+                }
+            }
+            points[count++] = length;
+
+            float a = 0.0f;
+            float fa = (*this)(a);
+            if (fa < 0.0f) {
+                return 0.0f;
+            }
+            for (int i = 1; i < count; i++) {
+                float b = points[i];
+                float fb = (*this)(b);
+                if (fb < 0.0f) {
+                    // The piece is monotonic and crosses once, refine with regula falsi. The Illinois variant halves
+                    // the value at an end kept twice in a row, so a curved piece cannot pin one end in place.
+                    int side = 0;
+                    for (int iteration = 0; iteration < ROOT_ITERATIONS; iteration++) {
+                        float m = a + (b - a) * fa / (fa - fb);
+                        float fm = (*this)(m);
+                        if (fm < 0.0f) {
+                            b = m;
+                            fb = fm;
+                            fa = side == -1 ? fa * 0.5f : fa;
+                            side = -1;
+                        } else {
+                            a = m;
+                            fa = fm;
+                            fb = side == 1 ? fb * 0.5f : fb;
+                            side = 1;
+                        }
+                    }
+                    return a + (b - a) * fa / (fa - fb);
+                }
+                a = b;
+                fa = fb;
+            }
+            return -1.0f;
+        }
+    };
+}
+
+VolumeRaycaster::VolumeRaycaster(const VoxelWorld &world, float isoLevel) : world(world), isoLevel(isoLevel) {
+}
+
+RayCollision VolumeRaycaster::CastRay(Ray ray, float maxDistance) const {
+    RayCollision results[1];
+    CastRays(&ray, 1, maxDistance, results);
+    return results[0];
+}
+
+void VolumeRaycaster::CastRays(const Ray *rays, int count, float maxDistance, RayCollision *results, TaskSystem *tasks) const {
+    if (tasks == nullptr || count <= RAYS_PER_TASK) {
+        CastRange(rays, count, maxDistance, results);
+        return;
+    }
+
+    int parts = (count + RAYS_PER_TASK - 1) / RAYS_PER_TASK;
+    tasks->Wait(tasks->ParallelFor(count, parts, [&](int, int begin, int end) {
+        CastRange(rays + begin, end - begin, maxDistance, results + begin);
+    }));
+}
+
+void VolumeRaycaster::CastRange(const Ray *rays, int count, float maxDistance, RayCollision *results) const {
+    const float voxelSize = world.GetVoxelSize();
+    const float chunkWorldSize = world.GetChunkWorldSize();
+    const float brickWorldSize = voxelSize * BRICK_SIZE;
+    const Vector3 gridOrigin = world.GetChunkOrigin({ 0, 0, 0 });
+
+    ChunkCache cache;
+
+    for (int rayIndex = 0; rayIndex < count; rayIndex++) {
+        RayCollision &result = results[rayIndex];
+        result = { false, 0.0f, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+
+        const Vector3 origin = rays[rayIndex].position;
+        const Vector3 direction = Vector3Normalize(rays[rayIndex].direction);
+        if (Vector3LengthSqr(direction) == 0.0f) {
+            continue;
+        }
+
+        auto insideAt = [&](float distance) {
+            result = { true, distance, Vector3Add(origin, Vector3Scale(direction, distance)), Vector3Negate(direction) };
+        };
+
+        // Walk chunks, then the blocks of a chunk that may hold the surface, then the bricks of such a block, then
+        // the cells of such a brick.
+        // Each level is entered at the distance its parent was, and leaves at its parent's exit at the latest.
+        float t = 0.0f;
+        for (GridWalk chunks(origin, direction, t, gridOrigin, chunkWorldSize); t < maxDistance && !result.hit; chunks.Advance()) {
+            ChunkCoord coord = { chunks.cell[0], chunks.cell[1], chunks.cell[2] };
+            float chunkExit = std::min(chunks.Exit(), maxDistance);
+
+            const Chunk *chunk = cache.Find(world, coord);
+            if (chunk != nullptr && chunk->maxDensity < isoLevel) {
+                // Entirely inside the surface, so the ray started inside it
+                insideAt(t);
+                break;
+            }
+
+            if (chunk == nullptr || !chunk->Straddles(isoLevel)) {
+                t = std::max(t, chunkExit);
+                continue;
+            }
+
+            // A chunk with a pyramid is crossed in blocks of one of its levels first, so a long ray steps over the
+            // empty space between the surface and the chunk's faces a block at a time. Otherwise it is one block.
+            Vector3 chunkOrigin = world.GetChunkOrigin(coord);
+            const DensityPyramid *pyramid = chunk->pyramid.get();
+            const int blocksPerChunk = pyramid != nullptr ? DensityPyramid::CellsPerAxis(BLOCK_LEVEL) : 1;
+            const int bricksPerBlock = BRICKS_PER_CHUNK / blocksPerChunk;
+            const float blockWorldSize = chunkWorldSize / blocksPerChunk;
+
+            for (GridWalk blocks(origin, direction, t, chunkOrigin, blockWorldSize, blocksPerChunk);
+                 blocks.Inside(blocksPerChunk) && t < chunkExit && !result.hit; blocks.Advance()) {
+                float blockExit = std::min(blocks.Exit(), chunkExit);
+                if (pyramid != nullptr) {
+                    if (pyramid->CellMax(BLOCK_LEVEL, blocks.cell[0], blocks.cell[1], blocks.cell[2]) < isoLevel) {
+                        insideAt(t);
+                        break;
+                    }
+                    if (!pyramid->CellStraddles(BLOCK_LEVEL, blocks.cell[0], blocks.cell[1], blocks.cell[2], isoLevel)) {
+                        t = std::max(t, blockExit);
+                        continue;
+                    }
+                }
+
+                Vector3 blockMin = { chunkOrigin.x + blocks.cell[0] * blockWorldSize, chunkOrigin.y + blocks.cell[1] * blockWorldSize,
+                                     chunkOrigin.z + blocks.cell[2] * blockWorldSize };
+                for (GridWalk bricks(origin, direction, t, blockMin, brickWorldSize, bricksPerBlock);
+                     bricks.Inside(bricksPerBlock) && t < blockExit && !result.hit; bricks.Advance()) {
+                    float brickExit = std::min(bricks.Exit(), blockExit);
+                    int bx = blocks.cell[0] * bricksPerBlock + bricks.cell[0];
+                    int by = blocks.cell[1] * bricksPerBlock + bricks.cell[1];
+                    int bz = blocks.cell[2] * bricksPerBlock + bricks.cell[2];
+                    int brickIndex = Chunk::BrickIndex(bx, by, bz);
+                    if (chunk->brickMax[brickIndex] < isoLevel) {
+                        insideAt(t);
+                        break;
+                    }
+
+                    if (!chunk->BrickStraddles(brickIndex, isoLevel)) {
+                        t = std::max(t, brickExit);
+                        continue;
+                    }
+
+                    Vector3 brickMin = { chunkOrigin.x + bx * brickWorldSize, chunkOrigin.y + by * brickWorldSize,
+                                         chunkOrigin.z + bz * brickWorldSize };
+                    for (GridWalk cells(origin, direction, t, brickMin, voxelSize, BRICK_SIZE);
+                         cells.Inside(BRICK_SIZE) && t < brickExit; cells.Advance()) {
+                        float cellExit = std::max(std::min(cells.Exit(), brickExit), t);
+                        int cx = bx * BRICK_SIZE + cells.cell[0];
+                        int cy = by * BRICK_SIZE + cells.cell[1];
+                        int cz = bz * BRICK_SIZE + cells.cell[2];
+                        CellCorners corners(*chunk, cx, cy, cz);
+
+                        // The trilinear density lies between the lowest and highest corner, so most cells are decided here
+                        auto [low, high] = std::minmax_element(corners.d.begin(), corners.d.end());
+                        if (*high < isoLevel) {
+                            insideAt(t);
+                            break;
+                        }
+                        if (*low >= isoLevel) {
+                            t = cellExit;
+                            continue;
+                        }
+
+                        Vector3 cellMin = { chunkOrigin.x + cx * voxelSize, chunkOrigin.y + cy * voxelSize, chunkOrigin.z + cz * voxelSize };
+                        Vector3 entry = Vector3Add(origin, Vector3Scale(direction, t));
+                        Vector3 start = Vector3Scale(Vector3Subtract(entry, cellMin), 1.0f / voxelSize);
+                        CellCubic cubic(corners, isoLevel, start, Vector3Scale(direction, 1.0f / voxelSize));
+
+                        float crossing = cubic.FirstCrossing(cellExit - t);
+                        if (crossing >= 0.0f) {
+                            result.hit = true;
+                            result.distance = t + crossing;
+                            result.point = Vector3Add(origin, Vector3Scale(direction, result.distance));
+                            result.normal = Vector3Normalize(corners.Gradient(
+                                std::clamp((result.point.x - cellMin.x) / voxelSize, 0.0f, 1.0f),
+                                std::clamp((result.point.y - cellMin.y) / voxelSize, 0.0f, 1.0f),
+                                std::clamp((result.point.z - cellMin.z) / voxelSize, 0.0f, 1.0f)));
+                            break;
+                        }
+                        t = cellExit;
+                    }
+                    t = std::max(t, brickExit);
+                }
+                t = std::max(t, blockExit);
+            }
+            t = std::max(t, chunkExit);
+        }
+    }
+}
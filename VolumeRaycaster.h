@@ -0,0 +1,37 @@
+#ifndef VOLUMERAYCASTER_H
+#define VOLUMERAYCASTER_H
+
+#include <raylib.h>
+
+#include "TaskSystem.h"
+#include "VoxelWorld.h"
+
+// Casts rays directly against the density samples of a VoxelWorld.
+// Used for picking, camera collision and digging.
+//
+// Rays are traversed through the chunk grid, then the DensityPyramid blocks, bricks and cells of a chunk, each
+// with an incremental 3D-DDA, skipping any whose min/max range cannot contain the isosurface.
+// Inside a candidate cell the trilinear density is a cubic along the ray. It is split at its extrema, so
+// every crossing is bracketed, and the first one refined by root-finding, so no triangles are needed.
+class VolumeRaycaster {
+public:
+    explicit VolumeRaycaster(const VoxelWorld &world, float isoLevel = 0.0f);
+
+    // Returns the first point along the ray where the density drops below the isoLevel.
+    // A ray starting inside the surface hits at distance 0.
+    // The normal is the normalized density gradient at the hit point.
+    RayCollision CastRay(Ray ray, float maxDistance) const;
+
+    // Cast a batch of rays. results must have room for count entries.
+    // Large batches are split over the workers of tasks and the calling thread, or run on the calling thread
+    // alone if tasks is null. The world must not change until the call returns.
+    void CastRays(const Ray *rays, int count, float maxDistance, RayCollision *results, TaskSystem *tasks = nullptr) const;
+
+private:
+    void CastRange(const Ray *rays, int count, float maxDistance, RayCollision *results) const;
+
+    const VoxelWorld &world;
+    float isoLevel;
+};
+
+#endif // VOLUMERAYCASTER_H
@@ -0,0 +1,99 @@
+#include "VoxelWorld.h"
+
+#include <cmath>
+
+#include "DensityPyramid.h"
+#include "Profiler.h"
+
+std::atomic<std::uint64_t> VoxelWorld::nextVersion { 1 };
+
+VoxelWorld::VoxelWorld(float voxelSize) : voxelSize(voxelSize), version(nextVersion++) {
+}
+
+Chunk &VoxelWorld::GenerateChunk(ChunkCoord coord, const DensityField &field) {
+    return InsertChunk(SampleChunk(coord, field));
+}
+
+std::unique_ptr<Chunk> VoxelWorld::SampleChunk(ChunkCoord coord, const DensityField &field) const {
+    PROFILE_SCOPE(ProfileZone::DensityFill);
+
+    auto chunk = std::make_unique<Chunk>();
+    chunk->coord = coord;
+    chunk->seed = ChunkSeed(field.GetSeed(), coord);
+
+    field.SampleBlock(GetChunkOrigin(coord), voxelSize, CHUNK_SAMPLES, chunk->densities.data());
+    chunk->UpdateBounds();
+
+    // A chunk of a single value is skipped or hit as a whole, and has no use for finer levels
+    if (chunk->minDensity < chunk->maxDensity) {
+        auto pyramid = std::make_shared<DensityPyramid>();
+        pyramid->Update(*chunk);
+        chunk->pyramid = std::move(pyramid);
+    }
+    return chunk;
+}
+
+Chunk &VoxelWorld::InsertChunk(std::unique_ptr<Chunk> chunk) {
+    std::unique_ptr<Chunk> &slot = chunks[chunk->coord];
+    slot = std::move(chunk);
+    version = nextVersion++;
+    return *slot;
+}
+
+void VoxelWorld::UnloadChunk(ChunkCoord coord) {
+    if (chunks.erase(coord) > 0) {
+        version = nextVersion++;
+    }
+}
+
+const Chunk *VoxelWorld::FindChunk(ChunkCoord coord) const {
+    auto it = chunks.find(coord);
+    if (it == chunks.end()) {
+        return nullptr;
+    }
+
+    return it->second.get();
+}
+
+Vector3 VoxelWorld::GetChunkOrigin(ChunkCoord coord) const {
+    float chunkWorldSize = GetChunkWorldSize();
+    return { coord.x * chunkWorldSize, coord.y * chunkWorldSize, coord.z * chunkWorldSize };
+}
+
+ChunkCoord VoxelWorld::WorldToChunk(Vector3 position) const {
+    float chunkWorldSize = GetChunkWorldSize();
+    return {
+        static_cast<int>(std::floor(position.x / chunkWorldSize)),
+        static_cast<int>(std::floor(position.y / chunkWorldSize)),
+        static_cast<int>(std::floor(position.z / chunkWorldSize))
+    };
+}
+
+std::optional<float> VoxelWorld::SampleDensity(Vector3 position) const {
+    ChunkCoord coord = WorldToChunk(position);
+    const Chunk *chunk = FindChunk(coord);
+    if (chunk == nullptr) {
+        return std::nullopt;
+    }
+
+    Vector3 origin = GetChunkOrigin(coord);
+    return chunk->SampleTrilinear((position.x - origin.x) / voxelSize,
+                                  (position.y - origin.y) / voxelSize,
+                                  (position.z - origin.z) / voxelSize);
+}
+
+std::optional<Vector3> VoxelWorld::SampleGradient(Vector3 position) const {
+    std::optional<float> px = SampleDensity({ position.x + voxelSize, position.y, position.z });
+    std::optional<float> nx = SampleDensity({ position.x - voxelSize, position.y, position.z });
+    std::optional<float> py = SampleDensity({ position.x, position.y + voxelSize, position.z });
+    std::optional<float> ny = SampleDensity({ position.x, position.y - voxelSize, position.z });
+    std::optional<float> pz = SampleDensity({ position.x, position.y, position.z + voxelSize });
+    std::optional<float> nz = SampleDensity({ position.x, position.y, position.z - voxelSize });
+
+    if (!px || !nx || !py || !ny || !pz || !nz) {
+        return std::nullopt;
+    }
+
+    float scale = 1.0f / (2.0f * voxelSize);
+    return Vector3 { (*px - *nx) * scale, (*py - *ny) * scale, (*pz - *nz) * scale };
+}
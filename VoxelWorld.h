@@ -0,0 +1,69 @@
+#ifndef VOXELWORLD_H
+#define VOXELWORLD_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include <raylib.h>
+
+#include "Chunk.h"
+#include "DensityField.h"
+
+// Owns the chunks of density samples that make up the world.
+// Chunks are stored sparsely, so the world can grow in any direction.
+class VoxelWorld {
+public:
+    using ChunkMap = std::unordered_map<ChunkCoord, std::unique_ptr<Chunk>, ChunkCoordHash>;
+
+    explicit VoxelWorld(float voxelSize = 1.0f);
+
+    // Sample the density field for the chunk at the given coordinate and store it.
+    // An existing chunk at the same coordinate is replaced.
+    Chunk &GenerateChunk(ChunkCoord coord, const DensityField &field);
+
+    // Sample a chunk without storing it, and build its DensityPyramid. Only reads the voxel size, so it can
+    // run on any thread while the world is changed on another.
+    std::unique_ptr<Chunk> SampleChunk(ChunkCoord coord, const DensityField &field) const;
+
+    // Store a sampled chunk, replacing any existing chunk at its coordinate
+    Chunk &InsertChunk(std::unique_ptr<Chunk> chunk);
+    void UnloadChunk(ChunkCoord coord);
+
+    // Returns nullptr if the chunk has not been generated
+    const Chunk *FindChunk(ChunkCoord coord) const;
+    const ChunkMap &GetChunks() const { return chunks; }
+
+    // Changes whenever a chunk is generated or unloaded. Versions are unique across all worlds in the process,
+    // so a world created where another was destroyed never repeats one of its versions.
+    // Anything holding on to Chunk pointers must drop them when the version changes.
+    std::uint64_t GetVersion() const { return version; }
+
+    float GetVoxelSize() const { return voxelSize; }
+    float GetChunkWorldSize() const { return voxelSize * CHUNK_SIZE; }
+
+    // World space position of the first sample in the chunk
+    Vector3 GetChunkOrigin(ChunkCoord coord) const;
+
+    // Coordinate of the chunk containing a world space position
+    ChunkCoord WorldToChunk(Vector3 position) const;
+
+    // Trilinearly interpolated density at a world space position.
+    // Returns std::nullopt if the containing chunk has not been generated.
+    std::optional<float> SampleDensity(Vector3 position) const;
+
+    // Density gradient at a world space position, using central differences one voxel apart.
+    // The gradient points away from the inside of the surface.
+    std::optional<Vector3> SampleGradient(Vector3 position) const;
+
+private:
+    float voxelSize;
+    ChunkMap chunks;
+    std::uint64_t version;
+
+    static std::atomic<std::uint64_t> nextVersion;
+};
+
+#endif // VOXELWORLD_H
@@ -1,38 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <unordered_map>
 
 #include <raylib.h>
 #include <raymath.h>
 
 #include "Camera.h"
+#include "ChunkHash.h"
+#include "ChunkScheduler.h"
 #include "CubeMesh.h"
+#include "FixedTimestep.h"
 #include "MarchingCubes.h"
+#include "MeshBufferPool.h"
+#include "Profiler.h"
+#include "TaskSystem.h"
+#include "UploadQueue.h"
+#include "VertexPacking.h"
+#include "VolumeRaycaster.h"
+#include "VoxelWorld.h"
+
+// Store terrain meshes in the packed vertex format, half the size of plain float vertices
+constexpr bool usePackedVertices = true;
+
+// Reorder packed terrain meshes for the GPU's vertex caches before uploading them
+constexpr bool optimizeVertexCache = true;
+
+// Chunks up to this many chunks from the camera's chunk along x and z are generated, and unloaded once more than one past that
+constexpr int viewDistanceChunks = 6;
+
+// Frame rate the game aims for, which uploads are budgeted against
+constexpr int targetFps = 120;
+
+// Steps per second of the simulation, which moves the camera and decides what to stream whatever the frame rate
+constexpr int simulationStepsPerSecond = 60;
+
+// The vertical range of chunks the terrain fits in
+constexpr int lowestChunkY = -1;
+constexpr int highestChunkY = 0;
+
+// A chunk's uploaded mesh, with the bounding sphere used for culling.
+// Packed meshes keep their CPU data alive for DrawMesh and are drawn with the transform that decodes their positions.
+// They go up through the upload queue, and are not drawn until their upload has completed.
+struct ChunkMesh {
+    Mesh mesh;
+    PackedMesh packed;
+    bool isPacked;
+    Matrix transform;
+    Vector3 center;
+    float radius;
+    UploadQueue::UploadId upload = 0;
+};
+
+// Unload a chunk mesh and hand its arrays back to the mesh buffer pool
+void UnloadChunkMesh(ChunkMesh &chunkMesh) {
+    if (chunkMesh.isPacked) {
+        UnloadPackedMesh(chunkMesh.mesh);
+        return;
+    }
+
+    // UnloadMesh frees the CPU arrays itself, so they are released and cleared first
+    MarchingCubes::ReleaseMeshBuffers(chunkMesh.mesh);
+    UnloadMesh(chunkMesh.mesh);
+}
+
+// Bytes of vertex and index data a chunk mesh holds
+std::size_t ChunkMeshBytes(const ChunkMesh &chunkMesh) {
+    if (chunkMesh.isPacked) {
+        return chunkMesh.packed.vertices.size() * sizeof(PackedVertex) + chunkMesh.packed.indices.size() * sizeof(std::uint16_t);
+    }
+    return MarchingCubes::MeshBufferBytes(chunkMesh.mesh);
+}
+
+// Turn a generated chunk's mesh into a GPU mesh: packed and queued for upload, the chunks on screen first,
+// or extracted again straight into the mesh arrays and uploaded at once. Meshes with too many vertices
+// for 16 bit indices fall back to plain float vertices. Returns false if the chunk holds no surface.
+bool UploadChunkMesh(const GeneratedChunk &generated, const Chunk &chunk, const VoxelWorld &world, const MarchingCubes &marchingCubes,
+                     double isoLevel, UploadQueue &uploadQueue, const Camera3D &view, float aspect, ChunkMesh &chunkMesh,
+                     std::size_t &meshBytes) {
+    if (generated.mesh.indices.empty()) {
+        return false;
+    }
 
-// Function to create a standard cube GridCell centered at the origin
-GridCell CreateStandardCube(float size = 1.0f) {
-    GridCell cell;
-
-    // Define the 8 vertices of a cube
-    // Vertex ordering follows standard convention for marching cubes
-    // Bottom face vertices (y = -0.5)
-    cell.vertices[0] = {-size/2, -size/2, -size/2}; // Bottom-left-back
-    cell.vertices[1] = { size/2, -size/2, -size/2}; // Bottom-right-back
-    cell.vertices[2] = { size/2, -size/2,  size/2}; // Bottom-right-front
-    cell.vertices[3] = {-size/2, -size/2,  size/2}; // Bottom-left-front
-
-    // Top face vertices (y = 0.5)
-    cell.vertices[4] = {-size/2,  size/2, -size/2}; // Top-left-back
-    cell.vertices[5] = { size/2,  size/2, -size/2}; // Top-right-back
-    cell.vertices[6] = { size/2,  size/2,  size/2}; // Top-right-front
-    cell.vertices[7] = {-size/2,  size/2,  size/2}; // Top-left-front
-
-    // Initialize densities to 0.0
-    // You'll need to set these values based on your specific application
-    for (int i = 0; i < 8; i++) {
-        cell.densities[i] = 1.0;
+    float halfSize = world.GetChunkWorldSize() * 0.5f;
+    Vector3 origin = world.GetChunkOrigin(chunk.coord);
+    Vector3 center = Vector3Add(origin, { halfSize, halfSize, halfSize });
+    chunkMesh = { {}, {}, false, MatrixIdentity(), center, halfSize * sqrtf(3.0f) };
+
+    if (usePackedVertices) {
+        chunkMesh.isPacked = PackMesh(generated.mesh, origin, world.GetChunkWorldSize(), chunkMesh.packed);
+    }
+
+    if (chunkMesh.isPacked) {
+        chunkMesh.upload = uploadQueue.Enqueue(chunkMesh.packed, ScreenImportance(view, aspect, center, chunkMesh.radius));
+        chunkMesh.transform = PackedMeshTransform(chunkMesh.packed);
+    } else {
+        chunkMesh.mesh = marchingCubes.ExtractChunkMesh(chunk, origin, world.GetVoxelSize(), isoLevel);
+        PROFILE_SCOPE(ProfileZone::Upload);
+        UploadMesh(&chunkMesh.mesh, false);
+    }
+    meshBytes += ChunkMeshBytes(chunkMesh);
+    return true;
+}
+
+// Hash of every generated chunk's densities, in a fixed order whatever order they were generated in
+std::uint64_t HashWorld(const VoxelWorld &world) {
+    std::vector<ChunkCoord> coords;
+    for (const auto &[coord, chunk] : world.GetChunks()) {
+        coords.push_back(coord);
     }
+    std::sort(coords.begin(), coords.end(), [](ChunkCoord a, ChunkCoord b) {
+        return a.z != b.z ? a.z < b.z : a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
 
-    return cell;
+    std::uint64_t hash = 0;
+    for (ChunkCoord coord : coords) {
+        hash = CombineHashes(hash, HashDensities(*world.FindChunk(coord)));
+    }
+    return hash;
 }
 
 int main() {
@@ -46,7 +133,7 @@ int main() {
     camera.SetMovementSpeed(0.1f);
     camera.SetMouseSensitivity(0.1f);
 
-    SetTargetFPS(120);
+    SetTargetFPS(targetFps);
 
     // Load custom shaders
     // When calling LoadShader, Raylib will automatically attempt to find the location of uniforms and inputs with standard names.
@@ -55,6 +142,7 @@ int main() {
 
     // Get shader locations
     int lightPosLoc = GetShaderLocation(shader, "lightPos");
+    int octahedralNormalsLoc = GetShaderLocation(shader, "octahedralNormals");
 
     // Generate our cube mesh
     Mesh cube = GenerateCubeMesh();
@@ -67,77 +155,148 @@ int main() {
     // Initialize marching cubes algorithm
     std::unique_ptr<MarchingCubes> marchingCubes = std::make_unique<MarchingCubes>();
 
-    // Create a standard cube with size 2.0
-    GridCell gridCell = CreateStandardCube(2.0f);
+    // Set the isolevel for surface extraction (adjust this to see different results)
+    double isoLevel = 0.0;
 
-    // Set up some density values for the cube vertices
-    // This will create a simple diagonal cut through the cube
-    gridCell.densities[0] = 0.0;  // Inside the surface
-    gridCell.densities[1] = 0.0;  // Inside the surface
+    // Stream the terrain in around the camera. Chunks are generated as tasks, those on screen and close
+    // to the camera first, and inserted and uploaded here as they finish.
+    TerrainDensityField terrain(1337, -10.0f, 8.0f);
+    VoxelWorld world(1.0f);
+    ChunkScheduler scheduler(TaskSystem::Get(), world, terrain, isoLevel, usePackedVertices && optimizeVertexCache);
 
-    // Set the isolevel for surface extraction (adjust this to see different results)
-    double isoLevel = 0.99;
-
-    // Generate triangles using the marching cubes algorithm
-    std::vector<Triangle> triangles = marchingCubes->Polygonise(gridCell, isoLevel);
-
-    // Create a Raylib mesh from the triangles
-    Mesh gridCellMesh = { 0 };
-
-    if (!triangles.empty()) {
-        // Count the total number of vertices
-        int numVertices = triangles.size() * 3;
-
-        // Allocate memory for the mesh
-        gridCellMesh.vertexCount = numVertices;
-        gridCellMesh.triangleCount = triangles.size();
-        gridCellMesh.vertices = (float*)MemAlloc(numVertices * 3 * sizeof(float));
-        gridCellMesh.normals = (float*)MemAlloc(numVertices * 3 * sizeof(float));
-
-        // Fill the mesh data
-        for (int i = 0; i < triangles.size(); i++) {
-            // Vertices for this triangle
-            Vector3 v1 = triangles[i].X;
-            Vector3 v2 = triangles[i].Y;
-            Vector3 v3 = triangles[i].Z;
-
-            // Calculate normal (counter-clockwise winding)
-            Vector3 normal = Vector3Normalize(Vector3CrossProduct(
-                Vector3Subtract(v2, v1),
-                Vector3Subtract(v3, v1)
-            ));
-
-            // Copy vertex positions
-            gridCellMesh.vertices[i*9 + 0] = v1.x;
-            gridCellMesh.vertices[i*9 + 1] = v1.y;
-            gridCellMesh.vertices[i*9 + 2] = v1.z;
-
-            gridCellMesh.vertices[i*9 + 3] = v2.x;
-            gridCellMesh.vertices[i*9 + 4] = v2.y;
-            gridCellMesh.vertices[i*9 + 5] = v2.z;
-
-            gridCellMesh.vertices[i*9 + 6] = v3.x;
-            gridCellMesh.vertices[i*9 + 7] = v3.y;
-            gridCellMesh.vertices[i*9 + 8] = v3.z;
-
-            // Use the same normal for all vertices in this triangle
-            for (int j = 0; j < 3; j++) {
-                gridCellMesh.normals[i*9 + j*3 + 0] = normal.x;
-                gridCellMesh.normals[i*9 + j*3 + 1] = normal.y;
-                gridCellMesh.normals[i*9 + j*3 + 2] = normal.z;
-            }
-        }
+    std::unordered_map<ChunkCoord, ChunkMesh, ChunkCoordHash> chunkMeshes;
+    std::size_t meshBytes = 0;
 
-        // Upload mesh data to GPU
-        UploadMesh(&gridCellMesh, false);
-    }
+    // Chunk meshes still uploading, by upload
+    UploadQueue uploadQueue(targetFps);
+    std::unordered_map<UploadQueue::UploadId, ChunkCoord> uploadingChunks;
+
+    // CPU time the last frame spent on everything but uploads, which uploads get what is left of the frame after
+    double otherWorkMilliseconds = 0.0;
+    ExtractionStats extractionStats;
+    bool terrainLogged = false;
+
+    // Collide the camera with the terrain
+    camera.EnableCollision(&world, static_cast<float>(isoLevel));
+
+    // Picking is done directly against the density field
+    VolumeRaycaster raycaster(world, static_cast<float>(isoLevel));
 
     // Define light position in world space
     Vector3 lightPos = {50.0f, 25.0f, 20.0f};
 
+    // Input is read every frame, and waits there for the next simulation step
+    FixedTimestep simulation(simulationStepsPerSecond);
+    CameraInput cameraInput;
+
     while (!WindowShouldClose()) {
-        // Update camera
-        camera.Update();
+        auto frameStart = std::chrono::steady_clock::now();
+
+        // Run the simulation in fixed steps, as many as the time since the last frame holds
+        cameraInput.Accumulate(camera.ReadInput());
+        int steps = simulation.Advance(GetFrameTime());
+        for (int step = 0; step < steps; step++) {
+            camera.Step(cameraInput, static_cast<float>(simulation.GetStepSeconds()));
+            cameraInput.ClearEvents();
+        }
+
+        // Render between the last two steps, so motion stays smooth when frames and steps do not line up
+        Camera3D view = camera.GetInterpolatedCamera(simulation.GetAlpha());
+
+        // Request the chunks around the simulated camera, and drop those left behind. Only the outcome of
+        // the latest step matters, so after a stall the decisions are made once, not once per step.
+        if (steps > 0) {
+            const Camera3D &simulated = camera.GetCamera();
+            ChunkCoord cameraChunk = world.WorldToChunk(simulated.position);
+            auto withinDistance = [&](ChunkCoord coord, int distance) {
+                return std::abs(coord.x - cameraChunk.x) <= distance && std::abs(coord.z - cameraChunk.z) <= distance;
+            };
+
+            for (ChunkCoord coord : scheduler.GetPendingChunks()) {
+                if (!withinDistance(coord, viewDistanceChunks + 1)) {
+                    scheduler.Cancel(coord);
+                }
+            }
+
+            std::vector<ChunkCoord> unloaded;
+            for (const auto &[coord, chunk] : world.GetChunks()) {
+                if (!withinDistance(coord, viewDistanceChunks + 1)) {
+                    unloaded.push_back(coord);
+                }
+            }
+            for (ChunkCoord coord : unloaded) {
+                auto it = chunkMeshes.find(coord);
+                if (it != chunkMeshes.end()) {
+                    meshBytes -= ChunkMeshBytes(it->second);
+                    if (it->second.upload != 0) {
+                        uploadQueue.Cancel(it->second.upload);
+                        uploadingChunks.erase(it->second.upload);
+                    } else {
+                        UnloadChunkMesh(it->second);
+                    }
+                    chunkMeshes.erase(it);
+                }
+                world.UnloadChunk(coord);
+            }
+
+            for (int z = cameraChunk.z - viewDistanceChunks; z <= cameraChunk.z + viewDistanceChunks; z++) {
+                for (int y = lowestChunkY; y <= highestChunkY; y++) {
+                    for (int x = cameraChunk.x - viewDistanceChunks; x <= cameraChunk.x + viewDistanceChunks; x++) {
+                        if (world.FindChunk({ x, y, z }) == nullptr) {
+                            scheduler.Request({ x, y, z });
+                        }
+                    }
+                }
+            }
+
+            // The view changes every step, so everything still queued is ranked again, uploads included
+            scheduler.UpdatePriorities(simulated, (float)screenWidth / screenHeight);
+            for (const auto &[upload, coord] : uploadingChunks) {
+                const ChunkMesh &chunkMesh = chunkMeshes.at(coord);
+                uploadQueue.SetPriority(upload, ScreenImportance(simulated, (float)screenWidth / screenHeight, chunkMesh.center, chunkMesh.radius));
+            }
+        }
+
+        // Insert and upload the chunks generated since the last frame
+        for (GeneratedChunk &generated : scheduler.TakeFinished()) {
+            extractionStats.Merge(generated.stats);
+            const Chunk &chunk = world.InsertChunk(std::move(generated.chunk));
+
+            // The upload reads the packed arrays where they stay, in the map
+            ChunkMesh &chunkMesh = chunkMeshes[chunk.coord];
+            if (!UploadChunkMesh(generated, chunk, world, *marchingCubes, isoLevel, uploadQueue, view, (float)screenWidth / screenHeight,
+                                 chunkMesh, meshBytes)) {
+                chunkMeshes.erase(chunk.coord);
+            } else if (chunkMesh.upload != 0) {
+                uploadingChunks[chunkMesh.upload] = chunk.coord;
+            }
+        }
+
+        // Upload what fits in the rest of the frame. Meshes are drawn from the frame their upload completes in.
+        uploadQueue.Update(otherWorkMilliseconds);
+        for (UploadQueue::CompletedUpload &completed : uploadQueue.TakeCompleted()) {
+            ChunkMesh &chunkMesh = chunkMeshes.at(uploadingChunks.at(completed.id));
+            chunkMesh.mesh = completed.mesh;
+            chunkMesh.upload = 0;
+            uploadingChunks.erase(completed.id);
+        }
+
+        // Report once the terrain around the starting position is complete
+        if (!terrainLogged && simulation.GetStepCount() > 0 && scheduler.GetPendingCount() == 0) {
+            terrainLogged = true;
+            TraceLog(LOG_INFO, "EXTRACTION: Terrain extracted, density hash %016llx\n%s", (unsigned long long)HashWorld(world), extractionStats.ToString().c_str());
+
+            TraceLog(LOG_INFO, "EXTRACTION: %d chunk meshes, %.2f MiB of %s vertex data", (int)chunkMeshes.size(), meshBytes / 1048576.0,
+                     usePackedVertices ? "packed" : "float");
+
+            MeshBufferPool::Stats poolStats = MeshBufferPool::Get().GetStats();
+            TraceLog(LOG_INFO, "MEMORY: Mesh buffers %.2f MiB live, %.2f MiB peak, %.2f MiB pooled",
+                     poolStats.liveBytes / 1048576.0, poolStats.peakLiveBytes / 1048576.0, poolStats.pooledBytes / 1048576.0);
+        }
+
+        // Pick the terrain in the middle of the screen
+        Ray pickRay = { view.position, Vector3Subtract(view.target, view.position) };
+        RayCollision pick = raycaster.CastRay(pickRay, 200.0f);
 
         // Update light position uniform in shader
         SetShaderValue(shader, lightPosLoc, &lightPos, SHADER_UNIFORM_VEC3);
@@ -146,7 +305,7 @@ int main() {
 
         ClearBackground(RAYWHITE);
 
-        BeginMode3D(camera.GetCamera());
+        BeginMode3D(view);
 
         // Create model matrix for the cube
         Matrix modelMatrix = MatrixIdentity();
@@ -155,9 +314,31 @@ int main() {
         int modelLoc = GetShaderLocation(shader, "matModel");
         SetShaderValueMatrix(shader, modelLoc, modelMatrix);
 
-        // Draw the generated marching cubes mesh (if it exists)
-        if (gridCellMesh.vertexCount > 0) {
-            DrawMesh(gridCellMesh, material, modelMatrix);
+        // Skip chunks outside of the view
+        std::vector<const ChunkMesh *> visibleMeshes;
+        {
+            PROFILE_SCOPE(ProfileZone::Culling);
+            for (const auto &[coord, chunkMesh] : chunkMeshes) {
+                if (chunkMesh.upload == 0 && IsSphereInView(view, (float)screenWidth / screenHeight, chunkMesh.center, chunkMesh.radius)) {
+                    visibleMeshes.push_back(&chunkMesh);
+                }
+            }
+        }
+
+        // Draw the generated marching cubes meshes
+        {
+            PROFILE_SCOPE(ProfileZone::Draw);
+            for (const ChunkMesh *chunkMesh : visibleMeshes) {
+                int octahedralNormals = chunkMesh->isPacked ? 1 : 0;
+                SetShaderValue(shader, octahedralNormalsLoc, &octahedralNormals, SHADER_UNIFORM_INT);
+                DrawMesh(chunkMesh->mesh, material, chunkMesh->transform);
+            }
+        }
+
+        // Mark the picked point on the terrain
+        if (pick.hit) {
+            DrawSphere(pick.point, 0.15f, ORANGE);
+            DrawLine3D(pick.point, Vector3Add(pick.point, pick.normal), ORANGE);
         }
 
         // Draw a grid to help with orientation
@@ -171,20 +352,54 @@ int main() {
 
         // Display controls and light info
         DrawText("WASD to move, Mouse to look", 10, 10, 20, BLACK);
-        DrawText("SPACE to reset camera, ESC to toggle cursor", 10, 40, 20, BLACK);
+        DrawText("SPACE to reset camera, ESC to toggle cursor, C to toggle collision, F1 to toggle profiler", 10, 40, 20, BLACK);
         DrawText(TextFormat("Light position: %.2f, %.2f, %.2f", lightPos.x, lightPos.y, lightPos.z), 10, 70, 20, BLACK);
+        if (pick.hit) {
+            DrawText(TextFormat("Picked: %.2f, %.2f, %.2f (%.2f away)", pick.point.x, pick.point.y, pick.point.z, pick.distance), 10, 100, 20, BLACK);
+        }
+
+        const UploadQueue::Stats &uploadStats = uploadQueue.GetStats();
+        DrawText(TextFormat("Uploads: %d queued, %.0f KiB waiting, %.0f of %.0f KiB this frame, latency %.1f ms average, %.1f ms max",
+                            (int)uploadStats.queuedMeshes, uploadStats.queuedBytes / 1024.0, uploadStats.uploadedBytes / 1024.0,
+                            uploadStats.budgetBytes / 1024.0, uploadStats.averageLatencyMilliseconds, uploadStats.maxLatencyMilliseconds),
+                 10, 130, 20, BLACK);
 
         // Display FPS counter in the top-right corner
         DrawFPS(screenWidth - 100, 10);
 
+        // Toggle the profiler overlay with F1, export a trace with F2
+        if (IsKeyPressed(KEY_F1)) {
+            Profiler::Get().SetEnabled(!Profiler::Get().IsEnabled());
+        }
+        if (IsKeyPressed(KEY_F2)) {
+            if (Profiler::Get().ExportChromeTrace("stillness-trace.json")) {
+                TraceLog(LOG_INFO, "PROFILER: Trace written to stillness-trace.json");
+            } else {
+                TraceLog(LOG_WARNING, "PROFILER: Failed to write stillness-trace.json");
+            }
+        }
+        if (Profiler::Get().IsEnabled()) {
+            Profiler::Get().DrawOverlay(screenWidth - 640, 40);
+        }
+
+        // Swapping waits for the GPU and the frame limiter, so the time up to here is what the CPU spent
+        otherWorkMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count() -
+                                uploadStats.uploadMilliseconds;
+
         EndDrawing();
+
+        Profiler::Get().EndFrame();
     }
 
     // Unload resources - fix the order of deallocation
     // First, unload the meshes
     UnloadMesh(cube);
-    if (gridCellMesh.vertexCount > 0) {
-        UnloadMesh(gridCellMesh);
+    for (auto &[coord, chunkMesh] : chunkMeshes) {
+        if (chunkMesh.upload != 0) {
+            uploadQueue.Cancel(chunkMesh.upload);
+        } else {
+            UnloadChunkMesh(chunkMesh);
+        }
     }
 
     // Then unload material but don't unload the shader through the material
@@ -1,6 +1,9 @@
 #version 330
 
 // Input vertex attributes
+// Packed terrain vertices (see VertexPacking.h) arrive as normalized 16 bit integers:
+// the position in the unit cube, mapped onto the chunk by the model matrix,
+// and the octahedral encoded normal in the first two components of vertexNormal.
 in vec3 vertexPosition;
 in vec3 vertexNormal;
 
@@ -8,11 +11,22 @@ in vec3 vertexNormal;
 // Raylib will attempt to find the location of uniforms by name when loading the shader.
 uniform mat4 mvp; // Model-View-Projection matrix
 uniform mat4 matModel;    // Model matrix
+uniform int octahedralNormals;  // Non-zero when vertexNormal holds an octahedral encoded normal
 
 // Output to fragment shader
 flat out vec3 surfaceNormal;  // Capitalization fixed to match fragment shader
 out vec3 vertexPositionInWorldSpace;     // Add fragment position in world space
 
+// Inverse of EncodeOctahedral in VertexPacking.cpp
+vec3 OctahedralDecode(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -t : t;
+    normal.y += normal.y >= 0.0 ? -t : t;
+    return normalize(normal);
+}
+
 void main()
 {
     // Calculate the normal matrix - using only the model matrix for normals
@@ -20,7 +34,8 @@ void main()
     mat3 normalMatrix = transpose(inverse(mat3(matModel)));
 
     // Calculate the vertex normal using the normal matrix
-    surfaceNormal = normalize(normalMatrix * vertexNormal);
+    vec3 normal = octahedralNormals != 0 ? OctahedralDecode(vertexNormal.xy) : vertexNormal;
+    surfaceNormal = normalize(normalMatrix * normal);
 
     // Calculate and pass the vertex position in world space
     // This vertex position is important for flat shading in the fragment shader.